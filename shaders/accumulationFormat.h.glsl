@@ -0,0 +1,108 @@
+// storage format of the accumulation buffer of pathTracer.comp (accRad[]), shared by all passes that read or write
+// it - see PathtracerApp::setAccumulationFormat(), the host side is src/accumulationFormat.h
+//
+// The buffer is declared as uint[] by the shader that includes this, before the include:
+//
+//     layout(std430, binding = 0) buffer b1 { uint accRad[]; };
+//
+// with ACCUMULATION_READONLY defined for a readonly buffer (then there is no storeAccumulation()). Pixel p of the
+// accumulation takes accumulationWords() uints from accRad[p * accumulationWords()] on. The compact formats have
+// no alpha (it reads as 0), and they cannot hold the gamma-encoded 8 bit values of WORK_FINALIZE, so the frame
+// stays linear radiance - packImage.comp and the host do the gamma encoding.
+
+#ifndef _ACCUMULATION_FORMAT_H_GLSL_
+#define _ACCUMULATION_FORMAT_H_GLSL_
+
+// keep in sync with AccumulationFormat::Format
+#define ACCUMULATION_RGBA32F      0 // 16 bytes, the reference - and the only one that holds the primary hits of OUTPUT_PRIMARY_HIT
+#define ACCUMULATION_RGB32F       1 // 12 bytes, the same values without the unused alpha
+#define ACCUMULATION_RGBA16F      2 // 8 bytes, packHalf2x16()
+#define ACCUMULATION_RGB9E5       3 // 4 bytes, 9 bit mantissas with a shared 5 bit exponent, for previews
+#define ACCUMULATION_R11G11B10F   4 // 4 bytes, unsigned floats with 6 / 6 / 5 bit mantissas, for previews
+
+// set by PathtracerApp::createComputePipeline(), for all passes
+layout(constant_id = 8) const int ACCUMULATION_FORMAT = ACCUMULATION_RGBA32F;
+
+uint accumulationWords() {
+    switch (ACCUMULATION_FORMAT) {
+        case ACCUMULATION_RGBA32F: return 4u;
+        case ACCUMULATION_RGB32F:  return 3u;
+        case ACCUMULATION_RGBA16F: return 2u;
+        default:                   return 1u;
+    }
+}
+
+// GL_EXT_texture_shared_exponent, with a bias of 15 - non-negative values up to 65408
+uint packRGB9E5(vec3 c) {
+    c = clamp(c, 0.0, 65408.0);
+    float maxC = max(c.r, max(c.g, c.b));
+    int e = max(-16, int(floor(log2(max(maxC, 1e-30))))) + 16;
+    float scale = exp2(float(e - 24));
+    // rounding the largest channel up can overflow its mantissa
+    if (floor(maxC / scale + 0.5) >= 512.0) { e++; scale *= 2.0; }
+    uvec3 m = uvec3(floor(c / scale + 0.5));
+    return m.r | (m.g << 9) | (m.b << 18) | (uint(e) << 27);
+}
+
+vec3 unpackRGB9E5(uint v) {
+    return vec3(v & 0x1FFu, (v >> 9) & 0x1FFu, (v >> 18) & 0x1FFu) * exp2(float(int(v >> 27) - 24));
+}
+
+// the halfs of the channels without the sign bit, rounded to 11 / 11 / 10 bits - at most the largest finite value
+uint packR11G11B10F(vec3 c) {
+    c = max(c, 0.0);
+    uint rg = packHalf2x16(c.rg), b = packHalf2x16(vec2(c.b, 0.0));
+    uint r11 = min(((rg & 0xFFFFu) + 0x8u) >> 4, 0x7BFu);
+    uint g11 = min(((rg >> 16) + 0x8u) >> 4, 0x7BFu);
+    uint b10 = min(((b & 0xFFFFu) + 0x10u) >> 5, 0x3DFu);
+    return r11 | (g11 << 11) | (b10 << 22);
+}
+
+vec3 unpackR11G11B10F(uint v) {
+    return vec3(unpackHalf2x16((v & 0x7FFu) << 4).x, unpackHalf2x16(((v >> 11) & 0x7FFu) << 4).x, unpackHalf2x16((v >> 22) << 5).x);
+}
+
+// pixel p of the accumulation (including the base of the frame)
+vec4 loadAccumulation(uint p) {
+    uint i = p * accumulationWords();
+    switch (ACCUMULATION_FORMAT) {
+        case ACCUMULATION_RGBA32F:
+            return uintBitsToFloat(uvec4(accRad[i], accRad[i + 1u], accRad[i + 2u], accRad[i + 3u]));
+        case ACCUMULATION_RGB32F:
+            return vec4(uintBitsToFloat(uvec3(accRad[i], accRad[i + 1u], accRad[i + 2u])), 0.0);
+        case ACCUMULATION_RGBA16F:
+            return vec4(unpackHalf2x16(accRad[i]), unpackHalf2x16(accRad[i + 1u]));
+        case ACCUMULATION_RGB9E5:
+            return vec4(unpackRGB9E5(accRad[i]), 0.0);
+        default:
+            return vec4(unpackR11G11B10F(accRad[i]), 0.0);
+    }
+}
+
+#ifndef ACCUMULATION_READONLY
+void storeAccumulation(uint p, vec4 c) {
+    uint i = p * accumulationWords();
+    switch (ACCUMULATION_FORMAT) {
+        case ACCUMULATION_RGBA32F:
+            accRad[i] = floatBitsToUint(c.r); accRad[i + 1u] = floatBitsToUint(c.g);
+            accRad[i + 2u] = floatBitsToUint(c.b); accRad[i + 3u] = floatBitsToUint(c.a);
+            break;
+        case ACCUMULATION_RGB32F:
+            accRad[i] = floatBitsToUint(c.r); accRad[i + 1u] = floatBitsToUint(c.g); accRad[i + 2u] = floatBitsToUint(c.b);
+            break;
+        case ACCUMULATION_RGBA16F:
+            // the largest finite half, instead of infinity
+            c = clamp(c, -65504.0, 65504.0);
+            accRad[i] = packHalf2x16(c.rg); accRad[i + 1u] = packHalf2x16(c.ba);
+            break;
+        case ACCUMULATION_RGB9E5:
+            accRad[i] = packRGB9E5(c.rgb);
+            break;
+        default:
+            accRad[i] = packR11G11B10F(c.rgb);
+            break;
+    }
+}
+#endif
+
+#endif // _ACCUMULATION_FORMAT_H_GLSL_
@@ -6,24 +6,7 @@
 // mul
 // sqrt
 
-#define TRUE    1
-#define FALSE   0
-
-// set everything to false to fall back to single-precision (native) floats
-#define USE_NATIVE_FP64         FALSE // ==> won't run on MacOS over Metal :-(
-
-// unfortunately, implementing these two methods does not make sense on MacOS
-// => for our application, using 32bit for the integral part may not be enough (uint4 fp_32_96 format)
-// => switching to ulong4 (fp_64_192) doesn't work on MacOS over Metal :-(
-#define FP128_uint4_fp_32_96    ( FALSE && !USE_NATIVE_FP64 )
-#define FP256_ulong4_fp_64_192  ( FALSE && !FP128_uint4_fp_32_96 && !USE_NATIVE_FP64 )
-
-// uses uint64, which won't run on MacOS over Metal :-(
-#define FP_64_64_R128           ( FALSE && !FP128_uint4_fp_32_96 && !FP256_ulong4_fp_64_192 && !USE_NATIVE_FP64 )
-
-#define DF64_F32_F32            ( FALSE && !FP_64_64_R128 && !FP128_uint4_fp_32_96 && !FP256_ulong4_fp_64_192 && !USE_NATIVE_FP64 )
-
-#define DS_f32_f32              ( FALSE && !DF64_F32_F32 && !FP_64_64_R128 && !FP128_uint4_fp_32_96 && !FP256_ulong4_fp_64_192 && !USE_NATIVE_FP64 )
+#include "precisionModes.h.glsl" // selects one of the implementations below
 
 #if ( DS_f32_f32 == TRUE ) // Henry Thasler
 // Emulation based on Fortran-90 double-single package. See http://crd.lbl.gov/~dhbailey/mpdist/
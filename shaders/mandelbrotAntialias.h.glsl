@@ -0,0 +1,28 @@
+// declarations shared by the edge detection (mandelbrotEdges.comp) and the supersampling pass
+// (mandelbrotSupersample.comp) of the adaptive anti-aliasing, see MandelbrotApp::setAntialiasing()
+
+#ifndef _MANDELBROT_ANTIALIAS_H_GLSL_
+#define _MANDELBROT_ANTIALIAS_H_GLSL_
+
+// edgeDispatch: VkDispatchIndirectCommand of the supersampling pass (x: workgroups, y = z = 1) and w: number of edge
+// pixels, edges[]: the indices of the edge pixels, in no particular order
+layout(std430, binding = 3) buffer edgeBuf
+{
+   uvec4 edgeDispatch;
+   uint edges[];
+};
+
+// see MandelbrotApp::aaPushConst_t - the names of the iteration and the coloring pass, so that mandelbrotSample.h.glsl
+// and mandelbrotPalette.h.glsl can be included
+// k_samplesPerAxis: an edge pixel takes k_samplesPerAxis^2 samples, k_edgeThreshold: difference of the continuous
+// iteration count to a neighbour that makes a pixel an edge pixel, k_maxGroups: at most that many workgroups in the
+// supersampling pass
+layout(push_constant, std430) uniform PushConstants {
+  vec4 kColor; uvec2 k_imgdim; vec2 kDeParams;
+  vec2 k_center; float k_scale; uint k_maxIter;
+  uint k_samplesPerAxis; float k_edgeThreshold; uint k_maxGroups;
+} pushConstants;
+
+#define SUPERSAMPLE_GROUP_SIZE 64u
+
+#endif // _MANDELBROT_ANTIALIAS_H_GLSL_
@@ -0,0 +1,40 @@
+// maps a packed sample of mandelbrotSample.h.glsl to a color, shared by the coloring pass (mandelbrotColor.comp), the
+// supersampling pass (mandelbrotSupersample.comp) and the batch pass (mandelbrotBatch.comp)
+//
+// The shader that includes this declares INTERIOR_SAMPLE and - unless it defines SAMPLE_ITERATION_ONLY, then there is
+// only paletteColor() - the push constants kColor and kDeParams (see MandelbrotApp::colorPushConst_t).
+
+#ifndef _MANDELBROT_PALETTE_H_GLSL_
+#define _MANDELBROT_PALETTE_H_GLSL_
+
+// kColor: the offset of the cosine palette, deParams: gain, strength of the distance-estimate shading
+vec3 paletteColor( uint s, vec3 kColor, vec2 deParams ) {
+
+  bool interior = ( ( s & 0xFFFFu ) == INTERIOR_SAMPLE );
+  float t  = interior ? 1.0 : unpackUnorm2x16( s & 0xFFFFu ).x;
+  float de = interior ? 0.0 : unpackHalf2x16( s >> 16 ).x;
+
+  // we use a simple cosine palette to determine color:
+  // http://iquilezles.org/www/articles/palettes/palettes.htm
+  vec3 d = kColor;
+  vec3 e = vec3(-0.2, -0.3 ,-0.5);
+  vec3 f = vec3(2.1, 2.0, 3.0);
+  vec3 g = vec3(0.0, 0.1, 0.0);
+  vec3 color = d + e*cos( 6.28318*(f*t+g) );
+
+  // darken the exterior close to the set boundary
+  if ( !interior ) {
+    float shade = clamp( sqrt( de * deParams.x ), 0.0, 1.0 );
+    color *= mix( 1.0, shade, deParams.y );
+  }
+
+  return clamp( color, 0.0, 1.0 );
+}
+
+#ifndef SAMPLE_ITERATION_ONLY
+vec3 sampleColor( uint s ) {
+  return paletteColor( s, pushConstants.kColor.rgb, pushConstants.kDeParams );
+}
+#endif
+
+#endif // _MANDELBROT_PALETTE_H_GLSL_
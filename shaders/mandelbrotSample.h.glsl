@@ -0,0 +1,107 @@
+// the escape-time iteration of one pixel, shared by the iteration pass (mandelbrot.comp), the subdivision pass
+// (mandelbrotTiles.comp), the supersampling pass (mandelbrotSupersample.comp) and the batch pass
+// (mandelbrotBatch.comp), so that all compute the same samples
+//
+// The shader that includes this declares INTERIOR_CHECKS and - unless it defines SAMPLE_ITERATION_ONLY, then there
+// is only iterateSample() - the push constants k_imgdim, k_center, k_scale and k_maxIter (see
+// MandelbrotApp::iterPushConst_t).
+
+#ifndef _MANDELBROT_SAMPLE_H_GLSL_
+#define _MANDELBROT_SAMPLE_H_GLSL_
+
+#define INTERIOR_SAMPLE 0xFFFFu
+
+// main cardioid and period-2 bulb can be detected analytically
+bool isInMainCardioidOrBulb( vec2 c ) {
+  float xq = c.x - 0.25;
+  float q = xq * xq + c.y * c.y;
+  if ( q * ( q + xq ) <= 0.25 * c.y * c.y ) return true;
+  float xb = c.x + 1.0;
+  return ( xb * xb + c.y * c.y <= 0.0625 );
+}
+
+// the packed sample record of the orbit of z under z^2 + c, for M iterations - Mandelbrot: z = 0, c = the pixel, Julia:
+// z = the pixel, c fixed. The distance estimate is converted to pixels of pixelSize.
+uint iterateSample( vec2 z, vec2 c, bool julia, uint M, float pixelSize ) {
+
+  // the cardioid and the bulb only exist in the parameter plane
+  if ( INTERIOR_CHECKS && !julia && isInMainCardioidOrBulb( c ) ) {
+    return INTERIOR_SAMPLE;
+  }
+
+  const float bailout2 = 256.0 * 256.0; // large bailout radius, so that the smooth iteration count is continuous
+
+  // derivative dz/dc (Mandelbrot) or dz/dz0 (Julia), needed for the distance estimate
+  vec2 dz = julia ? vec2(1.0, 0.0) : vec2(0.0);
+  vec2 dc = julia ? vec2(0.0) : vec2(1.0, 0.0);
+
+  // Brent-style cycle detection: compare against a saved orbit point that is refreshed after
+  // 1, 2, 4, 8, ... iterations, so cycles of any period are found within ~2x the pre-period.
+  // Only exact repeats count - such an orbit can never escape, so the result is identical to
+  // iterating all M steps.
+  vec2 zSaved = z; // the first point of the orbit
+  uint cycleLen = 0;
+  uint cycleLimit = 1;
+
+  uint i = 0;
+  for ( ; i < M; i++ )
+  {
+    dz = 2.0 * vec2(z.x*dz.x - z.y*dz.y, z.x*dz.y + z.y*dz.x) + dc;
+    z = vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
+    if (dot(z, z) > bailout2) break;
+
+    if ( INTERIOR_CHECKS ) {
+      if ( all( equal( z, zSaved ) ) ) { i = M; break; }
+      if ( ++cycleLen == cycleLimit ) {
+        zSaved = z;
+        cycleLen = 0;
+        cycleLimit *= 2;
+      }
+    }
+  }
+
+  if ( i >= M ) {
+    return INTERIOR_SAMPLE;
+  }
+
+  // continuous iteration count: http://iquilezles.org/www/articles/mset_smooth/mset_smooth.htm
+  float r2 = dot(z, z);
+  float nu = float(i) + 1.0 - log2( 0.5 * log2( r2 ) );
+  float t = clamp( nu / float(M), 0.0, 65534.0 / 65535.0 );
+
+  // exterior distance estimate: 0.5 * |z| * log|z| / |dz|, converted to pixel units
+  float r = sqrt(r2);
+  float de = 0.5 * r * log(r) / length(dz);
+
+  return ( packUnorm2x16( vec2( t, 0.0 ) ) & 0xFFFFu ) | ( packHalf2x16( vec2( de / pixelSize, 0.0 ) ) << 16 );
+}
+
+#ifndef SAMPLE_ITERATION_ONLY
+
+// the packed sample record at pos in pixel coordinates (see samples[] of mandelbrot.comp), pixel pix is sampled at
+// pos = pix
+uint computeSampleAt( vec2 pos ) {
+
+  uvec2 imgdim = pushConstants.k_imgdim;
+
+  float x = pos.x / float(imgdim.x);
+  float y = pos.y / float(imgdim.y);
+
+  /*
+  What follows is code for rendering the mandelbrot set.
+  */
+  vec2 uv = vec2(x,y);
+  float aspect = float(imgdim.x) / float(imgdim.y);
+  vec2 c = pushConstants.k_center + (uv - 0.5) * vec2(aspect, 1.0) * pushConstants.k_scale;
+
+  return iterateSample( vec2(0.0), c, false, pushConstants.k_maxIter, pushConstants.k_scale / float(imgdim.y) );
+}
+
+// the packed sample record of pixel pix
+uint computeSample( uvec2 pix ) {
+  return computeSampleAt( vec2( pix ) );
+}
+
+#endif // SAMPLE_ITERATION_ONLY
+
+#endif // _MANDELBROT_SAMPLE_H_GLSL_
@@ -0,0 +1,41 @@
+// order of the pixels in the accumulation buffer of pathTracer.comp (accRad[], and aovs[] / scratch[] of the
+// denoiser), shared by all passes that read or write it - see PathtracerApp::setTiledPixels(), the host side is
+// src/pixelLayout.h
+//
+// Row-major, a 16x16 workgroup writes 16 rows of the image, each in a different place of the buffer. With
+// TILED_PIXELS, the image is cut into tiles of 8x8 pixels, which are stored one after the other (row-major), and
+// the pixels of a tile in Z-order (Morton order) - the 64 pixels (1 KB) of a tile are contiguous, and so is any
+// aligned square of 2x2, 4x4 pixels within it. The tiles at the right and the bottom border are cut off and keep
+// the rows within the tile, so the buffer has no padding: the index is a permutation of [0, width * height).
+//
+// Pixel coordinates are in the orientation of the buffer, which pathTracer.comp writes upside-down (see
+// PathtracerApp::flipImageRGBA8()) - the passes that read it upright flip the coordinates before the lookup.
+
+#ifndef _PIXEL_LAYOUT_H_GLSL_
+#define _PIXEL_LAYOUT_H_GLSL_
+
+// set by PathtracerApp::createComputePipeline(), for all passes
+layout(constant_id = 7) const bool TILED_PIXELS = false;
+
+// keep in sync with PixelLayout::tileSize
+const uint PIXEL_TILE_SIZE = 8u;
+
+// spreads the 3 bits of v < 8 to the even bits: b2 b1 b0 -> b2 0 b1 0 b0
+uint spreadBits3(uint v) {
+    v = (v | (v << 2)) & 0x33u;
+    return (v | (v << 1)) & 0x55u;
+}
+
+// index of pixel pix of an image of imgdim pixels, relative to the first pixel of the frame
+uint pixelIndex(uvec2 pix, uvec2 imgdim) {
+    if (!TILED_PIXELS) return pix.y * imgdim.x + pix.x;
+    uvec2 tile = pix / PIXEL_TILE_SIZE, local = pix % PIXEL_TILE_SIZE;
+    // the border tiles are smaller
+    uint tileW = min(PIXEL_TILE_SIZE, imgdim.x - tile.x * PIXEL_TILE_SIZE);
+    uint tileH = min(PIXEL_TILE_SIZE, imgdim.y - tile.y * PIXEL_TILE_SIZE);
+    uint first = tile.y * PIXEL_TILE_SIZE * imgdim.x + tile.x * PIXEL_TILE_SIZE * tileH;
+    if (tileW == PIXEL_TILE_SIZE && tileH == PIXEL_TILE_SIZE) return first + (spreadBits3(local.x) | (spreadBits3(local.y) << 1));
+    return first + local.y * tileW + local.x;
+}
+
+#endif // _PIXEL_LAYOUT_H_GLSL_
@@ -0,0 +1,39 @@
+// precision modes of the emulated-double code paths in intersect()
+// only preprocessor definitions in here, so this can be included before the #extension directives
+//
+// every mode is compiled into its own shader variant (see Makefile), and PathtracerApp picks
+// one at runtime based on the device features (shaderFloat64, shaderInt64)
+
+#ifndef _PRECISION_MODES_H_GLSL_
+#define _PRECISION_MODES_H_GLSL_
+
+#define TRUE    1
+#define FALSE   0
+
+// keep in sync with PathtracerApp::PrecisionMode
+#define PRECISION_FP32      0 // single-precision (native) floats everywhere
+#define PRECISION_FP64      1 // native doubles, needs shaderFloat64 ==> won't run on MacOS over Metal :-(
+#define PRECISION_DS        2 // double-single emulation (Henry Thasler)
+#define PRECISION_DF64      3 // float-float emulation (Andrew Thall)
+#define PRECISION_R128      4 // 64.64 fixed point, needs shaderInt64 ==> won't run on MacOS over Metal :-(
+
+// passed in by the build as -DPRECISION_MODE=PRECISION_xxx
+#ifndef PRECISION_MODE
+    #define PRECISION_MODE  PRECISION_FP32
+#endif
+
+#define USE_NATIVE_FP64         ( PRECISION_MODE == PRECISION_FP64 )
+
+// unfortunately, implementing these two methods does not make sense on MacOS
+// => for our application, using 32bit for the integral part may not be enough (uint4 fp_32_96 format)
+// => switching to ulong4 (fp_64_192) doesn't work on MacOS over Metal :-(
+#define FP128_uint4_fp_32_96    FALSE
+#define FP256_ulong4_fp_64_192  FALSE
+
+#define FP_64_64_R128           ( PRECISION_MODE == PRECISION_R128 )
+
+#define DF64_F32_F32            ( PRECISION_MODE == PRECISION_DF64 )
+
+#define DS_f32_f32              ( PRECISION_MODE == PRECISION_DS )
+
+#endif // _PRECISION_MODES_H_GLSL_
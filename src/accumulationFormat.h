@@ -0,0 +1,79 @@
+#ifndef _ACCUMULATION_FORMAT_H_
+#define _ACCUMULATION_FORMAT_H_
+
+// Storage formats of the accumulation buffer of pathTracer.comp - the host side of shaders/accumulationFormat.h.glsl,
+// see PathtracerApp::setAccumulationFormat(). The host always works with 4 floats per pixel, decode() converts
+// a readback to that.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+struct AccumulationFormat {
+
+    // keep in sync with ACCUMULATION_* in accumulationFormat.h.glsl
+    enum Format : int32_t {
+        eRGBA32F = 0,   // 16 bytes per pixel, the reference
+        eRGB32F,        // 12 bytes, without the unused alpha
+        eRGBA16F,       // 8 bytes, halfs
+        eRGB9E5,        // 4 bytes, shared exponent, for previews
+        eR11G11B10F,    // 4 bytes, unsigned small floats, for previews
+        eNumFormats
+    };
+
+    static const char* name( const Format format ) {
+        static const char* names[eNumFormats] = { "RGBA32F", "RGB32F", "RGBA16F", "RGB9E5", "R11G11B10F" };
+        return names[ format ];
+    }
+
+    static uint32_t bytesPerPixel( const Format format ) {
+        static const uint32_t bytes[eNumFormats] = { 16, 12, 8, 4, 4 };
+        return bytes[ format ];
+    }
+
+    // the fp32 formats hold the gamma-encoded 8 bit values of a finalized frame, the others stay linear
+    static bool holdsFinalized( const Format format ) { return format == eRGBA32F || format == eRGB32F; }
+
+    // numPixels pixels of the format at src to 4 floats per pixel at rgba, same as loadAccumulation() in the shader
+    static void decode( const Format format, const void* src, const size_t numPixels, float* rgba ) {
+        const uint32_t* words = static_cast<const uint32_t*>( src );
+        for ( size_t i = 0; i < numPixels; i++, rgba += 4 ) {
+            switch ( format ) {
+                case eRGBA32F:
+                    memcpy( rgba, words + 4 * i, 4 * sizeof( float ) );
+                    break;
+                case eRGB32F:
+                    memcpy( rgba, words + 3 * i, 3 * sizeof( float ) );
+                    rgba[3] = 0.0f;
+                    break;
+                case eRGBA16F:
+                    for ( int k = 0; k < 4; k++ ) { rgba[k] = halfToFloat( static_cast<uint16_t>( words[ 2 * i + k / 2 ] >> ( 16 * ( k % 2 ) ) ) ); }
+                    break;
+                case eRGB9E5: {
+                    const float scale = ldexpf( 1.0f, static_cast<int>( words[i] >> 27 ) - 24 );
+                    for ( int k = 0; k < 3; k++ ) { rgba[k] = ( ( words[i] >> ( 9 * k ) ) & 0x1FFu ) * scale; }
+                    rgba[3] = 0.0f;
+                    break;
+                }
+                default:
+                    rgba[0] = halfToFloat( static_cast<uint16_t>( ( words[i] & 0x7FFu ) << 4 ) );
+                    rgba[1] = halfToFloat( static_cast<uint16_t>( ( ( words[i] >> 11 ) & 0x7FFu ) << 4 ) );
+                    rgba[2] = halfToFloat( static_cast<uint16_t>( ( words[i] >> 22 ) << 5 ) );
+                    rgba[3] = 0.0f;
+                    break;
+            }
+        }
+    }
+
+    // IEEE 754 binary16, like unpackHalf2x16()
+    static float halfToFloat( const uint16_t h ) {
+        const int exponent = ( h >> 10 ) & 0x1F, mantissa = h & 0x3FF;
+        float value;
+        if ( exponent == 0 ) { value = ldexpf( static_cast<float>( mantissa ), -24 ); }              // subnormal
+        else if ( exponent == 31 ) { value = mantissa == 0 ? INFINITY : NAN; }
+        else { value = ldexpf( static_cast<float>( mantissa | 0x400 ), exponent - 25 ); }
+        return ( h & 0x8000 ) ? -value : value;
+    }
+};
+
+#endif // _ACCUMULATION_FORMAT_H_
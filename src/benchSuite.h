@@ -0,0 +1,252 @@
+#ifndef _BENCH_SUITE_H_
+#define _BENCH_SUITE_H_
+
+// Benchmark and regression suite, the host side of the "bench-suite" command of both apps (see
+// benchmark::runBenchSuite() and `make bench`): a matrix of kernels, resolutions, sample counts, workgroup sizes and
+// precision modes is rendered on the selected device, and every configuration is checked twice:
+//
+// - its image against the golden image in bench/golden/, by PSNR. The name of the golden image leaves out the
+//   workgroup size, every size has to render the same image. See GoldenMode for missing golden images.
+// - its times against the history in bench/history.jsonl, one flat JSON object per line and run (JsonObject can
+//   read it back): a configuration is a regression if its wall time or GPU time is more than `tolerance` above the
+//   median of its last runs on the same device. Both changes are printed.
+//
+// The results of the run are appended to the history by finish(), whose return value is the exit code.
+
+#include "json.h"
+
+#include "external/lodepng/lodepng.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined( _WIN32 )
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// PSNR in dB of the RGB channels of two RGBA8 images of the same size
+static double psnrRGBA8( const std::vector<uint8_t>& image, const std::vector<uint8_t>& reference ) {
+    double squaredError = 0.0;
+    for ( size_t i = 0; i < image.size(); i++ ) {
+        if ( i % 4 == 3 ) { continue; }
+        const double d = static_cast<double>( image[i] ) - reference[i];
+        squaredError += d * d;
+    }
+    const double mse = squaredError / ( image.size() / 4 * 3 );
+    return mse > 0.0 ? 10.0 * log10( 255.0 * 255.0 / mse ) : 99.0;
+}
+
+struct BenchSuite {
+
+    struct Config {
+        std::string kernel;         // e.g. "mandelbrot-subdivision", "pathtracer-cornell-box"
+        uint32_t resx, resy;
+        int32_t spp;                // samples per pixel, 1 for the Mandelbrot kernels
+        uint32_t workgroupSize;     // square workgroups
+        std::string precision;      // "fp32", "ds", ...
+
+        // identifies the rendered image: the same for every workgroup size
+        std::string imageKey() const {
+            return kernel + "-" + std::to_string( resx ) + "x" + std::to_string( resy ) + "-" + std::to_string( spp ) + "spp-" + precision;
+        }
+        // identifies the configuration in the history
+        std::string key() const { return imageKey() + "-wg" + std::to_string( workgroupSize ); }
+    };
+
+    struct Result {
+        Config config;
+        std::string device;         // name of the Vulkan device
+        double wallMs = 0.0;        // best of the runs: submission, execution and readback
+        double gpuMs = 0.0;         // best of the runs, by GPU timestamps - 0 if the queue has none
+        double throughput = 0.0;    // per second of GPU time (wall time without timestamps), in throughputUnit
+        std::string throughputUnit;
+        double psnr = 0.0;          // against the golden image, in dB
+        std::string golden;         // "pass", "FAIL", "MISSING", "new" or "updated"
+        double baselineWallMs = 0.0, baselineGpuMs = 0.0; // medians of the history, 0 without history
+        bool regression = false;
+    };
+
+    // the last runs of the history that are compared against
+    static const size_t historyWindow = 5;
+
+    enum GoldenMode {
+        eGoldenWriteMissing,    // a missing golden image is written and reported as new, for a first local run
+        eGoldenRequire,         // a missing golden image fails like a differing one, for CI (`make bench`)
+        eGoldenUpdate           // all golden images are written again (`make bench-update-golden`)
+    };
+
+    BenchSuite( const std::string& app, const double tolerance = 0.1, const GoldenMode goldenMode = eGoldenWriteMissing,
+                const std::string& directory = "bench" )
+        : app( app ), tolerance( tolerance ), goldenMode( goldenMode ), directory( directory ) {
+        makeDirectory( directory );
+        makeDirectory( directory + "/golden" );
+        loadHistory();
+    }
+
+    // Checks the RGBA8 image of a configuration against its golden image (at least minPsnr dB) and the times against
+    // the history, and prints the result. The result is appended to the history by finish().
+    const Result& add( const Result& measured, const std::vector<uint8_t>& image, const double minPsnr ) {
+        results.push_back( measured );
+        Result& result = results.back();
+        checkGolden( result, image, minPsnr );
+        checkHistory( result );
+        if ( results.size() == 1 ) {
+            printf( "\n%s on %s, tolerance %.0f%%\n", app.c_str(), result.device.c_str(), 100.0 * tolerance );
+            printf( "%-48s %10s %10s %10s %-14s %10s %8s %15s %15s\n", "configuration", "wall [ms]", "GPU [ms]", "throughput", "",
+                "PSNR [dB]", "golden", "wall vs. median", "GPU vs. median" );
+        }
+        // both changes, either one can be the regression
+        const std::string wallChange = change( result.wallMs, result.baselineWallMs );
+        const std::string gpuChange = change( result.gpuMs, result.baselineGpuMs );
+        printf( "%-48s %10.2f %10.2f %10.2f %-14s %10.2f %8s %15s %15s%s\n", result.config.key().c_str(), result.wallMs, result.gpuMs,
+            result.throughput, result.throughputUnit.c_str(), result.psnr, result.golden.c_str(), wallChange.c_str(), gpuChange.c_str(),
+            result.regression ? " REGRESSION" : "" );
+        return result;
+    }
+
+    // Appends the results to the history, prints the summary. EXIT_FAILURE if an image differs from its golden image
+    // (or has none with eGoldenRequire) or a configuration regressed.
+    int finish() {
+        std::ofstream file( historyPath(), std::ios::app );
+        const long long timestamp = static_cast<long long>( time( NULL ) );
+        int numFailed = 0, numMissing = 0, numRegressions = 0, numNew = 0;
+        for ( const Result& result : results ) {
+            const Config& c = result.config;
+            file << "{ \"timestamp\": " << timestamp << ", \"device\": " << jsonString( result.device ) << ", \"key\": " << jsonString( c.key() )
+                 << ", \"kernel\": " << jsonString( c.kernel ) << ", \"resx\": " << c.resx << ", \"resy\": " << c.resy << ", \"spp\": " << c.spp
+                 << ", \"workgroupSize\": " << c.workgroupSize << ", \"precision\": " << jsonString( c.precision )
+                 << ", \"wallMs\": " << number( result.wallMs ) << ", \"gpuMs\": " << number( result.gpuMs )
+                 << ", \"throughput\": " << number( result.throughput ) << ", \"throughputUnit\": " << jsonString( result.throughputUnit )
+                 << ", \"psnr\": " << number( result.psnr ) << ", \"golden\": " << jsonString( result.golden )
+                 << ", \"regression\": " << ( result.regression ? "true" : "false" ) << " }\n";
+            numFailed += result.golden == "FAIL" ? 1 : 0;
+            numMissing += result.golden == "MISSING" ? 1 : 0;
+            numRegressions += result.regression ? 1 : 0;
+            numNew += result.golden == "new" ? 1 : 0;
+        }
+        if ( !file ) { printf( "could not write %s\n", historyPath().c_str() ); }
+        printf( "\n%zu configurations, %d images differ from the golden images, %d golden images missing, %d new golden images, %d performance regressions\n",
+            results.size(), numFailed, numMissing, numNew, numRegressions );
+        if ( numMissing > 0 ) { printf( "render the missing golden images with bench-suite --update-golden and commit %s/golden/\n", directory.c_str() ); }
+        printf( "history appended to %s\n", historyPath().c_str() );
+        return numFailed == 0 && numMissing == 0 && numRegressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+private:
+    std::string app;
+    double tolerance;
+    GoldenMode goldenMode;
+    std::string directory;
+    std::vector<Result> results;
+
+    // the previous runs, oldest first
+    struct HistoryEntry {
+        std::string device, key;
+        double wallMs, gpuMs;
+    };
+    std::vector<HistoryEntry> history;
+
+    std::string historyPath() const { return directory + "/history.jsonl"; }
+    std::string goldenPath( const Config& config ) const { return directory + "/golden/" + config.imageKey() + ".png"; }
+
+    void loadHistory() {
+        std::ifstream file( historyPath() );
+        std::string line, error;
+        size_t lineNumber = 0;
+        while ( std::getline( file, line ) ) {
+            lineNumber++;
+            if ( line.empty() ) { continue; }
+            JsonObject entry;
+            if ( !JsonObject::parse( line, entry, error ) ) {
+                printf( "%s:%zu: %s, skipped\n", historyPath().c_str(), lineNumber, error.c_str() );
+                continue;
+            }
+            history.push_back( HistoryEntry{ entry.getString( "device", "" ), entry.getString( "key", "" ),
+                                             entry.getNumber( "wallMs", 0.0 ), entry.getNumber( "gpuMs", 0.0 ) } );
+        }
+    }
+
+    void checkGolden( Result& result, const std::vector<uint8_t>& image, const double minPsnr ) const {
+        const std::string path = goldenPath( result.config );
+        std::vector<uint8_t> golden;
+        unsigned width = 0, height = 0;
+        const bool exists = goldenMode != eGoldenUpdate && lodepng::decode( golden, width, height, path ) == 0;
+        if ( !exists && goldenMode == eGoldenRequire ) {
+            printf( "%s is missing\n", path.c_str() );
+            result.psnr = 0.0;
+            result.golden = "MISSING";
+            return;
+        }
+        if ( !exists ) {
+            const unsigned error = lodepng::encode( path, image, result.config.resx, result.config.resy );
+            if ( error ) { printf( "encoder error %u: %s\n", error, lodepng_error_text( error ) ); }
+            result.psnr = 99.0;
+            result.golden = goldenMode == eGoldenUpdate ? "updated" : "new";
+            return;
+        }
+        if ( width != result.config.resx || height != result.config.resy ) {
+            printf( "%s is %ux%u, the image %ux%u\n", path.c_str(), width, height, result.config.resx, result.config.resy );
+            result.psnr = 0.0;
+            result.golden = "FAIL";
+            return;
+        }
+        result.psnr = psnrRGBA8( image, golden );
+        result.golden = result.psnr >= minPsnr ? "pass" : "FAIL";
+    }
+
+    // Medians, so that a single slow run in the history does not hide a regression. Without GPU timestamps (in
+    // this run or the history) only the wall time is compared.
+    void checkHistory( Result& result ) const {
+        std::vector<double> wallMs, gpuMs;
+        const std::string key = result.config.key();
+        for ( auto it = history.rbegin(); it != history.rend() && wallMs.size() < historyWindow; ++it ) {
+            if ( it->device != result.device || it->key != key ) { continue; }
+            wallMs.push_back( it->wallMs );
+            if ( it->gpuMs > 0.0 ) { gpuMs.push_back( it->gpuMs ); }
+        }
+        result.baselineWallMs = median( wallMs );
+        result.baselineGpuMs = median( gpuMs );
+        result.regression = ( result.baselineWallMs > 0.0 && result.wallMs > result.baselineWallMs * ( 1.0 + tolerance ) ) ||
+                            ( result.baselineGpuMs > 0.0 && result.gpuMs > 0.0 && result.gpuMs > result.baselineGpuMs * ( 1.0 + tolerance ) );
+    }
+
+    // of ms against baselineMs in %, "-" without a baseline
+    static std::string change( const double ms, const double baselineMs ) {
+        if ( ms <= 0.0 || baselineMs <= 0.0 ) { return "-"; }
+        char buffer[32];
+        snprintf( buffer, sizeof( buffer ), "%+.1f%%", 100.0 * ( ms / baselineMs - 1.0 ) );
+        return buffer;
+    }
+
+    static double median( std::vector<double> values ) {
+        if ( values.empty() ) { return 0.0; }
+        std::sort( values.begin(), values.end() );
+        const size_t n = values.size();
+        return n % 2 == 1 ? values[ n / 2 ] : 0.5 * ( values[ n / 2 - 1 ] + values[ n / 2 ] );
+    }
+
+    static void makeDirectory( const std::string& path ) {
+    #if defined( _WIN32 )
+        _mkdir( path.c_str() );
+    #else
+        mkdir( path.c_str(), 0755 );
+    #endif
+    }
+
+    static std::string number( const double v ) {
+        char buffer[32];
+        snprintf( buffer, sizeof( buffer ), "%.6g", v );
+        return buffer;
+    }
+};
+
+#endif // _BENCH_SUITE_H_
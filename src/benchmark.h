@@ -0,0 +1,1053 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+// Benchmarks that are run instead of the regular render, when the first command-line parameter is "bench".
+
+#if defined( MANDELBROT_MODE )
+    #include "mandelbrotApp.h"
+#elif defined( PATHTRACER_MODE )
+    #include "pathtracerApp.h"
+    #include "multiDevice.h"
+#endif
+
+#include "benchSuite.h"
+#include "jobRuntime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace benchmark {
+
+    // best-of-N timing of the last rerun(), the first rerun() acts as warm-up
+    template< typename App >
+    double timeReruns( App& app, const int numRuns ) {
+        double bestMs = 1e30;
+        app.rerun();
+        for ( int i = 0; i < numRuns; i++ ) {
+            app.rerun();
+            bestMs = std::min( bestMs, app.getLastSubmitMs() );
+        }
+        return bestMs;
+    }
+
+    // best-of-N wall time of rerun() plus the RGBA8 readback, and best-of-N GPU time (see setGpuTimestamps()),
+    // for BenchSuite. image is the readback of the last run.
+    template< typename App >
+    void timeRerunsWithReadback( App& app, const int numRuns, double& wallMs, double& gpuMs, std::vector<uint8_t>& image ) {
+        typedef std::chrono::high_resolution_clock clock;
+        wallMs = gpuMs = 1e30;
+        app.rerun();
+        for ( int i = 0; i < numRuns; i++ ) {
+            const auto start = clock::now();
+            app.rerun();
+            app.getRenderedImageRGBA8( image );
+            wallMs = std::min( wallMs, std::chrono::duration<double, std::milli>( clock::now() - start ).count() );
+            gpuMs = std::min( gpuMs, app.getLastGpuMs() );
+        }
+    }
+
+#if defined( MANDELBROT_MODE )
+
+    struct Viewport {
+        const char* name;
+        float centerX, centerY, scale;
+        uint32_t maxIter;
+    };
+
+    // Compares the iteration pass with and without the interior checks (cardioid/bulb test + cycle detection)
+    // over a set of standard viewports. Both variants must produce bit-identical sample buffers.
+    static int runMandelbrotInteriorChecks( const uint32_t res = 1024, const int numRuns = 5 ) {
+        const Viewport viewports[] = {
+            { "full set",            -0.445f,    0.0f,     2.34f,   128 },
+            { "full set, 1k iter",   -0.5f,      0.0f,     2.5f,   1024 },
+            { "main cardioid",       -0.1f,      0.0f,     0.8f,   4096 },
+            { "seahorse valley",     -0.7436f,   0.1318f,  0.01f,  2048 },
+            { "elephant valley",      0.285f,    0.01f,    0.02f,  2048 },
+            { "period-3 minibrot",   -1.7685f,   0.0f,     0.004f, 4096 },
+        };
+
+        MandelbrotApp reference( res, res ); // plain escape-time iteration
+        reference.setInteriorChecks( false );
+        reference.init();
+        reference.preRun();
+        reference.run();
+
+        MandelbrotApp checked( res, res ); // with interior early-out
+        checked.setInteriorChecks( true );
+        checked.init();
+        checked.preRun();
+        checked.run();
+
+        printf( "\n%-20s %8s %12s %12s %9s %12s\n", "viewport", "maxIter", "plain [ms]", "checks [ms]", "speedup", "diff pixels" );
+
+        bool allIdentical = true;
+        std::vector<uint32_t> referenceSamples, checkedSamples;
+        for ( const Viewport& viewport : viewports ) {
+            reference.setViewport( viewport.centerX, viewport.centerY, viewport.scale, viewport.maxIter );
+            checked.setViewport( viewport.centerX, viewport.centerY, viewport.scale, viewport.maxIter );
+
+            const double referenceMs = timeReruns( reference, numRuns );
+            const double checkedMs = timeReruns( checked, numRuns );
+
+            reference.getSamples( referenceSamples );
+            checked.getSamples( checkedSamples );
+            size_t numDiffs = 0;
+            for ( size_t i = 0; i < referenceSamples.size(); i++ ) {
+                if ( referenceSamples[ i ] != checkedSamples[ i ] ) { numDiffs++; }
+            }
+            allIdentical = allIdentical && ( numDiffs == 0 );
+
+            printf( "%-20s %8u %12.3f %12.3f %8.2fx %12zu\n",
+                viewport.name, viewport.maxIter, referenceMs, checkedMs, referenceMs / checkedMs, numDiffs );
+        }
+        printf( "\nimages %s\n", allIdentical ? "identical" : "DIFFER" );
+
+        return allIdentical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Compares iterating every pixel with the Mariani-Silver subdivision (see MandelbrotApp::setSubdivision()) over
+    // the same viewports. The pixels that the subdivision fills as interior must be interior in the full pass as
+    // well - that is the exit code. The other pixels are computed by both, but by different shaders, so the compiler
+    // may round them differently: those are only reported.
+    static int runMandelbrotSubdivision( const uint32_t res = 2048, const int numRuns = 5 ) {
+        const Viewport viewports[] = {
+            { "full set",            -0.445f,    0.0f,     2.34f,   128 },
+            { "full set, 1k iter",   -0.5f,      0.0f,     2.5f,   1024 },
+            { "main cardioid",       -0.1f,      0.0f,     0.8f,   4096 },
+            { "seahorse valley",     -0.7436f,   0.1318f,  0.01f,  2048 },
+            { "elephant valley",      0.285f,    0.01f,    0.02f,  2048 },
+            { "period-3 minibrot",   -1.7685f,   0.0f,     0.004f, 4096 },
+        };
+        const uint32_t interiorSample = 0xFFFF; // INTERIOR_SAMPLE in mandelbrotSample.h.glsl
+
+        MandelbrotApp full( res, res );
+        full.init();
+        full.preRun();
+        full.run();
+
+        MandelbrotApp subdivided( res, res );
+        subdivided.setSubdivision( true );
+        subdivided.init();
+        subdivided.preRun();
+        subdivided.run();
+
+        printf( "\n%-20s %8s %12s %14s %9s %10s %12s %12s\n", "viewport", "maxIter", "full [ms]", "subdiv. [ms]", "speedup", "interior", "wrong fill", "diff pixels" );
+
+        bool allCorrect = true;
+        std::vector<uint32_t> fullSamples, subdividedSamples;
+        for ( const Viewport& viewport : viewports ) {
+            full.setViewport( viewport.centerX, viewport.centerY, viewport.scale, viewport.maxIter );
+            subdivided.setViewport( viewport.centerX, viewport.centerY, viewport.scale, viewport.maxIter );
+
+            const double fullMs = timeReruns( full, numRuns );
+            const double subdividedMs = timeReruns( subdivided, numRuns );
+
+            full.getSamples( fullSamples );
+            subdivided.getSamples( subdividedSamples );
+            size_t numInterior = 0, numWrongFill = 0, numDiffs = 0;
+            for ( size_t i = 0; i < fullSamples.size(); i++ ) {
+                if ( fullSamples[ i ] == interiorSample ) { numInterior++; }
+                if ( fullSamples[ i ] == subdividedSamples[ i ] ) { continue; }
+                if ( subdividedSamples[ i ] == interiorSample ) { numWrongFill++; } else { numDiffs++; }
+            }
+            allCorrect = allCorrect && ( numWrongFill == 0 );
+
+            printf( "%-20s %8u %12.3f %14.3f %8.2fx %9.1f%% %12zu %12zu\n", viewport.name, viewport.maxIter, fullMs, subdividedMs, fullMs / subdividedMs,
+                100.0 * numInterior / fullSamples.size(), numWrongFill, numDiffs );
+        }
+        printf( "\nfilled pixels %s\n", allCorrect ? "correct" : "WRONG" );
+
+        return allCorrect ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // One sample per pixel, the adaptive anti-aliasing (see MandelbrotApp::setAntialiasing()), and brute-force
+    // supersampling of every pixel with the same samples per pixel, as the reference: frame time, the share of
+    // pixels that the adaptive variant supersamples, and the PSNR of both cheaper variants against the reference.
+    static int runMandelbrotAntialiasing( const uint32_t res = 1024, const uint32_t samplesPerAxis = 4, const int numRuns = 5 ) {
+        const Viewport viewports[] = {
+            { "full set",            -0.445f,    0.0f,     2.34f,   128 },
+            { "full set, 1k iter",   -0.5f,      0.0f,     2.5f,   1024 },
+            { "seahorse valley",     -0.7436f,   0.1318f,  0.01f,  2048 },
+            { "elephant valley",      0.285f,    0.01f,    0.02f,  2048 },
+            { "period-3 minibrot",   -1.7685f,   0.0f,     0.004f, 4096 },
+        };
+
+        MandelbrotApp single( res, res );
+        MandelbrotApp adaptive( res, res );
+        adaptive.setAntialiasing( true, samplesPerAxis );
+        MandelbrotApp brute( res, res );
+        brute.setAntialiasing( true, samplesPerAxis, -1.0f ); // every pixel is an edge pixel
+        MandelbrotApp* apps[3] = { &single, &adaptive, &brute };
+        for ( MandelbrotApp* app : apps ) {
+            app->init();
+            app->preRun();
+            app->run();
+        }
+
+        printf( "\n%u x %u samples per edge pixel\n", samplesPerAxis, samplesPerAxis );
+        printf( "%-20s %8s %10s %12s %10s %8s %10s %12s %12s\n", "viewport", "maxIter", "1 spp [ms]", "adaptive [ms]", "full [ms]",
+                "cost", "edges", "1 spp [dB]", "adaptive [dB]" );
+
+        std::vector<uint8_t> singleImage, adaptiveImage, reference;
+        for ( const Viewport& viewport : viewports ) {
+            double ms[3];
+            for ( int i = 0; i < 3; i++ ) {
+                apps[i]->setViewport( viewport.centerX, viewport.centerY, viewport.scale, viewport.maxIter );
+                ms[i] = timeReruns( *apps[i], numRuns );
+            }
+            single.getRenderedImageRGBA8( singleImage );
+            adaptive.getRenderedImageRGBA8( adaptiveImage );
+            brute.getRenderedImageRGBA8( reference );
+
+            printf( "%-20s %8u %10.3f %12.3f %10.3f %7.2fx %9.1f%% %12.2f %12.2f\n", viewport.name, viewport.maxIter, ms[0], ms[1], ms[2],
+                ms[1] / ms[0], 100.0 * adaptive.getNumEdgePixels() / ( res * res ), psnrRGBA8( singleImage, reference ), psnrRGBA8( adaptiveImage, reference ) );
+        }
+        adaptive.saveRenderedImage( "mandelbrot-antialiased.png" );
+
+        return EXIT_SUCCESS;
+    }
+
+    // Many thumbnails - Mandelbrot zooms and Julia sets, each with its own palette - rendered one by one with
+    // setViewport() / rerun() / recolor() and a readback each (only the Mandelbrot ones, the app renders no Julia sets),
+    // against all of them in one batch dispatch with one readback of the atlas (see MandelbrotApp::setBatch()).
+    // The Mandelbrot thumbnails must match up to the rounding of the different shaders - at least 40 dB PSNR is the
+    // exit code.
+    static int runMandelbrotBatch( const uint32_t numImages = 256, const uint32_t res = 128, const int numRuns = 3 ) {
+        typedef std::chrono::high_resolution_clock clock;
+        typedef MandelbrotApp::fractalParams_t Params;
+
+        std::vector<Params> images;
+        for ( uint32_t i = 0; i < numImages; i++ ) {
+            const float angle = 6.2831853f * i / numImages;
+            Params params = ( i % 2 == 0 )
+                ? Params::makeMandelbrot( -0.7436f, 0.1318f, 2.5f * powf( 0.97f, float( i / 2 ) ), 256 ) // zoom into seahorse valley
+                : Params::makeJulia( 0.7885f * cosf( angle ), 0.7885f * sinf( angle ), 0.0f, 0.0f, 3.2f, 256 ); // c around the origin
+            params.kColor[0] = 0.1f + 0.5f * ( i % 5 ) / 4.0f;
+            params.kColor[1] = 0.7f - 0.4f * ( i % 3 ) / 2.0f;
+            images.push_back( params );
+        }
+
+        // one by one
+        MandelbrotApp single( res, res );
+        single.init();
+        single.preRun();
+        single.run();
+        std::vector<std::vector<uint8_t>> singleImages( numImages );
+        double singleMs = 1e30;
+        for ( int run = 0; run < numRuns; run++ ) {
+            const auto start = clock::now();
+            for ( uint32_t i = 0; i < numImages; i += 2 ) {
+                single.setViewport( images[i].center[0], images[i].center[1], images[i].scale, images[i].maxIter );
+                single.rerun();
+                single.recolor( images[i].kColor, images[i].deParams[0], images[i].deParams[1] );
+                single.getRenderedImageRGBA8( singleImages[i] );
+            }
+            singleMs = std::min( singleMs, std::chrono::duration<double, std::milli>( clock::now() - start ).count() );
+        }
+        const uint32_t numSingle = ( numImages + 1 ) / 2;
+
+        // one batch
+        MandelbrotApp batched( res, res );
+        batched.setBatch( images, res, res );
+        batched.init();
+        batched.preRun();
+        batched.run();
+        std::vector<uint8_t> atlas;
+        double batchMs = 1e30;
+        for ( int run = 0; run < numRuns; run++ ) {
+            const auto start = clock::now();
+            batched.rerun();
+            batched.getRenderedImageRGBA8( atlas );
+            batchMs = std::min( batchMs, std::chrono::duration<double, std::milli>( clock::now() - start ).count() );
+        }
+        batched.saveRenderedImage( "mandelbrot-batch.png" );
+
+        // the Mandelbrot thumbnails out of the atlas, against the ones rendered one by one
+        const uint32_t columns = batched.getResX() / res;
+        std::vector<uint8_t> fromAtlas, oneByOne;
+        size_t numDiffs = 0;
+        for ( uint32_t i = 0; i < numImages; i += 2 ) {
+            for ( uint32_t y = 0; y < res; y++ ) {
+                const size_t atlasRow = ( static_cast<size_t>( ( i / columns ) * res + y ) * batched.getResX() + ( i % columns ) * res ) * 4;
+                fromAtlas.insert( fromAtlas.end(), atlas.begin() + atlasRow, atlas.begin() + atlasRow + res * 4 );
+            }
+            oneByOne.insert( oneByOne.end(), singleImages[i].begin(), singleImages[i].end() );
+        }
+        for ( size_t i = 0; i < fromAtlas.size(); i++ ) {
+            if ( fromAtlas[i] != oneByOne[i] ) { numDiffs++; }
+        }
+        const double psnr = psnrRGBA8( fromAtlas, oneByOne );
+
+        printf( "\n%u images of %ux%u, %u x %u atlas\n", numImages, res, res, batched.getResX(), batched.getResY() );
+        printf( "%-28s %8s %12s %14s\n", "", "images", "total [ms]", "per image [ms]" );
+        printf( "%-28s %8u %12.3f %14.4f\n", "one by one (Mandelbrot only)", numSingle, singleMs, singleMs / numSingle );
+        printf( "%-28s %8u %12.3f %14.4f\n", "batch", numImages, batchMs, batchMs / numImages );
+        printf( "\nMandelbrot thumbnails: %zu differing channels, PSNR %.2f dB %s\n", numDiffs, psnr, psnr >= 40.0 ? "" : "- DIFFER" );
+
+        return psnr >= 40.0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The regression suite of the Mandelbrot renderer (see benchSuite.h): iterating every pixel and the Mariani-Silver
+    // subdivision, at two resolutions and three workgroup sizes, in seahorse valley. The images must be within 40 dB
+    // of the golden images - the subdivision has its own, it is a different shader.
+    static int runBenchSuite( const double tolerance = 0.1, const BenchSuite::GoldenMode goldenMode = BenchSuite::eGoldenWriteMissing,
+                              const int numRuns = 5 ) {
+        const char* kernels[2] = { "mandelbrot-iterate", "mandelbrot-subdivision" };
+        const uint32_t resolutions[2] = { 256, 1024 };
+        const uint32_t workgroupSizes[3] = { 8, 16, 32 };
+        BenchSuite suite( "mandelbrot", tolerance, goldenMode );
+        std::vector<uint8_t> image;
+        for ( int k = 0; k < 2; k++ ) {
+            for ( const uint32_t res : resolutions ) {
+                for ( const uint32_t workgroupSize : workgroupSizes ) {
+                    MandelbrotApp app( res, res, workgroupSize );
+                    app.setSubdivision( k == 1 );
+                    app.setViewport( -0.7436f, 0.1318f, 0.01f, 2048 );
+                    app.setGpuTimestamps( true );
+                    app.init();
+                    app.preRun();
+                    // the device limits shrank the workgroup, that size is measured already
+                    if ( app.getWorkgroupSize() != workgroupSize ) { break; }
+                    app.run();
+                    BenchSuite::Result result;
+                    result.config = BenchSuite::Config{ kernels[k], res, res, 1, workgroupSize, "fp32" };
+                    result.device = app.getPhysicalDeviceInfo().name;
+                    timeRerunsWithReadback( app, numRuns, result.wallMs, result.gpuMs, image );
+                    result.throughput = double( res ) * res / ( ( result.gpuMs > 0.0 ? result.gpuMs : result.wallMs ) * 1e-3 ) * 1e-6;
+                    result.throughputUnit = "Mpixels/s";
+                    suite.add( result, image, 40.0 );
+                }
+            }
+        }
+        return suite.finish();
+    }
+
+#endif // MANDELBROT_MODE
+
+#if defined( PATHTRACER_MODE )
+
+    template< typename T >
+    struct Vec3 {
+        T x, y, z;
+        Vec3 operator+( const Vec3& b ) const { return Vec3{ x + b.x, y + b.y, z + b.z }; }
+        Vec3 operator-( const Vec3& b ) const { return Vec3{ x - b.x, y - b.y, z - b.z }; }
+        Vec3 operator*( const T s ) const { return Vec3{ x * s, y * s, z * s }; }
+    };
+    template< typename T > static T dot( const Vec3<T>& a, const Vec3<T>& b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    template< typename T > static Vec3<T> cross( const Vec3<T>& a, const Vec3<T>& b ) { return Vec3<T>{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+    template< typename T > static Vec3<T> normalize( const Vec3<T>& a ) { return a * ( T( 1 ) / std::sqrt( dot( a, a ) ) ); }
+
+    // The OUTPUT_PRIMARY_HIT ray of pathTracer.comp (pixel center, no jitter) for a camera at camO.
+    static void primaryRay( const uint32_t pixX, const uint32_t pixY, const uint32_t resx, const uint32_t resy, const Vec3<double>& camO, Vec3<double>& o, Vec3<double>& d ) {
+        const Vec3<double> camD = normalize( Vec3<double>{ 0.0, -0.06, -1.0 } );
+        const Vec3<double> cx = normalize( cross( camD, fabs( camD.y ) < 0.9 ? Vec3<double>{ 0, 1, 0 } : Vec3<double>{ 0, 0, 1 } ) );
+        const Vec3<double> cy = cross( cx, camD );
+        const double sx = ( ( pixX + 0.5 ) / double( resx ) - 0.5 ) * 0.036;
+        const double sy = ( ( pixY + 0.5 ) / double( resy ) - 0.5 ) * 0.024;
+        const Vec3<double> spos = camO + cx * sx + cy * sy;
+        const Vec3<double> lc = camO + camD * 0.035;
+        o = lc;
+        d = normalize( lc - spos );
+    }
+
+    struct Hit {
+        double t;
+        int objType; // 0 .. plane, 1 .. sphere, as in pathTracer.comp
+        int objIdx;
+    };
+
+    // fp64 CPU reference of intersect() in pathTracer.comp, on the double precision scene in world coordinates.
+    // The errors reported below therefore include both the quantization of the scene to float and the arithmetic.
+    static bool intersectReference( const Scene& scene, const Vec3<double>& o, const Vec3<double>& d, Hit& hit ) {
+        const double eps = 1e-4, triEps = 1e-7, inf = 1e20;
+        double t = inf;
+        for ( size_t i = 0; i < scene.numPlanes(); i++ ) {
+            const double* p = &scene.planes[ i * Scene::recordSize ];
+            const Vec3<double> n{ p[0], p[1], p[2] };
+            const double denom = dot( d, n );
+            if ( denom > triEps ) {
+                const double dist = ( p[3] - dot( o, n ) ) / denom;
+                if ( dist < t ) { t = dist; hit.objType = 0; hit.objIdx = static_cast<int>( i ); }
+            }
+        }
+        for ( size_t i = 0; i < scene.numSpheres(); i++ ) {
+            const double* sph = &scene.spheres[ i * Scene::recordSize ];
+            const Vec3<double> oc = Vec3<double>{ sph[0], sph[1], sph[2] } - o;
+            const double b = dot( oc, d );
+            double det = b * b - dot( oc, oc ) + sph[3] * sph[3];
+            if ( det < 0.0 ) { continue; }
+            det = sqrt( det );
+            const double dist = ( b - det ) > eps ? ( b - det ) : ( ( b + det ) > eps ? ( b + det ) : inf );
+            if ( dist < t ) { t = dist; hit.objType = 1; hit.objIdx = static_cast<int>( i ); }
+        }
+        hit.t = t;
+        return t < inf;
+    }
+
+    // Renders a test scene with every precision mode the device supports - in world coordinates as well as
+    // camera-relative (see PathtracerApp::setCameraRelative()) - and reports throughput plus the error of the
+    // primary-ray intersections against the fp64 CPU reference.
+    static void runPathtracerPrecisionModes( const Scene& scene, const uint32_t resx, const uint32_t resy, const int32_t spp, const int numRuns ) {
+        printf( "\nscene %s, camera at ( %g, %g, %g ), %ux%u, %d spp\n", scene.name, scene.camera[0], scene.camera[1], scene.camera[2], resx, resy, spp );
+        printf( "%-6s %-8s %12s %14s %14s %14s %12s\n", "mode", "coords", "time [ms]", "Mrays/s", "mean rel err", "max rel err", "wrong hits" );
+
+        const Vec3<double> camO{ scene.camera[0], scene.camera[1], scene.camera[2] };
+
+        std::vector<float> hits;
+        for ( int cameraRelative = 0; cameraRelative < 2; cameraRelative++ ) {
+            for ( int32_t m = 0; m < PathtracerApp::eNumPrecisionModes; m++ ) {
+                const PathtracerApp::PrecisionMode mode = static_cast<PathtracerApp::PrecisionMode>( m );
+                const char* coordsName = cameraRelative ? "camera" : "world";
+
+                // throughput of the full path tracer
+                PathtracerApp render( resx, resy, spp );
+                render.setScene( scene );
+                render.setCameraRelative( cameraRelative != 0 );
+                render.setPrecisionMode( mode );
+                render.init();
+                if ( !render.isPrecisionModeSupported( mode ) ) {
+                    printf( "%-6s %-8s %12s\n", PathtracerApp::precisionModeName( mode ), coordsName, "unsupported" );
+                    continue;
+                }
+                render.preRun();
+                render.run();
+                const double ms = timeReruns( render, numRuns );
+                const double raysPerSec = double( resx ) * resy * spp / ( ms * 1e-3 );
+
+                // accuracy of the primary-ray intersections
+                PathtracerApp primary( resx, resy, 1 );
+                primary.setScene( scene );
+                primary.setCameraRelative( cameraRelative != 0 );
+                primary.setPrecisionMode( mode );
+                primary.setOutputPrimaryHits( true );
+                primary.setReadbackFormat( PathtracerApp::eReadbackFloat ); // the hits are not colors
+                primary.init();
+                primary.preRun();
+                primary.run();
+                primary.getAccumulation( hits );
+
+                double sumRelErr = 0.0, maxRelErr = 0.0;
+                size_t numCompared = 0, numWrongHits = 0;
+                for ( uint32_t y = 0; y < resy; y++ ) {
+                    for ( uint32_t x = 0; x < resx; x++ ) {
+                        const float* gpuHit = &hits[ 4 * ( ( resy - y - 1 ) * resx + x ) ]; // same y-flip as gid in pathTracer.comp
+                        Vec3<double> o, d;
+                        primaryRay( x, y, resx, resy, camO, o, d );
+                        Hit ref;
+                        const bool refHit = intersectReference( scene, o, d, ref );
+                        const bool gpuDidHit = gpuHit[3] > 0.5f;
+                        if ( refHit != gpuDidHit || ( refHit && ( int( gpuHit[1] ) != ref.objType || int( gpuHit[2] ) != ref.objIdx ) ) ) {
+                            numWrongHits++;
+                            continue;
+                        }
+                        if ( !refHit ) { continue; }
+                        const double relErr = fabs( double( gpuHit[0] ) - ref.t ) / ref.t;
+                        sumRelErr += relErr;
+                        maxRelErr = std::max( maxRelErr, relErr );
+                        numCompared++;
+                    }
+                }
+
+                printf( "%-6s %-8s %12.3f %14.3f %14.3e %14.3e %12zu\n",
+                    PathtracerApp::precisionModeName( mode ), coordsName, ms, raysPerSec * 1e-6,
+                    numCompared > 0 ? sumRelErr / numCompared : 0.0, maxRelErr, numWrongHits );
+            }
+        }
+    }
+
+    // The large-sphere-walls test scene, once around the origin and once moved far away from it.
+    static int runPathtracerPrecisionModes( const uint32_t resy = 200, const int32_t spp = 16, const int numRuns = 3 ) {
+        const uint32_t resx = resy * 3 / 2;
+
+        const Scene scene = Scene::makeLargeSphereWalls();
+        runPathtracerPrecisionModes( scene, resx, resy, spp, numRuns );
+
+        const double farOffset[3] = { 1e4, -3e3, 2e4 };
+        Scene farScene = scene.translated( farOffset );
+        farScene.name = "large-sphere-walls, far from origin";
+        runPathtracerPrecisionModes( farScene, resx, resy, spp, numRuns );
+
+        return EXIT_SUCCESS;
+    }
+
+    // Renders the same frame on every device alone, then on all devices together, split by samples and by rows.
+    // Several frames are rendered with each split, the first one with equal shares, the following ones balanced
+    // with the throughput measured in the previous frame.
+    static int runMultiDevice( const uint32_t resy = 400, const int32_t spp = 64, const int numFrames = 3,
+                               const std::vector<MultiDeviceRenderer::SplitMode>& splitModes = { MultiDeviceRenderer::eSplitSamples, MultiDeviceRenderer::eSplitFrame } ) {
+        const uint32_t resx = resy * 3 / 2;
+        const std::vector<std::string> names = VulkanComputeApp::listPhysicalDevices();
+        printf( "\n%u device%s, %ux%u pixels, %d samples per pixel\n", static_cast<uint32_t>( names.size() ), names.size() != 1 ? "s" : "", resx, resy, spp );
+
+        double bestSingleMs = 1e30;
+        for ( int32_t i = 0; i < static_cast<int32_t>( names.size() ) && names.size() > 1; i++ ) {
+            MultiDeviceRenderer single( resx, resy, spp, MultiDeviceRenderer::eSplitSamples, { i } );
+            single.render(); // warm-up
+            const double ms = single.render();
+            printf( "device %d alone (%s): %.1f ms\n", i, names[i].c_str(), ms );
+            bestSingleMs = std::min( bestSingleMs, ms );
+        }
+
+        for ( const MultiDeviceRenderer::SplitMode splitMode : splitModes ) {
+            MultiDeviceRenderer multi( resx, resy, spp, splitMode );
+            printf( "\nsplit by %s\n", MultiDeviceRenderer::splitModeName( splitMode ) );
+            double ms = 0.0;
+            for ( int frame = 0; frame < numFrames; frame++ ) {
+                ms = multi.render();
+                printf( "frame %d:\n", frame );
+                multi.printStats();
+            }
+            if ( names.size() > 1 ) { printf( "speedup over the fastest single device: %.2fx\n", bestSingleMs / ms ); }
+            const std::string filename = std::string( "pathtracer-multi-" ) + MultiDeviceRenderer::splitModeName( splitMode ) + ".png";
+            multi.saveRenderedImage( filename.c_str() );
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Luminance statistics of a frame with every reduction the device supports (see shaders/imageStats.comp):
+    // the time of the statistics pass alone, and the difference to the same statistics computed on the host.
+    static int runImageStatistics( const uint32_t resy = 400, const int32_t spp = 64, const int numRuns = 10 ) {
+        const uint32_t resx = resy * 3 / 2;
+        const PathtracerApp::StatisticsVariant variants[2] = { PathtracerApp::eStatsSubgroups, PathtracerApp::eStatsSharedMemory };
+        printf( "\n%ux%u pixels, %d samples per pixel\n", resx, resy, spp );
+        for ( const PathtracerApp::StatisticsVariant variant : variants ) {
+            PathtracerApp app( resx, resy, spp );
+            app.setStatistics( true, variant );
+            app.setReadbackFormat( PathtracerApp::eReadbackFloat ); // time the statistics pass alone
+            app.init();
+            const char* variantName = variant == PathtracerApp::eStatsSubgroups ? "subgroups" : "shared memory";
+            if ( variant == PathtracerApp::eStatsSubgroups && !app.getPhysicalDeviceInfo().subgroupArithmetic ) {
+                printf( "%s: not supported by the device\n", variantName );
+                continue;
+            }
+            app.preRun();
+            app.run();
+            const ImageStatistics gpu = app.getStatistics();
+
+            std::vector<float> accumulation;
+            app.getAccumulation( accumulation );
+            const auto hostStart = std::chrono::high_resolution_clock::now();
+            const ImageStatistics host = ImageStatistics::compute( accumulation, resx, resy, gpu.tileSize, true );
+            const double hostMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - hostStart ).count();
+
+            // an empty sample range of a finalized frame: only the statistics pass runs
+            app.setSampleRange( spp, spp, false, true );
+            const double passMs = timeReruns( app, numRuns );
+
+            uint32_t histogramDiff = 0;
+            for ( uint32_t i = 0; i < ImageStatistics::kHistogramBins; i++ ) {
+                histogramDiff += static_cast<uint32_t>( abs( static_cast<int>( gpu.histogram[i] ) - static_cast<int>( host.histogram[i] ) ) );
+            }
+            float maxTileDiff = 0.0f;
+            for ( size_t t = 0; t < gpu.tileMean.size(); t++ ) {
+                maxTileDiff = std::max( maxTileDiff, fabsf( gpu.tileMean[t] - host.tileMean[t] ) / std::max( host.tileMean[t], 1e-6f ) );
+            }
+
+            printf( "\n%s: statistics pass %.3f ms (submission included), on the host %.1f ms\n", variantName, passMs, hostMs );
+            gpu.print();
+            printf( "vs. host: mean %.2e, min %.2e, max %.2e (relative), %u pixels in other histogram bins, tile means up to %.2e\n",
+                fabs( gpu.meanLuminance - host.meanLuminance ) / std::max( host.meanLuminance, 1e-12 ),
+                fabsf( gpu.minLuminance - host.minLuminance ) / std::max( host.minLuminance, 1e-12f ),
+                fabsf( gpu.maxLuminance - host.maxLuminance ) / std::max( host.maxLuminance, 1e-12f ),
+                histogramDiff, maxTileDiff );
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Reading back the float accumulation and converting / flipping it on the host vs. the packed 8 bit image of
+    // packImage.comp, in the synchronous mode and with async transfers: bytes per frame, GPU time of the frame,
+    // and the host time from the fetched frame to the RGBA8 image and to a written PNG.
+    static int runReadback( const uint32_t resy = 1080, const int32_t spp = 1, const int numRuns = 5 ) {
+        const uint32_t resx = resy * 16 / 9;
+        const PathtracerApp::ReadbackFormat formats[3] = { PathtracerApp::eReadbackFloat, PathtracerApp::eReadbackRGBA8, PathtracerApp::eReadbackRGB8 };
+        const char* formatNames[3] = { "float", "RGBA8", "RGB8" };
+        printf( "\n%ux%u pixels, %d samples per pixel\n", resx, resy, spp );
+        printf( "%-8s %-6s %12s %12s %14s %12s\n", "format", "async", "readback", "frame [ms]", "to RGBA8 [ms]", "PNG [ms]" );
+        std::vector<uint8_t> reference;
+        bool allIdentical = true;
+        for ( int f = 0; f < 3; f++ ) {
+            for ( int async = 0; async < 2; async++ ) {
+                PathtracerApp app( resx, resy, spp );
+                app.setReadbackFormat( formats[f] );
+                app.setAsyncTransfers( async != 0 );
+                app.init();
+                app.preRun();
+                if ( async != 0 && !app.isAsyncTransfers() ) { continue; } // no timeline semaphores
+                app.run();
+                // rerun() does not go through the readback of the async mode
+                double frameMs = 1e30;
+                for ( int i = 0; i < numRuns; i++ ) {
+                    if ( app.isAsyncTransfers() ) { app.fetchFrame( app.submitFrame() ); }
+                    else { app.rerun(); }
+                    frameMs = std::min( frameMs, app.getLastSubmitMs() );
+                }
+
+                std::vector<uint8_t> image;
+                double convertMs = 1e30, pngMs = 1e30;
+                for ( int i = 0; i < numRuns; i++ ) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    app.getRenderedImageRGBA8( image );
+                    convertMs = std::min( convertMs, std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count() );
+                    start = std::chrono::high_resolution_clock::now();
+                    app.saveRenderedImage( "pathtracer-readback.png" );
+                    pngMs = std::min( pngMs, std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count() );
+                }
+                if ( reference.empty() ) { reference = image; }
+                else if ( image != reference ) { allIdentical = false; }
+
+                printf( "%-8s %-6s %9.2f MB %12.3f %14.3f %12.1f\n", formatNames[f], async != 0 ? "yes" : "no",
+                    app.getReadbackSize() / ( 1024.0 * 1024.0 ), frameMs, convertMs, pngMs );
+            }
+        }
+        remove( "pathtracer-readback.png" );
+        printf( "\nimages %s\n", allIdentical ? "identical" : "DIFFER" );
+        return allIdentical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Low sample counts without and with the denoiser (GPU and host), against a high sample count reference:
+    // PSNR, frame time on the GPU, and the time of the host filter.
+    static int runDenoiser( const uint32_t resy = 240, const int32_t referenceSpp = 1024 ) {
+        const uint32_t resx = resy * 3 / 2;
+        std::vector<uint8_t> reference;
+        double referenceMs = 0.0;
+        {
+            PathtracerApp app( resx, resy, referenceSpp );
+            app.init();
+            app.preRun();
+            app.run();
+            referenceMs = app.getLastSubmitMs();
+            app.getRenderedImageRGBA8( reference );
+        }
+        printf( "\n%ux%u pixels, reference with %d samples per pixel: %.1f ms\n", resx, resy, referenceSpp, referenceMs );
+        printf( "%6s %-10s %10s %12s %12s\n", "spp", "denoiser", "PSNR [dB]", "frame [ms]", "host [ms]" );
+
+        const int32_t sampleCounts[4] = { 8, 16, 32, 64 };
+        const PathtracerApp::DenoiseMode modes[3] = { PathtracerApp::eDenoiseOff, PathtracerApp::eDenoiseGpu, PathtracerApp::eDenoiseCpu };
+        const char* modeNames[3] = { "off", "GPU", "host" };
+        for ( const int32_t spp : sampleCounts ) {
+            for ( int m = 0; m < 3; m++ ) {
+                PathtracerApp app( resx, resy, spp );
+                app.setDenoiser( modes[m] );
+                app.init();
+                app.preRun();
+                app.run();
+                const double frameMs = app.getLastSubmitMs();
+                std::vector<uint8_t> image;
+                const auto start = std::chrono::high_resolution_clock::now();
+                app.getRenderedImageRGBA8( image );
+                const double hostMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count();
+                printf( "%6d %-10s %10.2f %12.2f %12.1f\n", spp, modeNames[m], psnrRGBA8( image, reference ), frameMs, hostMs );
+                if ( spp == 32 && m != 0 ) {
+                    const std::string filename = std::string( "pathtracer-denoised-" ) + modeNames[m] + ".png";
+                    app.saveRenderedImage( filename.c_str() );
+                }
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // The structure-of-arrays scene buffers vs. the array-of-structures records (PathtracerApp::setSceneLayout()),
+    // and the structure-of-arrays with the shared-memory scene cache (setSceneCache()), on the Cornell box and on the
+    // sphere-field scene with thousands of spheres, where the intersection loops dominate the frame: frame time,
+    // bytes read from the storage buffers per object in the intersection loops, and whether all variants render
+    // the same image.
+    static int runSceneLayout( const uint32_t resy = 120, const int32_t spp = 4, const int numRuns = 3 ) {
+        const uint32_t resx = resy * 3 / 2;
+        const size_t sphereCounts[5] = { 0, 500, 1000, 2000, 4000 }; // 0: the Cornell box
+        const PathtracerApp::SceneLayout layouts[3] = { PathtracerApp::eSceneLayoutAos, PathtracerApp::eSceneLayoutSoa, PathtracerApp::eSceneLayoutSoa };
+        const bool caches[3] = { false, false, true };
+        const char* variantNames[3] = { "AoS", "SoA", "SoA+cache" };
+        const uint32_t cacheBytes = 16384;
+        // per plane / sphere: the whole record vs. the geometry only
+        const int bytesPerPlane[2] = { 16, 48 }, bytesPerSphere[2] = { 16, 64 };
+        printf( "\n%ux%u pixels, %d samples per pixel, scene cache of %u bytes\n", resx, resy, spp, cacheBytes );
+        printf( "%-20s %-10s %14s %12s %12s %10s\n", "scene", "variant", "bytes/object", "frame [ms]", "Mrays/s", "speedup" );
+        bool allIdentical = true;
+        for ( const size_t count : sphereCounts ) {
+            const Scene scene = count > 0 ? Scene::makeSphereField( count ) : Scene::makeCornellBox();
+            const std::string sceneName = std::string( scene.name ) + ( count > 0 ? " " + std::to_string( count ) : "" );
+            const size_t numObjects = scene.numPlanes() + scene.numSpheres();
+            std::vector<uint8_t> images[3];
+            double ms[3];
+            for ( int v = 0; v < 3; v++ ) {
+                PathtracerApp app( resx, resy, spp );
+                app.setScene( scene );
+                app.setSceneLayout( layouts[v] );
+                app.setSceneCache( caches[v], cacheBytes );
+                app.setPrecisionMode( PathtracerApp::ePrecisionFp32 );
+                app.init();
+                app.preRun();
+                app.run();
+                ms[v] = timeReruns( app, numRuns );
+                app.getRenderedImageRGBA8( images[v] );
+                // cached objects are not read from the storage buffers - planes first, then spheres
+                const size_t numCached = caches[v] ? std::min<size_t>( cacheBytes / 16, numObjects ) : 0;
+                const size_t cachedPlanes = std::min( numCached, scene.numPlanes() ), cachedSpheres = numCached - cachedPlanes;
+                const int l = layouts[v];
+                const double bytesPerObject = double( bytesPerPlane[l] * ( scene.numPlanes() - cachedPlanes ) +
+                                                      bytesPerSphere[l] * ( scene.numSpheres() - cachedSpheres ) ) / numObjects;
+                printf( "%-20s %-10s %14.1f %12.2f %12.3f %9.2fx\n", sceneName.c_str(), variantNames[v], bytesPerObject, ms[v],
+                    double( resx ) * resy * spp / ( ms[v] * 1e-3 ) * 1e-6, ms[0] / ms[v] );
+                if ( v > 0 && images[v] != images[0] ) { allIdentical = false; }
+            }
+        }
+        printf( "\nimages %s\n", allIdentical ? "identical" : "DIFFER" );
+        return allIdentical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Instanced prototypes (Scene::makeInstancedField()) vs. the same scene expanded into plain spheres
+    // (Scene::flattened()): bytes of the scene on the GPU, time of a re-upload with setScene(), and the frame time -
+    // the expanded scene is only rendered while it is small, since every ray tests every sphere. The image of the
+    // smallest configuration is compared between both, they differ only by the float rounding of the transforms.
+    static int runInstancing( const uint32_t resy = 120, const int32_t spp = 4, const int numRuns = 3 ) {
+        const uint32_t resx = resy * 3 / 2;
+        const size_t configs[3][2] = { { 64, 64 }, { 1000, 1000 }, { 10000, 100 } }; // instances, spheres per prototype
+        const size_t maxRenderedSpheres = 8192;
+        printf( "\n%ux%u pixels, %d samples per pixel\n", resx, resy, spp );
+        printf( "%-12s %-10s %12s %12s %12s %12s\n", "instances", "scene", "spheres", "GPU [MB]", "upload [ms]", "frame [ms]" );
+        double psnr = 0.0;
+        for ( const auto& config : configs ) {
+            const Scene instanced = Scene::makeInstancedField( config[0], config[1] );
+            const Scene scenes[2] = { instanced, instanced.flattened() };
+            const char* sceneNames[2] = { "instanced", "expanded" };
+            std::vector<uint8_t> images[2];
+            for ( int v = 0; v < 2; v++ ) {
+                const size_t numSpheres = scenes[v].numSpheres() + scenes[v].numInstancedSpheres();
+                PathtracerApp app( resx, resy, spp );
+                app.setScene( scenes[v] );
+                app.setPrecisionMode( PathtracerApp::ePrecisionFp32 );
+                app.init();
+                app.preRun();
+                // the buffers exist, so this only converts and copies
+                double uploadMs = 1e30;
+                for ( int i = 0; i < numRuns; i++ ) {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    app.setScene( scenes[v] );
+                    uploadMs = std::min( uploadMs, std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count() );
+                }
+                const std::string instances = std::to_string( config[0] ) + "x" + std::to_string( config[1] );
+                if ( v == 1 && scenes[v].numSpheres() > maxRenderedSpheres ) {
+                    printf( "%-12s %-10s %12zu %12.2f %12.2f %12s\n", instances.c_str(), sceneNames[v], numSpheres, app.getSceneBytes() / ( 1024.0 * 1024.0 ), uploadMs, "skipped" );
+                    continue;
+                }
+                app.run();
+                const double frameMs = timeReruns( app, numRuns );
+                app.getRenderedImageRGBA8( images[v] );
+                printf( "%-12s %-10s %12zu %12.2f %12.2f %12.2f\n", instances.c_str(), sceneNames[v], numSpheres, app.getSceneBytes() / ( 1024.0 * 1024.0 ), uploadMs, frameMs );
+            }
+            if ( psnr == 0.0 && !images[1].empty() ) { psnr = psnrRGBA8( images[0], images[1] ); }
+        }
+        printf( "\ninstanced vs. expanded: PSNR %.2f dB\n", psnr );
+        return EXIT_SUCCESS;
+    }
+
+    // The row-major vs. the tiled / Z-order accumulation buffer (PathtracerApp::setTiledPixels()) with square
+    // workgroups of 4x4 to 32x32 pixels (as far as the device allows). Two workloads: the accumulation of many
+    // cheap samples of the Cornell box, and a single sample with the GPU denoiser, whose 5x5 taps read the
+    // neighbours of every pixel from the accumulation, AOV and scratch buffers. The throughput counts the bytes the
+    // passes read and write in those buffers, not what reaches DRAM - a layout that keeps more of it in the caches
+    // gets a shorter frame and so a higher number. All images must be identical.
+    static int runPixelLayout( const uint32_t resy = 1080, const int32_t spp = 16, const int numRuns = 5 ) {
+        const uint32_t resx = resy * 16 / 9;
+        const uint32_t workgroupSizes[4] = { 4, 8, 16, 32 };
+        const char* workloadNames[2] = { "accumulate", "denoise" };
+        printf( "\n%ux%u pixels, accumulate: %d samples per pixel, denoise: 1 sample per pixel\n", resx, resy, spp );
+        printf( "%-12s %-10s %-8s %12s %12s %10s\n", "workload", "workgroup", "layout", "frame [ms]", "GB/s", "speedup" );
+        std::vector<uint8_t> references[2];
+        bool allIdentical = true;
+        for ( int w = 0; w < 2; w++ ) {
+            const bool denoise = w == 1;
+            const int32_t frameSpp = denoise ? 1 : spp;
+            // per pixel: read and write the radiance of every sample (and the AOVs for the denoiser), then the
+            // 25 taps of color and features and one write per iteration, and the packed readback
+            const Denoiser::Params params;
+            double bytesPerPixel = frameSpp * ( denoise ? 3 * 32.0 : 32.0 ) + 16.0 + 4.0;
+            if ( denoise ) { bytesPerPixel += params.numIterations * ( 25 * ( 32.0 + 16.0 ) + 16.0 ); }
+            const double bytes = bytesPerPixel * resx * resy;
+            for ( const uint32_t workgroupSize : workgroupSizes ) {
+                double linearMs = 0.0;
+                for ( int tiled = 0; tiled < 2; tiled++ ) {
+                    PathtracerApp app( resx, resy, frameSpp, workgroupSize );
+                    app.setTiledPixels( tiled != 0 );
+                    app.setReadbackFormat( PathtracerApp::eReadbackRGBA8 );
+                    if ( denoise ) { app.setDenoiser( PathtracerApp::eDenoiseGpu, params ); }
+                    app.setPrecisionMode( PathtracerApp::ePrecisionFp32 );
+                    app.init();
+                    app.preRun();
+                    // the device limits may have shrunk the workgroup, that size was measured already
+                    if ( app.getWorkgroupSize() != workgroupSize ) { break; }
+                    app.run();
+                    const double ms = timeReruns( app, numRuns );
+                    if ( tiled == 0 ) { linearMs = ms; }
+                    std::vector<uint8_t> image;
+                    app.getRenderedImageRGBA8( image );
+                    if ( references[w].empty() ) { references[w] = image; }
+                    else if ( image != references[w] ) { allIdentical = false; }
+                    const std::string workgroup = std::to_string( workgroupSize ) + "x" + std::to_string( workgroupSize );
+                    printf( "%-12s %-10s %-8s %12.2f %12.1f %9.2fx\n", workloadNames[w], workgroup.c_str(), tiled != 0 ? "tiled" : "linear",
+                        ms, bytes / ( ms * 1e-3 ) * 1e-9, linearMs / ms );
+                }
+            }
+        }
+        printf( "\nimages %s\n", allIdentical ? "identical" : "DIFFER" );
+        return allIdentical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The compact accumulation formats of PathtracerApp::setAccumulationFormat() against the RGBA32F reference:
+    // memory of the accumulation, bytes read and written per sample and pixel, frame time, and the error of the
+    // linear radiance (relative RMSE, largest absolute difference) and of the 8 bit image (PSNR). RGB32F holds the
+    // same floats, so its image must be identical.
+    static int runAccumulationFormats( const uint32_t resy = 720, const int32_t spp = 64, const int numRuns = 3 ) {
+        const uint32_t resx = resy * 16 / 9;
+        printf( "\n%ux%u pixels, %d samples per pixel\n", resx, resy, spp );
+        printf( "%-12s %10s %14s %12s %12s %12s %10s\n", "format", "MB", "bytes/sample", "frame [ms]", "rel. RMSE", "max error", "PSNR [dB]" );
+        std::vector<float> reference;
+        std::vector<uint8_t> referenceImage;
+        bool identical = true;
+        for ( int f = 0; f < AccumulationFormat::eNumFormats; f++ ) {
+            const AccumulationFormat::Format format = static_cast<AccumulationFormat::Format>( f );
+            PathtracerApp app( resx, resy, spp );
+            app.setAccumulationFormat( format );
+            app.setReadbackFormat( PathtracerApp::eReadbackRGBA8 );
+            app.setPrecisionMode( PathtracerApp::ePrecisionFp32 );
+            // not finalized, so that the accumulation is the linear radiance - packImage.comp gamma-encodes it
+            app.setSampleRange( 0, spp, true, false );
+            app.init();
+            app.preRun();
+            app.run();
+            const double ms = timeReruns( app, numRuns );
+            std::vector<float> accumulation;
+            std::vector<uint8_t> image;
+            app.getAccumulation( accumulation );
+            app.getRenderedImageRGBA8( image );
+            if ( f == 0 ) {
+                reference = accumulation;
+                referenceImage = image;
+            }
+            double squaredError = 0.0, squaredReference = 0.0, maxError = 0.0;
+            for ( size_t i = 0; i < accumulation.size(); i++ ) {
+                if ( i % 4 == 3 ) { continue; }
+                const double d = static_cast<double>( accumulation[i] ) - reference[i];
+                squaredError += d * d;
+                squaredReference += static_cast<double>( reference[i] ) * reference[i];
+                maxError = std::max( maxError, fabs( d ) );
+            }
+            const uint32_t bytesPerPixel = AccumulationFormat::bytesPerPixel( format );
+            printf( "%-12s %10.2f %14u %12.2f %12.2e %12.2e %10.2f\n", AccumulationFormat::name( format ),
+                double( bytesPerPixel ) * resx * resy / ( 1024.0 * 1024.0 ), 2 * bytesPerPixel, ms,
+                squaredReference > 0.0 ? sqrt( squaredError / squaredReference ) : 0.0, maxError, psnrRGBA8( image, referenceImage ) );
+            if ( format == AccumulationFormat::eRGB32F && image != referenceImage ) { identical = false; }
+        }
+        printf( "\nRGB32F %s RGBA32F\n", identical ? "identical to" : "DIFFERS from" );
+        return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The performance counters of pathTracer.comp (PathtracerApp::setPerfCounters()) on the Cornell box, the
+    // large-sphere-walls scene and a sphere field, in world coordinates - so that the huge spheres take the
+    // emulated-precision path - with fp32, double-single and native doubles (if the device has them): rays/s,
+    // average path length and precision-fallback rate, and the frame time with and without the counters. The
+    // counters must not change the image. Everything is exported to pathtracer-counters.json, and the tiles of
+    // large-sphere-walls with double-single as heatmaps pathtracer-heatmap-<counter>.png (per camera path).
+    static int runPerfCounters( const uint32_t resy = 240, const int32_t spp = 16, const int numRuns = 3 ) {
+        const uint32_t resx = resy * 3 / 2;
+        const Scene scenes[3] = { Scene::makeCornellBox(), Scene::makeLargeSphereWalls(), Scene::makeSphereField( 1000 ) };
+        const PathtracerApp::PrecisionMode modes[3] = { PathtracerApp::ePrecisionFp32, PathtracerApp::ePrecisionDs, PathtracerApp::ePrecisionFp64 };
+        printf( "\n%ux%u pixels, %d samples per pixel\n", resx, resy, spp );
+        printf( "%-20s %-6s %12s %12s %10s %12s %10s %10s %14s\n", "scene", "mode", "frame [ms]", "counted [ms]", "overhead", "Mrays/s", "hits/path", "rays/path", "fallback rate" );
+        std::string json = "[";
+        bool identical = true;
+        for ( int s = 0; s < 3; s++ ) {
+            const std::string sceneName = std::string( scenes[s].name ) + ( s == 2 ? " " + std::to_string( scenes[s].numSpheres() ) : "" );
+            for ( const PathtracerApp::PrecisionMode mode : modes ) {
+                std::vector<uint8_t> images[2];
+                double ms[2] = { 0.0, 0.0 };
+                PerfCounters counters;
+                for ( int c = 0; c < 2; c++ ) {
+                    PathtracerApp app( resx, resy, spp );
+                    app.setScene( scenes[s] );
+                    app.setCameraRelative( false );
+                    app.setPrecisionMode( mode );
+                    app.setPerfCounters( c != 0 );
+                    app.init();
+                    if ( !app.isPrecisionModeSupported( mode ) ) { break; }
+                    app.preRun();
+                    app.run();
+                    ms[c] = timeReruns( app, numRuns );
+                    app.getRenderedImageRGBA8( images[c] );
+                    if ( c == 1 ) { counters = app.getPerfCounters(); }
+                }
+                if ( images[1].empty() ) {
+                    printf( "%-20s %-6s %12s\n", sceneName.c_str(), PathtracerApp::precisionModeName( mode ), "unsupported" );
+                    continue;
+                }
+                if ( images[1] != images[0] ) { identical = false; }
+                // the throughput of the frame without the counters
+                printf( "%-20s %-6s %12.2f %12.2f %9.1f%% %12.3f %10.3f %10.3f %14.3e\n", sceneName.c_str(), PathtracerApp::precisionModeName( mode ),
+                    ms[0], ms[1], 100.0 * ( ms[1] / ms[0] - 1.0 ), counters.raysPerSecond( ms[0] ) * 1e-6, counters.averagePathLength(),
+                    counters.totals[ PerfCounters::ePaths ] > 0 ? double( counters.totals[ PerfCounters::eRays ] ) / counters.totals[ PerfCounters::ePaths ] : 0.0,
+                    counters.precisionFallbackRate() );
+                json += std::string( json.size() > 1 ? "," : "" ) + "\n  { \"scene\": " + jsonString( sceneName ) + ", \"mode\": " +
+                    jsonString( PathtracerApp::precisionModeName( mode ) ) + ", \"frameMsWithoutCounters\": " + std::to_string( ms[0] ) +
+                    ", \"counters\": " + counters.toJson( ms[1] ) + " }";
+                if ( s == 1 && mode == PathtracerApp::ePrecisionDs ) {
+                    for ( int32_t c = 0; c < PerfCounters::eNumCounters; c++ ) {
+                        const PerfCounters::Counter counter = static_cast<PerfCounters::Counter>( c );
+                        const std::string filename = std::string( "pathtracer-heatmap-" ) + PerfCounters::name( counter ) + ".png";
+                        counters.writeHeatmapPNG( filename.c_str(), counter, counter != PerfCounters::ePaths );
+                    }
+                }
+            }
+        }
+        json += "\n]\n";
+        FILE* file = fopen( "pathtracer-counters.json", "w" );
+        if ( file != NULL ) {
+            fputs( json.c_str(), file );
+            fclose( file );
+        }
+        printf( "\ncounters written to pathtracer-counters.json, images %s\n", identical ? "identical with and without counters" : "DIFFER with counters" );
+        return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The regression suite of the path tracer (see benchSuite.h): the Cornell box at two resolutions and sample
+    // counts, with two workgroup sizes and the precision modes fp32, double-single and native doubles (if the device
+    // has them). The images must be within 35 dB of the golden images - the path tracer reorders more arithmetic
+    // between shader compilers than the Mandelbrot iteration.
+    static int runBenchSuite( const double tolerance = 0.1, const BenchSuite::GoldenMode goldenMode = BenchSuite::eGoldenWriteMissing,
+                              const int numRuns = 3 ) {
+        const uint32_t resolutions[2] = { 120, 360 };
+        const int32_t sampleCounts[2] = { 4, 16 };
+        const uint32_t workgroupSizes[2] = { 8, 16 };
+        const PathtracerApp::PrecisionMode modes[3] = { PathtracerApp::ePrecisionFp32, PathtracerApp::ePrecisionDs, PathtracerApp::ePrecisionFp64 };
+        const Scene scene = Scene::makeCornellBox();
+        BenchSuite suite( "pathtracer", tolerance, goldenMode );
+        std::vector<uint8_t> image;
+        for ( const PathtracerApp::PrecisionMode mode : modes ) {
+            bool supported = true;
+            for ( const uint32_t resy : resolutions ) {
+                if ( !supported ) { break; }
+                const uint32_t resx = resy * 3 / 2;
+                for ( const int32_t spp : sampleCounts ) {
+                    for ( const uint32_t workgroupSize : workgroupSizes ) {
+                        if ( !supported ) { break; }
+                        PathtracerApp app( resx, resy, spp, workgroupSize );
+                        app.setScene( scene );
+                        app.setPrecisionMode( mode );
+                        app.setReadbackFormat( PathtracerApp::eReadbackRGBA8 );
+                        app.setGpuTimestamps( true );
+                        app.init();
+                        supported = app.isPrecisionModeSupported( mode );
+                        if ( !supported ) {
+                            printf( "%s: not supported by the device, skipped\n", PathtracerApp::precisionModeName( mode ) );
+                            break;
+                        }
+                        app.preRun();
+                        // the device limits shrank the workgroup, that size is measured already
+                        if ( app.getWorkgroupSize() != workgroupSize ) { break; }
+                        app.run();
+                        BenchSuite::Result result;
+                        result.config = BenchSuite::Config{ "pathtracer-cornell-box", resx, resy, spp, workgroupSize, PathtracerApp::precisionModeName( mode ) };
+                        result.device = app.getPhysicalDeviceInfo().name;
+                        timeRerunsWithReadback( app, numRuns, result.wallMs, result.gpuMs, image );
+                        result.throughput = double( resx ) * resy * spp / ( ( result.gpuMs > 0.0 ? result.gpuMs : result.wallMs ) * 1e-3 ) * 1e-6;
+                        result.throughputUnit = "Mpaths/s";
+                        suite.add( result, image, 35.0 );
+                    }
+                }
+            }
+        }
+        return suite.finish();
+    }
+
+#endif // PATHTRACER_MODE
+
+    // a batch of small jobs with varying resolution and content, as a batch service would see them
+    static std::vector<RenderJob> makeJobBatch( const int numJobs ) {
+        std::vector<RenderJob> batch( numJobs );
+    #if defined( PATHTRACER_MODE )
+        const std::shared_ptr<const Scene> scenes[2] = {
+            std::make_shared<const Scene>( Scene::makeCornellBox() ),
+            std::make_shared<const Scene>( Scene::makeLargeSphereWalls() ) };
+    #endif
+        for ( int i = 0; i < numJobs; i++ ) {
+            RenderJob& job = batch[i];
+            const uint32_t resy = ( i % 3 == 2 ) ? 256 : 128;
+    #if defined( MANDELBROT_MODE )
+            job.resx = job.resy = resy;
+            job.centerX = -0.7436f;
+            job.centerY = 0.1318f;
+            job.scale = 2.5f * powf( 0.7f, float( i ) ); // zoom into seahorse valley
+            job.maxIter = 256;
+    #elif defined( PATHTRACER_MODE )
+            job.resy = resy;
+            job.resx = resy * 3 / 2;
+            job.spp = 4;
+            job.scene = scenes[ ( i / 4 ) % 2 ];
+    #endif
+        }
+        return batch;
+    }
+
+    // the alternative to a JobRuntime: everything is created from scratch for each job
+    static void renderWithFreshApp( const RenderJob& job ) {
+    #if defined( MANDELBROT_MODE )
+        MandelbrotApp app( job.resx, job.resy );
+        app.setViewport( job.centerX, job.centerY, job.scale, job.maxIter );
+    #elif defined( PATHTRACER_MODE )
+        PathtracerApp app( job.resx, job.resy, job.spp );
+        if ( job.scene ) { app.setScene( *job.scene ); }
+    #endif
+        app.init();
+        app.preRun();
+        app.run();
+    }
+
+    // Renders the same batch of jobs with a fresh app per job and through one JobRuntime
+    // (whose creation is part of the measurement).
+    static int runJobRuntime( const int numJobs = 32 ) {
+        typedef std::chrono::high_resolution_clock clock;
+        const std::vector<RenderJob> batch = makeJobBatch( numJobs );
+
+        const auto freshStart = clock::now();
+        for ( const RenderJob& job : batch ) { renderWithFreshApp( job ); }
+        const double freshMs = std::chrono::duration<double, std::milli>( clock::now() - freshStart ).count();
+
+        const auto runtimeStart = clock::now();
+        JobRuntime runtime;
+        for ( const RenderJob& job : batch ) { runtime.submit( job ); }
+        double gpuMs = 0.0;
+        int numReallocated = 0, numRerecorded = 0;
+        JobResult result;
+        while ( runtime.processNext( &result ) ) {
+            gpuMs += result.gpuMs;
+            numReallocated += result.reallocated ? 1 : 0;
+            numRerecorded += result.rerecorded ? 1 : 0;
+        }
+        const double runtimeMs = std::chrono::duration<double, std::milli>( clock::now() - runtimeStart ).count();
+
+    #if defined( PATHTRACER_MODE )
+        // the readback of a job overlaps the next job, see JobRuntime::processAll()
+        const auto pipelinedStart = clock::now();
+        JobRuntime pipelined( []( PathtracerApp& app ) { app.setAsyncTransfers( true ); } );
+        for ( const RenderJob& job : batch ) { pipelined.submit( job ); }
+        pipelined.processAll();
+        const double pipelinedMs = std::chrono::duration<double, std::milli>( clock::now() - pipelinedStart ).count();
+    #endif
+
+        printf( "\n%d jobs\n", numJobs );
+        printf( "%-22s %12s %12s\n", "", "total [ms]", "per job [ms]" );
+        printf( "%-22s %12.1f %12.2f\n", "fresh app per job", freshMs, freshMs / numJobs );
+        printf( "%-22s %12.1f %12.2f\n", "job runtime", runtimeMs, runtimeMs / numJobs );
+    #if defined( PATHTRACER_MODE )
+        printf( "%-22s %12.1f %12.2f%s\n", "job runtime, async", pipelinedMs, pipelinedMs / numJobs,
+            pipelined.getApp().isAsyncTransfers() ? "" : " (no timeline semaphores, synchronous)" );
+    #endif
+        printf( "job runtime: %.1f ms on the GPU, %d reallocations, %d re-recorded command buffers, speedup %.2fx\n",
+            gpuMs, numReallocated, numRerecorded, freshMs / runtimeMs );
+        return EXIT_SUCCESS;
+    }
+
+} // namespace benchmark
+
+#endif // _BENCHMARK_H_
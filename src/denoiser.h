@@ -0,0 +1,124 @@
+#ifndef _DENOISER_H_
+#define _DENOISER_H_
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010, with the edge-stopping functions of SVGF) for the
+// accumulation of pathTracer.comp, guided by the first-hit features it writes with OUTPUT_AOVS (see
+// PathtracerApp::setDenoiser()): albedo and normal of the first diffuse surface along the camera ray (seen
+// through mirrors and glass), and the distance to the first hit.
+//
+// The radiance is divided by the albedo first, so that the filter only blurs the illumination and textures /
+// material edges stay sharp, and multiplied with it again at the end. Every iteration is a 5x5 B3-spline kernel
+// whose taps are stepWidth = 2^iteration pixels apart, so 5 iterations cover 125x125 pixels. The taps are weighted
+// by the similarity of normal, distance, albedo and luminance to the center pixel - the luminance tolerance is
+// halved with every iteration, since the noise is halved as well.
+//
+// shaders/denoise.comp runs this on the GPU, one dispatch per iteration. denoise() below is the same on the host,
+// as a fallback and a reference.
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+struct Denoiser {
+
+    // of the host and the GPU filter, denoise.comp gets them as push constants
+    struct Params {
+        uint32_t numIterations = 5;     // at least 2, see denoise.comp
+        float    sigmaColor = 1.0f;     // relative luminance difference, of the first iteration
+        float    sigmaNormal = 64.0f;   // exponent of the normal similarity
+        float    sigmaDepth = 0.02f;    // relative distance difference per pixel of the step width
+        float    sigmaAlbedo = 0.1f;
+    };
+
+    // Filters accumulation (4 floats per pixel, linear radiance as pathTracer.comp accumulates it) in place.
+    // aovs: 2 vec4 per pixel, albedo (w: weight) and normal (w: distance, weighted), see pathTracer.comp.
+    static void denoise( std::vector<float>& accumulation, const std::vector<float>& aovs, const uint32_t resx, const uint32_t resy,
+                         const Params& params ) {
+        const size_t numPixels = static_cast<size_t>( resx ) * resy;
+        std::vector<Features> features( numPixels );
+        std::vector<float> src( numPixels * 3 ), dst( numPixels * 3 );
+        for ( size_t i = 0; i < numPixels; i++ ) {
+            features[i] = Features( &aovs[ 8 * i ] );
+            for ( int k = 0; k < 3; k++ ) { src[ 3 * i + k ] = accumulation[ 4 * i + k ] / features[i].demodulation[k]; }
+        }
+
+        const uint32_t numIterations = std::max( params.numIterations, 2u );
+        for ( uint32_t iteration = 0; iteration < numIterations; iteration++ ) {
+            const int step = 1 << iteration;
+            const float sigmaColor = params.sigmaColor * powf( 2.0f, -static_cast<float>( iteration ) );
+            for ( uint32_t y = 0; y < resy; y++ ) {
+                for ( uint32_t x = 0; x < resx; x++ ) {
+                    const size_t p = static_cast<size_t>( y ) * resx + x;
+                    float sum[3] = { 0.0f, 0.0f, 0.0f }, weightSum = 0.0f;
+                    for ( int dy = -2; dy <= 2; dy++ ) {
+                        for ( int dx = -2; dx <= 2; dx++ ) {
+                            const int qx = static_cast<int>( x ) + dx * step, qy = static_cast<int>( y ) + dy * step;
+                            if ( qx < 0 || qy < 0 || qx >= static_cast<int>( resx ) || qy >= static_cast<int>( resy ) ) { continue; }
+                            const size_t q = static_cast<size_t>( qy ) * resx + qx;
+                            const float w = kernel( dx ) * kernel( dy ) *
+                                ( q == p ? 1.0f : edgeStop( &src[ 3 * p ], &src[ 3 * q ], features[p], features[q], step, sigmaColor, params ) );
+                            for ( int k = 0; k < 3; k++ ) { sum[k] += w * src[ 3 * q + k ]; }
+                            weightSum += w;
+                        }
+                    }
+                    for ( int k = 0; k < 3; k++ ) { dst[ 3 * p + k ] = sum[k] / weightSum; }
+                }
+            }
+            src.swap( dst );
+        }
+
+        for ( size_t i = 0; i < numPixels; i++ ) {
+            for ( int k = 0; k < 3; k++ ) { accumulation[ 4 * i + k ] = src[ 3 * i + k ] * features[i].demodulation[k]; }
+        }
+    }
+
+private:
+    // the features of a pixel, normalized by the weight of the samples
+    struct Features {
+        float albedo[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float depth = 0.0f;
+        float demodulation[3] = { 1.0f, 1.0f, 1.0f }; // the albedo, or 1 where it is (almost) black
+
+        Features() {}
+        explicit Features( const float* aov ) {
+            const float weight = aov[3];
+            if ( weight <= 0.0f ) { return; } // no surface was hit
+            float length = 0.0f;
+            for ( int k = 0; k < 3; k++ ) {
+                albedo[k] = aov[k] / weight;
+                demodulation[k] = albedo[k] > 1e-3f ? albedo[k] : 1.0f;
+                length += aov[ 4 + k ] * aov[ 4 + k ];
+            }
+            length = sqrtf( length );
+            for ( int k = 0; k < 3; k++ ) { normal[k] = length > 0.0f ? aov[ 4 + k ] / length : 0.0f; }
+            depth = aov[7] / weight;
+        }
+    };
+
+    // B3 spline
+    static float kernel( const int offset ) {
+        static const float h[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+        return h[ offset + 2 ];
+    }
+
+    static float luminance( const float* c ) { return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]; }
+
+    // same as edgeStop() in denoise.comp
+    static float edgeStop( const float* cp, const float* cq, const Features& fp, const Features& fq, const int step,
+                           const float sigmaColor, const Params& params ) {
+        const float np_nq = fp.normal[0] * fq.normal[0] + fp.normal[1] * fq.normal[1] + fp.normal[2] * fq.normal[2];
+        const float wNormal = powf( std::max( np_nq, 0.0f ), params.sigmaNormal );
+        const float wDepth = expf( -fabsf( fp.depth - fq.depth ) / ( params.sigmaDepth * std::max( fp.depth, 1e-3f ) * step + 1e-6f ) );
+        float albedoDist2 = 0.0f;
+        for ( int k = 0; k < 3; k++ ) { albedoDist2 += ( fp.albedo[k] - fq.albedo[k] ) * ( fp.albedo[k] - fq.albedo[k] ); }
+        const float wAlbedo = expf( -albedoDist2 / ( params.sigmaAlbedo * params.sigmaAlbedo ) );
+        const float lp = luminance( cp ), lq = luminance( cq );
+        const float wColor = expf( -fabsf( lp - lq ) / ( sigmaColor * 0.5f * ( lp + lq ) + 1e-4f ) );
+        return wNormal * wDepth * wAlbedo * wColor;
+    }
+};
+
+#endif // _DENOISER_H_
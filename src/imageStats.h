@@ -0,0 +1,162 @@
+#ifndef _IMAGESTATS_H_
+#define _IMAGESTATS_H_
+
+// Luminance statistics of a rendered frame: min / max / mean / variance, a log-luminance histogram for
+// auto-exposure, and mean and variance per tile - e.g. as a convergence measure that tells which parts of the
+// image need more samples.
+//
+// shaders/imageStats.comp computes them on the GPU in a single pass over the accumulation buffer (see
+// PathtracerApp::setStatistics()), and only the raw records below are read back. compute() is the same on the
+// host, as a reference and for accumulations that were merged on the host (see multiDevice.h).
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+struct ImageStatistics {
+
+    // keep in sync with HISTOGRAM_BINS / STATS_* in imageStats.comp
+    static const uint32_t kHistogramBins = 64;
+    static const uint32_t kHeaderUints = 4 + kHistogramBins; // min, max, 2 unused, histogram
+
+    uint32_t resx = 0, resy = 0;
+    uint32_t tileSize = 0;                  // tiles are tileSize x tileSize pixels, the last row / column may be smaller
+    uint32_t numTilesX = 0, numTilesY = 0;
+    float    logLumRange[2] = { -10.0f, 6.0f }; // log2 of the luminance covered by the histogram
+
+    float  minLuminance = 0.0f, maxLuminance = 0.0f;
+    double meanLuminance = 0.0, luminanceVariance = 0.0;
+    std::vector<uint32_t> histogram;        // kHistogramBins, black pixels are in the first bin
+    std::vector<float>    tileMean;         // numTilesX * numTilesY, rows top to bottom
+    std::vector<float>    tileVariance;
+
+    // size of the raw record of imageStats.comp for the given resolution
+    static uint32_t rawSizeInUints( const uint32_t resx, const uint32_t resy, const uint32_t tileSize ) {
+        return kHeaderUints + 4 * ( ( resx + tileSize - 1 ) / tileSize ) * ( ( resy + tileSize - 1 ) / tileSize );
+    }
+
+    // derives the statistics from the raw record of imageStats.comp
+    static ImageStatistics fromRaw( const uint32_t* raw, const uint32_t resx, const uint32_t resy, const uint32_t tileSize,
+                                    const float logLumMin, const float logLumMax ) {
+        ImageStatistics stats;
+        stats.setup( resx, resy, tileSize, logLumMin, logLumMax );
+        stats.minLuminance = bitsToFloat( raw[0] );
+        stats.maxLuminance = bitsToFloat( raw[1] );
+        stats.histogram.assign( raw + 4, raw + 4 + kHistogramBins );
+
+        std::vector<double> tileSums( stats.tileMean.size() * 2 );
+        for ( size_t t = 0; t < stats.tileMean.size(); t++ ) {
+            const uint32_t* tile = raw + kHeaderUints + 4 * t;
+            tileSums[ 2 * t ] = bitsToFloat( tile[0] );
+            tileSums[ 2 * t + 1 ] = bitsToFloat( tile[1] );
+        }
+        stats.finish( tileSums );
+        return stats;
+    }
+
+    // The same on the host, from an accumulation buffer as written by pathTracer.comp (4 floats per pixel,
+    // rotated by 180 degrees). finalized: the buffer holds the gamma-encoded 8 bit values.
+    static ImageStatistics compute( const std::vector<float>& accumulation, const uint32_t resx, const uint32_t resy, const uint32_t tileSize,
+                                    const bool finalized, const float logLumMin = -10.0f, const float logLumMax = 6.0f ) {
+        ImageStatistics stats;
+        stats.setup( resx, resy, tileSize, logLumMin, logLumMax );
+        stats.histogram.assign( kHistogramBins, 0 );
+        stats.minLuminance = 3.402823466e+38f;
+        std::vector<double> tileSums( stats.tileMean.size() * 2, 0.0 );
+
+        for ( uint32_t y = 0; y < resy; y++ ) {
+            for ( uint32_t x = 0; x < resx; x++ ) {
+                const float* c = &accumulation[ 4 * ( static_cast<size_t>( resy - 1 - y ) * resx + ( resx - 1 - x ) ) ];
+                float rgb[3];
+                for ( int k = 0; k < 3; k++ ) {
+                    rgb[k] = finalized ? powf( std::max( c[k] - 0.5f, 0.0f ) / 255.0f, 1.0f / 0.45f ) : c[k];
+                }
+                const float lum = std::max( 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2], 0.0f );
+                stats.minLuminance = std::min( stats.minLuminance, lum );
+                stats.maxLuminance = std::max( stats.maxLuminance, lum );
+
+                const float t = lum > 0.0f ? ( log2f( lum ) - logLumMin ) / ( logLumMax - logLumMin ) : 0.0f;
+                const float bin = std::min( std::max( t * kHistogramBins, 0.0f ), static_cast<float>( kHistogramBins - 1 ) );
+                stats.histogram[ static_cast<uint32_t>( bin ) ]++;
+
+                const size_t tile = ( y / tileSize ) * stats.numTilesX + x / tileSize;
+                tileSums[ 2 * tile ] += lum;
+                tileSums[ 2 * tile + 1 ] += static_cast<double>( lum ) * lum;
+            }
+        }
+        stats.finish( tileSums );
+        return stats;
+    }
+
+    // the luminance below which the given fraction of the pixels is, from the histogram (at bin resolution)
+    float luminancePercentile( const float fraction ) const {
+        uint32_t total = 0;
+        for ( const uint32_t count : histogram ) { total += count; }
+        uint32_t sum = 0;
+        for ( uint32_t i = 0; i < kHistogramBins; i++ ) {
+            sum += histogram[i];
+            if ( sum >= fraction * total ) {
+                return exp2f( logLumRange[0] + ( i + 1 ) * ( logLumRange[1] - logLumRange[0] ) / kHistogramBins );
+            }
+        }
+        return exp2f( logLumRange[1] );
+    }
+
+    // largest relative standard deviation of a tile - how far the noisiest part of the image is from being converged
+    float maxTileRelativeStdDev() const {
+        float worst = 0.0f;
+        for ( size_t t = 0; t < tileMean.size(); t++ ) {
+            if ( tileMean[t] > 0.0f ) { worst = std::max( worst, sqrtf( tileVariance[t] ) / tileMean[t] ); }
+        }
+        return worst;
+    }
+
+    void print() const {
+        printf( "luminance: min %.4f, max %.4f, mean %.4f, std dev %.4f, median %.4f, 95th percentile %.4f\n",
+            minLuminance, maxLuminance, meanLuminance, sqrt( luminanceVariance ), luminancePercentile( 0.5f ), luminancePercentile( 0.95f ) );
+        printf( "%u x %u tiles of %u px, largest relative std dev of a tile %.3f\n", numTilesX, numTilesY, tileSize, maxTileRelativeStdDev() );
+    }
+
+private:
+    static float bitsToFloat( const uint32_t bits ) {
+        float f;
+        memcpy( &f, &bits, sizeof( f ) );
+        return f;
+    }
+
+    void setup( const uint32_t resx, const uint32_t resy, const uint32_t tileSize, const float logLumMin, const float logLumMax ) {
+        this->resx = resx;
+        this->resy = resy;
+        this->tileSize = tileSize;
+        numTilesX = ( resx + tileSize - 1 ) / tileSize;
+        numTilesY = ( resy + tileSize - 1 ) / tileSize;
+        logLumRange[0] = logLumMin;
+        logLumRange[1] = logLumMax;
+        tileMean.assign( numTilesX * numTilesY, 0.0f );
+        tileVariance.assign( numTilesX * numTilesY, 0.0f );
+    }
+
+    // mean and variance of the tiles and of the image from the per-tile sums of luminance and squared luminance
+    void finish( const std::vector<double>& tileSums ) {
+        double sum = 0.0, sumSquares = 0.0;
+        for ( uint32_t ty = 0; ty < numTilesY; ty++ ) {
+            for ( uint32_t tx = 0; tx < numTilesX; tx++ ) {
+                const size_t t = ty * numTilesX + tx;
+                const double n = static_cast<double>( std::min( tileSize, resx - tx * tileSize ) ) * std::min( tileSize, resy - ty * tileSize );
+                const double mean = tileSums[ 2 * t ] / n;
+                tileMean[t] = static_cast<float>( mean );
+                tileVariance[t] = static_cast<float>( std::max( tileSums[ 2 * t + 1 ] / n - mean * mean, 0.0 ) );
+                sum += tileSums[ 2 * t ];
+                sumSquares += tileSums[ 2 * t + 1 ];
+            }
+        }
+        const double n = static_cast<double>( resx ) * resy;
+        meanLuminance = sum / n;
+        luminanceVariance = std::max( sumSquares / n - meanLuminance * meanLuminance, 0.0 );
+    }
+};
+
+#endif // _IMAGESTATS_H_
@@ -0,0 +1,268 @@
+#ifndef _JOBRUNTIME_H_
+#define _JOBRUNTIME_H_
+
+// A long-lived runtime for batches of render jobs: instance, device, pipelines and buffers are created once,
+// and each job only changes what differs from the previous one - push constants, the resolution (buffers grow
+// on demand and are re-bound to the descriptor set), the scene. Identical jobs even skip re-recording the
+// command buffer.
+//
+// In the async mode of the path tracer (PathtracerApp::setAsyncTransfers()), processAll() pipelines the jobs:
+// job N+1 is submitted before the image of job N is fetched, so the readback of one job overlaps the rendering
+// of the next.
+
+#if defined( MANDELBROT_MODE )
+    #include "mandelbrotApp.h"
+#elif defined( PATHTRACER_MODE )
+    #include "pathtracerApp.h"
+#endif
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+
+#if defined( MANDELBROT_MODE )
+
+struct RenderJob {
+    uint32_t resx = 1024, resy = 1024;
+    float    centerX = -0.445f, centerY = 0.0f, scale = 2.34f; // viewport, see MandelbrotApp::setViewport()
+    uint32_t maxIter = 128;
+    std::string outputFilename; // png, nothing is written if empty
+
+    bool sameRenderAs( const RenderJob& b ) const {
+        return resx == b.resx && resy == b.resy && centerX == b.centerX && centerY == b.centerY && scale == b.scale && maxIter == b.maxIter;
+    }
+    // no buffers have to be re-bound between the two jobs
+    bool sameStateAs( const RenderJob& b ) const {
+        return resx == b.resx && resy == b.resy;
+    }
+};
+typedef MandelbrotApp RuntimeApp;
+
+#elif defined( PATHTRACER_MODE )
+
+struct RenderJob {
+    uint32_t resx = 300, resy = 200;
+    int32_t  spp = 16;
+    std::shared_ptr<const Scene> scene; // NULL keeps the scene of the previous job
+    std::string outputFilename; // png, nothing is written if empty
+
+    bool sameRenderAs( const RenderJob& b ) const {
+        return resx == b.resx && resy == b.resy && spp == b.spp && ( !scene || scene == b.scene );
+    }
+    // no buffers have to be re-bound and no scene has to be uploaded between the two jobs
+    bool sameStateAs( const RenderJob& b ) const {
+        return resx == b.resx && resy == b.resy && ( !scene || scene == b.scene );
+    }
+};
+typedef PathtracerApp RuntimeApp;
+
+#endif
+
+// what processing a job took
+struct JobResult {
+    uint64_t jobId;
+    double   gpuMs;         // submission until the fence was signalled
+    double   totalMs;       // including re-binding, re-recording and writing the image
+    bool     reallocated;   // the buffers had to grow
+    bool     rerecorded;    // the command buffer had to be recorded again
+};
+
+struct JobRuntime {
+
+    // Creates instance, device, buffers and pipelines. The app can be configured (precision mode, ...)
+    // through configure, before the pipelines are built.
+    template< typename Configure >
+    explicit JobRuntime( Configure configure ) : app( createApp() ) {
+        configure( *app );
+        start();
+    }
+
+    JobRuntime() : app( createApp() ) {
+        start();
+    }
+
+    // Jobs with a higher priority are processed first. Among jobs of the same priority, those that share the
+    // state (resolution, scene) of the last rendered job are batched, otherwise it is submission order.
+    // Returns the id of the job.
+    uint64_t submit( const RenderJob& job, const int priority = 0 ) {
+        jobs.push_back( QueuedJob{ nextJobId, priority, job } );
+        return nextJobId++;
+    }
+
+    // removes a job that has not been processed yet
+    bool cancel( const uint64_t jobId ) {
+        for ( auto it = jobs.begin(); it != jobs.end(); ++it ) {
+            if ( it->id == jobId ) { jobs.erase( it ); return true; }
+        }
+        return false;
+    }
+
+    size_t numPendingJobs() const { return jobs.size(); }
+
+    // processes the next pending job (see submit()), returns false if there is none
+    bool processNext( JobResult* pResult = NULL ) {
+        if ( jobs.empty() ) { return false; }
+        const QueuedJob queued = takeNext();
+        const JobResult result = render( queued.id, queued.job );
+        if ( pResult != NULL ) { *pResult = result; }
+        return true;
+    }
+
+    // Processes all pending jobs. The output file of a job is encoded and written while the GPU renders the next
+    // job (see VulkanComputeApp::submitAsync()).
+    void processAll() {
+    #if defined( PATHTRACER_MODE )
+        if ( app->isAsyncTransfers() ) {
+            processAllPipelined();
+            return;
+        }
+    #endif
+        // the image of the previous job, not written yet
+        std::vector<uint8_t> image;
+        RenderJob imageJob;
+        while ( !jobs.empty() ) {
+            const QueuedJob queued = takeNext();
+            const JobResult result = applyJob( queued.id, queued.job );
+            if ( result.rerecorded ) { app->recordCommandBuffer(); }
+            const std::shared_future<double> done = app->submitAsync();
+
+            if ( !imageJob.outputFilename.empty() ) {
+                writePng( imageJob, image );
+                imageJob.outputFilename.clear();
+            }
+
+            done.get();
+            if ( !queued.job.outputFilename.empty() ) {
+                app->getRenderedImageRGBA8( image );
+                imageJob = queued.job;
+            }
+        }
+        if ( !imageJob.outputFilename.empty() ) { writePng( imageJob, image ); }
+    }
+
+    // Renders a job right away, without going through the queue.
+    JobResult render( const uint64_t jobId, const RenderJob& job ) {
+        const auto startTime = std::chrono::high_resolution_clock::now();
+
+        JobResult result = applyJob( jobId, job );
+    #if defined( PATHTRACER_MODE )
+        if ( app->isAsyncTransfers() ) { app->fetchFrame( app->submitFrame() ); }
+        else
+    #endif
+        if ( result.rerecorded ) { app->rerun(); }
+        else { app->runCommandBuffer(); }
+        result.gpuMs = app->getLastSubmitMs();
+
+        if ( !job.outputFilename.empty() ) { app->saveRenderedImage( job.outputFilename.c_str() ); }
+
+        result.totalMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - startTime ).count();
+        return result;
+    }
+
+    RuntimeApp& getApp() { return *app; }
+
+private:
+    // the buffers start small and grow with the jobs
+    static RuntimeApp* createApp() {
+    #if defined( MANDELBROT_MODE )
+        return new RuntimeApp( 64, 64 );
+    #elif defined( PATHTRACER_MODE )
+        return new RuntimeApp( 64, 64, 1 );
+    #endif
+    }
+
+    struct QueuedJob {
+        uint64_t  id;
+        int       priority;
+        RenderJob job;
+    };
+
+    // the next pending job, see submit()
+    QueuedJob takeNext() {
+        size_t next = 0;
+        for ( size_t i = 1; i < jobs.size(); i++ ) {
+            if ( jobs[i].priority > jobs[next].priority ) { next = i; }
+        }
+        if ( hasRendered && !jobs[next].job.sameStateAs( lastJob ) ) {
+            for ( size_t i = next + 1; i < jobs.size(); i++ ) {
+                if ( jobs[i].priority == jobs[next].priority && jobs[i].job.sameStateAs( lastJob ) ) { next = i; break; }
+            }
+        }
+        const QueuedJob queued = jobs[next];
+        jobs.erase( jobs.begin() + next );
+        return queued;
+    }
+
+    // sets up the app for the job - everything but rendering
+    JobResult applyJob( const uint64_t jobId, const RenderJob& job ) {
+        JobResult result = {};
+        result.jobId = jobId;
+        result.rerecorded = !hasRendered || !job.sameRenderAs( lastJob );
+
+    #if defined( MANDELBROT_MODE )
+        result.reallocated = app->resize( job.resx, job.resy );
+        app->setViewport( job.centerX, job.centerY, job.scale, job.maxIter );
+    #elif defined( PATHTRACER_MODE )
+        result.reallocated = app->resize( job.resx, job.resy, job.spp );
+        if ( job.scene && job.scene != lastJob.scene ) { app->setScene( *job.scene ); }
+        const std::shared_ptr<const Scene> previousScene = lastJob.scene;
+    #endif
+
+        lastJob = job;
+    #if defined( PATHTRACER_MODE )
+        if ( !lastJob.scene ) { lastJob.scene = previousScene; } // so that sameRenderAs() compares against the scene in use
+    #endif
+        hasRendered = true;
+        return result;
+    }
+
+#if defined( PATHTRACER_MODE )
+    // Submits job N+1 before fetching (and writing) the image of job N. A job with another state is only applied
+    // once the job in flight is fetched: a resize may reallocate the readback buffer, and the output file of the
+    // job in flight is written with its resolution.
+    void processAllPipelined() {
+        struct InFlight {
+            RenderJob job;
+            uint64_t  frame;
+        };
+        std::deque<InFlight> inFlight;
+        const auto finish = [&]() {
+            const InFlight done = inFlight.front();
+            inFlight.pop_front();
+            app->fetchFrame( done.frame );
+            if ( !done.job.outputFilename.empty() ) { app->saveRenderedImage( done.job.outputFilename.c_str() ); }
+        };
+
+        while ( !jobs.empty() ) {
+            const QueuedJob queued = takeNext();
+            if ( !inFlight.empty() && !queued.job.sameStateAs( lastJob ) ) { finish(); }
+            applyJob( queued.id, queued.job );
+            inFlight.push_back( InFlight{ queued.job, app->submitFrame() } );
+            if ( inFlight.size() > 1 ) { finish(); }
+        }
+        while ( !inFlight.empty() ) { finish(); }
+    }
+#endif
+
+    static void writePng( const RenderJob& job, const std::vector<uint8_t>& image ) {
+        printf( "writing %s\n", job.outputFilename.c_str() );
+        const unsigned error = lodepng::encode( job.outputFilename, image, job.resx, job.resy );
+        if ( error ) { printf( "encoder error %d: %s\n", error, lodepng_error_text( error ) ); }
+    }
+
+    void start() {
+        app->init();
+        app->preRun();
+        app->prepare();
+    }
+
+    std::unique_ptr<RuntimeApp> app;
+    std::deque<QueuedJob> jobs;
+    uint64_t nextJobId = 0;
+
+    RenderJob lastJob;
+    bool hasRendered = false;
+};
+
+#endif // _JOBRUNTIME_H_
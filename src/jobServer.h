@@ -0,0 +1,422 @@
+#ifndef _JOBSERVER_H_
+#define _JOBSERVER_H_
+
+// Daemon mode: renders jobs that arrive on a Unix domain socket with one JobRuntime, so that short jobs pay
+// neither the process startup nor the Vulkan initialization.
+//
+// Every request is one line of JSON (a flat object, see json.h):
+//   render job:  {"id": "a1", "priority": 1, "resx": 300, "resy": 200, "spp": 16, "scene": "cornell-box", "output": "png"}
+//                for the Mandelbrot set: "resx", "resy", "centerX", "centerY", "scale", "maxIter" instead
+//   statistics:  {"cmd": "stats"}
+//   shutdown:    {"cmd": "shutdown"}
+// and is answered with one line of JSON. For "output": "png" (the default) that line is followed by "bytes"
+// bytes of PNG data, for "output": "shm" the RGBA8 pixels are written to the POSIX shared-memory object "shm"
+// instead - the client has to shm_unlink() it after reading. "output": "none" only reports the timings.
+// Answers are sent in the order in which the jobs finish, "id" is echoed to match them.
+//
+// Rendering happens on the thread that serves the socket: while jobs are pending, the socket is only polled
+// between two jobs, so that everything that arrived in the meantime takes part in the scheduling
+// (priorities, batching of jobs with the same state - see JobRuntime::submit()).
+
+#include "jobRuntime.h"
+#include "json.h"
+
+#include "external/lodepng/lodepng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if !defined( _WIN32 )
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+struct JobServer {
+
+    explicit JobServer( const std::string& socketPath ) : socketPath( socketPath ) {
+    #if defined( PATHTRACER_MODE )
+        const Scene namedScenes[] = { Scene::makeCornellBox(), Scene::makeLargeSphereWalls() };
+        for ( const Scene& scene : namedScenes ) {
+            scenes[ scene.name ] = std::make_shared<const Scene>( scene );
+        }
+    #endif
+    }
+
+#if defined( _WIN32 )
+
+    int run() {
+        printf( "the job server needs Unix domain sockets, which are not supported on this platform\n" );
+        return EXIT_FAILURE;
+    }
+
+#else
+
+    ~JobServer() {
+        for ( const auto& client : clients ) { close( client.second.fd ); }
+        if ( listenFd >= 0 ) {
+            close( listenFd );
+            unlink( socketPath.c_str() );
+        }
+    }
+
+    // serves requests until a shutdown request arrives
+    int run() {
+        signal( SIGPIPE, SIG_IGN ); // a client that went away must not kill the server
+
+        listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+        if ( listenFd < 0 ) { throw std::runtime_error( std::string( "socket() failed: " ) + strerror( errno ) ); }
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if ( socketPath.size() >= sizeof( address.sun_path ) ) { throw std::runtime_error( "socket path too long: " + socketPath ); }
+        strncpy( address.sun_path, socketPath.c_str(), sizeof( address.sun_path ) - 1 );
+        unlink( socketPath.c_str() ); // stale socket of a previous run
+        if ( bind( listenFd, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 || listen( listenFd, 16 ) != 0 ) {
+            throw std::runtime_error( "could not listen on " + socketPath + ": " + strerror( errno ) );
+        }
+        printf( "listening on %s\n", socketPath.c_str() );
+
+        while ( !shutdownRequested ) {
+            std::vector<pollfd> pollFds( 1, pollfd{ listenFd, POLLIN, 0 } );
+            std::vector<uint64_t> pollClientIds( 1, 0 );
+            for ( const auto& client : clients ) {
+                pollFds.push_back( pollfd{ client.second.fd, POLLIN, 0 } );
+                pollClientIds.push_back( client.first );
+            }
+
+            // don't block while there is work to do
+            const int timeoutMs = runtime.numPendingJobs() > 0 ? 0 : -1;
+            if ( poll( pollFds.data(), pollFds.size(), timeoutMs ) < 0 ) {
+                if ( errno == EINTR ) { continue; }
+                throw std::runtime_error( std::string( "poll() failed: " ) + strerror( errno ) );
+            }
+
+            if ( pollFds[0].revents & POLLIN ) { acceptClient(); }
+            for ( size_t i = 1; i < pollFds.size(); i++ ) {
+                if ( pollFds[i].revents & ( POLLIN | POLLHUP | POLLERR ) ) { readClient( pollClientIds[i] ); }
+            }
+
+            JobResult result;
+            if ( runtime.processNext( &result ) ) { reply( result ); }
+        }
+
+        printf( "shutting down\n" );
+        return EXIT_SUCCESS;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Client {
+        int fd;
+        std::string inbox; // received bytes that don't form a complete line yet
+    };
+
+    enum OutputKind { eOutputPng, eOutputShm, eOutputNone };
+
+    struct PendingJob {
+        uint64_t          clientId;
+        std::string       requestId; // as JSON value
+        OutputKind        output;
+        clock::time_point received;
+    };
+
+    void acceptClient() {
+        const int fd = accept( listenFd, NULL, NULL );
+        if ( fd < 0 ) { return; }
+        clients[ nextClientId++ ] = Client{ fd, std::string() };
+    }
+
+    void closeClient( const uint64_t clientId ) {
+        const auto it = clients.find( clientId );
+        if ( it == clients.end() ) { return; }
+        close( it->second.fd );
+        clients.erase( it );
+
+        // nobody is waiting for its jobs anymore
+        for ( auto pending = pendingJobs.begin(); pending != pendingJobs.end(); ) {
+            if ( pending->second.clientId == clientId ) {
+                runtime.cancel( pending->first );
+                pending = pendingJobs.erase( pending );
+            } else {
+                ++pending;
+            }
+        }
+    }
+
+    void readClient( const uint64_t clientId ) {
+        const auto it = clients.find( clientId );
+        if ( it == clients.end() ) { return; }
+
+        char buffer[4096];
+        const ssize_t numRead = recv( it->second.fd, buffer, sizeof( buffer ), 0 );
+        if ( numRead <= 0 ) {
+            if ( numRead < 0 && errno == EINTR ) { return; }
+            closeClient( clientId );
+            return;
+        }
+        it->second.inbox.append( buffer, numRead );
+
+        size_t lineEnd;
+        while ( clients.count( clientId ) != 0 && ( lineEnd = clients[ clientId ].inbox.find( '\n' ) ) != std::string::npos ) {
+            const std::string line = clients[ clientId ].inbox.substr( 0, lineEnd );
+            clients[ clientId ].inbox.erase( 0, lineEnd + 1 );
+            handleRequest( clientId, line );
+        }
+        if ( clients.count( clientId ) != 0 && clients[ clientId ].inbox.size() > maxRequestSize ) {
+            sendLine( clientId, "{\"status\":\"error\",\"error\":\"request too long\"}" );
+            closeClient( clientId );
+        }
+    }
+
+    void handleRequest( const uint64_t clientId, const std::string& line ) {
+        if ( line.find_first_not_of( " \t\r" ) == std::string::npos ) { return; }
+
+        JsonObject request;
+        std::string error;
+        if ( !JsonObject::parse( line, request, error ) ) {
+            sendLine( clientId, "{\"status\":\"error\",\"error\":" + jsonString( error ) + "}" );
+            return;
+        }
+
+        const std::string cmd = request.getString( "cmd", "render" );
+        if ( cmd == "stats" ) {
+            sendLine( clientId, statsJson() );
+            return;
+        }
+        if ( cmd == "shutdown" ) {
+            shutdownRequested = true;
+            sendLine( clientId, "{\"status\":\"ok\"}" );
+            return;
+        }
+
+        std::string requestId;
+        if ( request.hasString( "id" ) ) { requestId = jsonString( request.getString( "id", "" ) ); }
+        else if ( request.hasNumber( "id" ) ) { requestId = formatNumber( request.getNumber( "id", 0.0 ) ); }
+
+        RenderJob job;
+        OutputKind output = eOutputPng;
+        const std::string outputName = request.getString( "output", "png" );
+        if ( outputName == "shm" ) { output = eOutputShm; }
+        else if ( outputName == "none" ) { output = eOutputNone; }
+        else if ( outputName != "png" ) { error = "unknown output " + outputName; }
+
+        if ( cmd != "render" ) { error = "unknown cmd " + cmd; }
+        int64_t priority = 0;
+        if ( !error.empty() || !jobFromJson( request, job, error ) ||
+             !integerFromJson( request, "priority", 0, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), priority, error ) ) {
+            sendLine( clientId, "{" + ( requestId.empty() ? std::string() : "\"id\":" + requestId + "," ) +
+                                "\"status\":\"error\",\"error\":" + jsonString( error ) + "}" );
+            return;
+        }
+
+        const uint64_t jobId = runtime.submit( job, static_cast<int>( priority ) );
+        pendingJobs[ jobId ] = PendingJob{ clientId, requestId.empty() ? std::to_string( jobId ) : requestId, output, clock::now() };
+    }
+
+    bool jobFromJson( const JsonObject& request, RenderJob& job, std::string& error ) {
+        int64_t resx = 0, resy = 0;
+    #if defined( MANDELBROT_MODE )
+        int64_t maxIter = 0;
+        if ( !integerFromJson( request, "resx", job.resx, 1, maxResolution, resx, error ) ||
+             !integerFromJson( request, "resy", job.resy, 1, maxResolution, resy, error ) ||
+             !integerFromJson( request, "maxIter", job.maxIter, 1, std::numeric_limits<uint32_t>::max(), maxIter, error ) ) { return false; }
+        job.maxIter = static_cast<uint32_t>( maxIter );
+        const double centerX = request.getNumber( "centerX", job.centerX );
+        const double centerY = request.getNumber( "centerY", job.centerY );
+        const double scale = request.getNumber( "scale", job.scale );
+        const double maxFloat = std::numeric_limits<float>::max();
+        if ( fabs( centerX ) > maxFloat || fabs( centerY ) > maxFloat || fabs( scale ) > maxFloat ) {
+            error = "viewport out of range"; return false;
+        }
+        job.centerX = static_cast<float>( centerX );
+        job.centerY = static_cast<float>( centerY );
+        job.scale = static_cast<float>( scale );
+    #elif defined( PATHTRACER_MODE )
+        int64_t spp = 0;
+        if ( !integerFromJson( request, "resy", job.resy, 1, maxResolution, resy, error ) ||
+             !integerFromJson( request, "resx", resy * 3 / 2, 1, maxResolution, resx, error ) ||
+             !integerFromJson( request, "spp", job.spp, 1, maxSpp, spp, error ) ) { return false; }
+        job.spp = static_cast<int32_t>( spp );
+        if ( request.hasString( "scene" ) ) {
+            const auto scene = scenes.find( request.getString( "scene", "" ) );
+            if ( scene == scenes.end() ) { error = "unknown scene " + request.getString( "scene", "" ); return false; }
+            job.scene = scene->second;
+        }
+    #endif
+        job.resx = static_cast<uint32_t>( resx );
+        job.resy = static_cast<uint32_t>( resy );
+        return true;
+    }
+
+    // The value of key (defaultValue if the request has none) - JSON numbers are doubles, they are checked before
+    // the cast, which is undefined for NaN and values out of range. Returns false and sets error, if the value is
+    // not an integer in [minValue, maxValue].
+    static bool integerFromJson( const JsonObject& request, const std::string& key, const int64_t defaultValue,
+                                 const int64_t minValue, const int64_t maxValue, int64_t& value, std::string& error ) {
+        const double number = request.getNumber( key, static_cast<double>( defaultValue ) );
+        if ( !std::isfinite( number ) || number != floor( number ) ||
+             number < static_cast<double>( minValue ) || number > static_cast<double>( maxValue ) ) {
+            error = key + " must be an integer in [" + std::to_string( minValue ) + ", " + std::to_string( maxValue ) + "]";
+            return false;
+        }
+        value = static_cast<int64_t>( number );
+        return true;
+    }
+
+    void reply( const JobResult& result ) {
+        const auto pendingIt = pendingJobs.find( result.jobId );
+        if ( pendingIt == pendingJobs.end() ) { return; }
+        const PendingJob pending = pendingIt->second;
+        pendingJobs.erase( pendingIt );
+
+        const double latencyMs = std::chrono::duration<double, std::milli>( clock::now() - pending.received ).count();
+        recordLatency( latencyMs );
+
+        RuntimeApp& app = runtime.getApp();
+        const uint32_t width = app.getResX(), height = app.getResY();
+        std::string header = "{\"id\":" + pending.requestId + ",\"status\":\"ok\",\"width\":" + std::to_string( width ) +
+                             ",\"height\":" + std::to_string( height ) +
+                             ",\"queueMs\":" + formatNumber( std::max( 0.0, latencyMs - result.totalMs ) ) +
+                             ",\"renderMs\":" + formatNumber( result.totalMs ) + ",\"gpuMs\":" + formatNumber( result.gpuMs );
+
+        if ( pending.output == eOutputNone ) {
+            sendLine( pending.clientId, header + "}" );
+            return;
+        }
+
+        std::vector<uint8_t> image;
+        app.getRenderedImageRGBA8( image );
+
+        if ( pending.output == eOutputShm ) {
+            const std::string shmName = "/vkcompute-" + std::to_string( getpid() ) + "-" + std::to_string( result.jobId );
+            if ( !writeSharedMemory( shmName, image ) ) {
+                sendLine( pending.clientId, "{\"id\":" + pending.requestId + ",\"status\":\"error\",\"error\":\"could not create shared memory\"}" );
+                return;
+            }
+            sendLine( pending.clientId, header + ",\"format\":\"rgba8\",\"shm\":" + jsonString( shmName ) + ",\"bytes\":" + std::to_string( image.size() ) + "}" );
+            return;
+        }
+
+        std::vector<uint8_t> png;
+        const unsigned error = lodepng::encode( png, image, width, height );
+        if ( error ) {
+            sendLine( pending.clientId, "{\"id\":" + pending.requestId + ",\"status\":\"error\",\"error\":" + jsonString( lodepng_error_text( error ) ) + "}" );
+            return;
+        }
+        if ( sendLine( pending.clientId, header + ",\"format\":\"png\",\"bytes\":" + std::to_string( png.size() ) + "}" ) ) {
+            sendAll( pending.clientId, png.data(), png.size() );
+        }
+    }
+
+    static bool writeSharedMemory( const std::string& name, const std::vector<uint8_t>& data ) {
+        const int fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+        if ( fd < 0 ) { return false; }
+        bool ok = ftruncate( fd, static_cast<off_t>( data.size() ) ) == 0;
+        void* mapped = ok ? mmap( NULL, data.size(), PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+        if ( mapped != MAP_FAILED ) {
+            memcpy( mapped, data.data(), data.size() );
+            munmap( mapped, data.size() );
+        } else {
+            ok = false;
+            shm_unlink( name.c_str() );
+        }
+        close( fd );
+        return ok;
+    }
+
+    bool sendLine( const uint64_t clientId, const std::string& line ) {
+        const std::string data = line + "\n";
+        return sendAll( clientId, data.data(), data.size() );
+    }
+
+    // blocking, a slow client holds up the other jobs - fine for a local front end
+    bool sendAll( const uint64_t clientId, const void* data, size_t size ) {
+        const auto it = clients.find( clientId );
+        if ( it == clients.end() ) { return false; }
+        const char* p = static_cast<const char*>( data );
+        while ( size > 0 ) {
+            const ssize_t numSent = send( it->second.fd, p, size, 0 );
+            if ( numSent < 0 && errno == EINTR ) { continue; }
+            if ( numSent <= 0 ) {
+                closeClient( clientId );
+                return false;
+            }
+            p += numSent;
+            size -= numSent;
+        }
+        return true;
+    }
+
+    void recordLatency( const double latencyMs ) {
+        if ( latencies.size() < maxLatencies ) { latencies.push_back( latencyMs ); }
+        else { latencies[ numJobsDone % maxLatencies ] = latencyMs; }
+        numJobsDone++;
+    }
+
+    // nearest-rank percentile of the last maxLatencies jobs
+    double latencyPercentile( const double p ) const {
+        if ( latencies.empty() ) { return 0.0; }
+        std::vector<double> sorted( latencies );
+        std::sort( sorted.begin(), sorted.end() );
+        const size_t rank = static_cast<size_t>( ceil( p * sorted.size() ) );
+        return sorted[ std::min( sorted.size() - 1, rank > 0 ? rank - 1 : 0 ) ];
+    }
+
+    std::string statsJson() const {
+        return "{\"status\":\"ok\",\"queueDepth\":" + std::to_string( runtime.numPendingJobs() ) +
+               ",\"jobsDone\":" + std::to_string( numJobsDone ) +
+               ",\"clients\":" + std::to_string( clients.size() ) +
+               ",\"latencyP50Ms\":" + formatNumber( latencyPercentile( 0.5 ) ) +
+               ",\"latencyP90Ms\":" + formatNumber( latencyPercentile( 0.9 ) ) +
+               ",\"latencyP99Ms\":" + formatNumber( latencyPercentile( 0.99 ) ) + "}";
+    }
+
+    static std::string formatNumber( const double value ) {
+        char buffer[32];
+        snprintf( buffer, sizeof( buffer ), "%.6g", value );
+        return buffer;
+    }
+
+    static constexpr size_t   maxRequestSize = 64 * 1024;
+    static constexpr size_t   maxLatencies = 1024;
+    static constexpr uint32_t maxResolution = 8192;
+    static constexpr int32_t  maxSpp = 1 << 16;
+
+    int listenFd = -1;
+    bool shutdownRequested = false;
+
+    std::map<uint64_t, Client> clients;
+    uint64_t nextClientId = 1;
+
+    std::map<uint64_t, PendingJob> pendingJobs; // by JobRuntime job id
+
+    std::vector<double> latencies; // ring buffer of the last maxLatencies request latencies
+    uint64_t numJobsDone = 0;
+
+#endif // _WIN32
+
+    std::string socketPath;
+    JobRuntime runtime;
+#if defined( PATHTRACER_MODE )
+    std::map<std::string, std::shared_ptr<const Scene>> scenes; // by Scene::name
+#endif
+};
+
+#endif // _JOBSERVER_H_
@@ -0,0 +1,166 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+
+// Minimal JSON support for the job server: flat objects whose values are numbers, strings or booleans
+// (stored as 1 / 0). Nested objects and arrays are rejected.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <map>
+#include <string>
+
+struct JsonObject {
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> strings;
+
+    bool hasNumber( const std::string& key ) const { return numbers.count( key ) != 0; }
+    bool hasString( const std::string& key ) const { return strings.count( key ) != 0; }
+
+    double getNumber( const std::string& key, const double defaultValue ) const {
+        const auto it = numbers.find( key );
+        return it != numbers.end() ? it->second : defaultValue;
+    }
+    std::string getString( const std::string& key, const std::string& defaultValue ) const {
+        const auto it = strings.find( key );
+        return it != strings.end() ? it->second : defaultValue;
+    }
+
+    // returns false and sets error, if text is not a flat JSON object
+    static bool parse( const std::string& text, JsonObject& object, std::string& error ) {
+        object = JsonObject();
+        size_t pos = 0;
+        skipSpace( text, pos );
+        if ( !consume( text, pos, '{' ) ) { error = "expected '{'"; return false; }
+        skipSpace( text, pos );
+        if ( consume( text, pos, '}' ) ) { return trailingSpaceOnly( text, pos, error ); }
+        for ( ;; ) {
+            std::string key;
+            skipSpace( text, pos );
+            if ( !parseString( text, pos, key ) ) { error = "expected a string key"; return false; }
+            skipSpace( text, pos );
+            if ( !consume( text, pos, ':' ) ) { error = "expected ':' after \"" + key + "\""; return false; }
+            skipSpace( text, pos );
+            if ( pos >= text.size() ) { error = "missing value of \"" + key + "\""; return false; }
+
+            const char c = text[pos];
+            if ( c == '"' ) {
+                std::string value;
+                if ( !parseString( text, pos, value ) ) { error = "bad string value of \"" + key + "\""; return false; }
+                object.strings[key] = value;
+            } else if ( text.compare( pos, 4, "true" ) == 0 ) {
+                object.numbers[key] = 1.0; pos += 4;
+            } else if ( text.compare( pos, 5, "false" ) == 0 ) {
+                object.numbers[key] = 0.0; pos += 5;
+            } else if ( text.compare( pos, 4, "null" ) == 0 ) {
+                pos += 4;
+            } else if ( c == '{' || c == '[' ) {
+                error = "nested value of \"" + key + "\" is not supported"; return false;
+            } else {
+                // strtod() alone would also take nan, inf, hex and a leading '+'
+                const size_t length = numberLength( text, pos );
+                if ( length == 0 ) { error = "bad value of \"" + key + "\""; return false; }
+                const double value = strtod( text.substr( pos, length ).c_str(), NULL );
+                if ( !std::isfinite( value ) ) { error = "value of \"" + key + "\" is out of range"; return false; }
+                object.numbers[key] = value;
+                pos += length;
+            }
+
+            skipSpace( text, pos );
+            if ( consume( text, pos, ',' ) ) { continue; }
+            if ( consume( text, pos, '}' ) ) { return trailingSpaceOnly( text, pos, error ); }
+            error = "expected ',' or '}'";
+            return false;
+        }
+    }
+
+private:
+    static void skipSpace( const std::string& text, size_t& pos ) {
+        while ( pos < text.size() && ( text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n' ) ) { pos++; }
+    }
+
+    static bool consume( const std::string& text, size_t& pos, const char c ) {
+        if ( pos < text.size() && text[pos] == c ) { pos++; return true; }
+        return false;
+    }
+
+    static bool trailingSpaceOnly( const std::string& text, size_t& pos, std::string& error ) {
+        skipSpace( text, pos );
+        if ( pos != text.size() ) { error = "trailing characters after the object"; return false; }
+        return true;
+    }
+
+    // length of the number at pos in the JSON grammar -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, 0 if there is none
+    static size_t numberLength( const std::string& text, const size_t pos ) {
+        size_t end = pos;
+        consume( text, end, '-' );
+        if ( consume( text, end, '0' ) ) {
+        } else if ( end < text.size() && text[end] >= '1' && text[end] <= '9' ) {
+            skipDigits( text, end );
+        } else {
+            return 0;
+        }
+        if ( consume( text, end, '.' ) && skipDigits( text, end ) == 0 ) { return 0; }
+        if ( consume( text, end, 'e' ) || consume( text, end, 'E' ) ) {
+            if ( !consume( text, end, '+' ) ) { consume( text, end, '-' ); }
+            if ( skipDigits( text, end ) == 0 ) { return 0; }
+        }
+        return end - pos;
+    }
+
+    // returns the number of digits skipped
+    static size_t skipDigits( const std::string& text, size_t& pos ) {
+        const size_t begin = pos;
+        while ( pos < text.size() && text[pos] >= '0' && text[pos] <= '9' ) { pos++; }
+        return pos - begin;
+    }
+
+    // escapes other than \uXXXX are supported, which is all our requests need
+    static bool parseString( const std::string& text, size_t& pos, std::string& value ) {
+        if ( !consume( text, pos, '"' ) ) { return false; }
+        value.clear();
+        while ( pos < text.size() ) {
+            const char c = text[pos++];
+            if ( c == '"' ) { return true; }
+            if ( c != '\\' ) { value += c; continue; }
+            if ( pos >= text.size() ) { return false; }
+            const char e = text[pos++];
+            switch ( e ) {
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case 'r': value += '\r'; break;
+                case 'b': value += '\b'; break;
+                case 'f': value += '\f'; break;
+                case '"': case '\\': case '/': value += e; break;
+                default: return false;
+            }
+        }
+        return false;
+    }
+};
+
+// quotes and escapes s for the output of JSON
+static inline std::string jsonString( const std::string& s ) {
+    std::string out = "\"";
+    for ( const char c : s ) {
+        switch ( c ) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ( static_cast<unsigned char>( c ) < 0x20 ) {
+                    char buf[8];
+                    snprintf( buf, sizeof( buf ), "\\u%04x", c );
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+#endif // _JSON_H_
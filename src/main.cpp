@@ -1,4 +1,9 @@
 #include <stdexcept>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
 
 // make sure that one token is defined
 #if !defined( MANDELBROT_MODE ) && !defined( PATHTRACER_MODE )
@@ -9,33 +14,224 @@
     #include "mandelbrotApp.h"
 #elif defined( PATHTRACER_MODE ) 
     #include "pathtracerApp.h"
+    #include "progressivePreview.h"
 #endif
 
+#include "benchmark.h"
+#include "jobServer.h"
+
+
+// every app reads VKCOMPUTE_DEVICE in VulkanComputeApp::findPhysicalDevice(), also those created by the benchmarks and the job runtime
+static void setDeviceSelectorEnv( const char* selector ) {
+#if defined( _WIN32 )
+    _putenv_s( "VKCOMPUTE_DEVICE", selector );
+#else
+    setenv( "VKCOMPUTE_DEVICE", selector, 1 );
+#endif
+}
 
 int main( int argc, char* argv[] ) {
 
     printf( "starting main!\n" );
+
+    // --watch compiles the shaders at runtime and re-renders whenever a shader source changes
+    // --device <name|uuid|index> overrides the device selection (same as the VKCOMPUTE_DEVICE environment variable)
+    // --denoise filters the path traced image with the GPU denoiser (see denoiser.h), --denoise-host on the host
+    bool watch = false;
+    int denoise = 0; // PathtracerApp::DenoiseMode
+    std::vector<char*> args;
+    for ( int i = 0; i < argc; i++ ) {
+        if ( strcmp( argv[i], "--watch" ) == 0 ) { watch = true; }
+        else if ( strcmp( argv[i], "--device" ) == 0 && i + 1 < argc ) { setDeviceSelectorEnv( argv[++i] ); }
+        else if ( strcmp( argv[i], "--denoise" ) == 0 ) { denoise = 1; }
+        else if ( strcmp( argv[i], "--denoise-host" ) == 0 ) { denoise = 2; }
+        else { args.push_back( argv[i] ); }
+    }
+    argc = static_cast<int>( args.size() );
+    argv = args.data();
+
+    // serve [socket path]: render jobs from a Unix domain socket, see jobServer.h
+    if ( argc > 1 && strcmp( argv[1], "serve" ) == 0 ) {
+    #if defined( MANDELBROT_MODE )
+        const char* defaultSocketPath = "/tmp/mandelbrot.sock";
+    #elif defined( PATHTRACER_MODE )
+        const char* defaultSocketPath = "/tmp/pocketpt.sock";
+    #endif
+        try {
+            JobServer server( argc > 2 ? argv[2] : defaultSocketPath );
+            return server.run();
+        }
+        catch (const std::runtime_error& e) {
+            printf("%s\n", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the benchmarks, see benchmark.h - bench-suite [tolerance in %] [--require-golden|--update-golden] is the
+    // benchmark and regression suite, see benchSuite.h
+    struct BenchCommand {
+        const char* name;
+        std::function<int()> run;
+    };
+    const BenchCommand benchCommands[] = {
+        { "bench-suite", [argc, argv]() {
+            double tolerance = 10.0;
+            BenchSuite::GoldenMode goldenMode = BenchSuite::eGoldenWriteMissing;
+            for ( int i = 2; i < argc; i++ ) {
+                if ( strcmp( argv[i], "--require-golden" ) == 0 ) { goldenMode = BenchSuite::eGoldenRequire; }
+                else if ( strcmp( argv[i], "--update-golden" ) == 0 ) { goldenMode = BenchSuite::eGoldenUpdate; }
+                else { tolerance = atof( argv[i] ); }
+            }
+            return benchmark::runBenchSuite( tolerance * 0.01, goldenMode );
+        } },
+        { "bench-jobs",                 []() { return benchmark::runJobRuntime(); } },
+    #if defined( MANDELBROT_MODE )
+        { "bench",                      []() { return benchmark::runMandelbrotInteriorChecks(); } },
+        { "bench-subdivision",          []() { return benchmark::runMandelbrotSubdivision(); } },
+        { "bench-antialiasing",         []() { return benchmark::runMandelbrotAntialiasing(); } },
+        { "bench-batch",                []() { return benchmark::runMandelbrotBatch(); } },
+    #elif defined( PATHTRACER_MODE )
+        { "bench",                      []() { return benchmark::runPathtracerPrecisionModes(); } },
+        { "bench-stats",                []() { return benchmark::runImageStatistics(); } },
+        { "bench-readback",             []() { return benchmark::runReadback(); } },
+        { "bench-denoise",              []() { return benchmark::runDenoiser(); } },
+        { "bench-scene-layout",         []() { return benchmark::runSceneLayout(); } },
+        { "bench-instancing",           []() { return benchmark::runInstancing(); } },
+        { "bench-pixel-layout",         []() { return benchmark::runPixelLayout(); } },
+        { "bench-accumulation-formats", []() { return benchmark::runAccumulationFormats(); } },
+        { "bench-counters",             []() { return benchmark::runPerfCounters(); } },
+    #endif
+    };
+    for ( const BenchCommand& command : benchCommands ) {
+        if ( argc > 1 && strcmp( argv[1], command.name ) == 0 ) {
+            try {
+                return command.run();
+            }
+            catch (const std::runtime_error& e) {
+                printf("%s\n", e.what());
+                return EXIT_FAILURE;
+            }
+        }
+    }
     
 #if defined( MANDELBROT_MODE )
-    MandelbrotApp app = MandelbrotApp( 2000, 2000 ); // dimensions must match shader
+    MandelbrotApp app( 2000, 2000 );
+    (void)denoise; // nothing to denoise
 #elif defined( PATHTRACER_MODE )
+    // preview [spp] [resy]: progressive preview, see progressivePreview.h. Snapshots go to the shared memory
+    // /pocketpt-preview and to pathtracer-preview.png. Commands on stdin restart it: "camera <x> <y> <z>",
+    // "scene <cornell-box|large-sphere-walls>", "quit" - at the end of the input, it quits once the image is finished.
+    if ( argc > 1 && strcmp( argv[1], "preview" ) == 0 ) {
+        try {
+            const uint32_t previewResy = argc > 3 ? static_cast<uint32_t>( atoi( argv[3] ) ) : 600;
+            ProgressivePreview preview( previewResy * 3 / 2, previewResy, argc > 2 ? atoi( argv[2] ) : 500 );
+            preview.setPngOutput( "pathtracer-preview.png", 1000.0 );
+        #if !defined( _WIN32 )
+            preview.setSharedMemoryRing( "/pocketpt-preview" );
+        #endif
+            preview.setKeepAlive( true );
+            std::thread input( [&preview]() {
+                char line[256];
+                while ( fgets( line, sizeof( line ), stdin ) != NULL ) {
+                    double camera[3];
+                    char name[64];
+                    if ( sscanf( line, "camera %lf %lf %lf", &camera[0], &camera[1], &camera[2] ) == 3 ) {
+                        Scene scene = preview.getScene();
+                        for ( int k = 0; k < 3; k++ ) { scene.camera[k] = camera[k]; }
+                        preview.setScene( scene );
+                    } else if ( sscanf( line, "scene %63s", name ) == 1 && strcmp( name, "cornell-box" ) == 0 ) {
+                        preview.setScene( Scene::makeCornellBox() );
+                    } else if ( sscanf( line, "scene %63s", name ) == 1 && strcmp( name, "large-sphere-walls" ) == 0 ) {
+                        preview.setScene( Scene::makeLargeSphereWalls() );
+                    } else if ( strncmp( line, "quit", 4 ) == 0 ) {
+                        preview.stop();
+                        return;
+                    } else {
+                        printf( "unknown command %s", line );
+                    }
+                }
+                preview.setKeepAlive( false );
+            } );
+            int result = EXIT_FAILURE;
+            try {
+                result = preview.run();
+            }
+            catch (...) {
+                input.detach(); // blocked in fgets()
+                throw;
+            }
+            input.join();
+            printf( "first image after %.1f ms, %llu snapshots\n", preview.getTimeToFirstImageMs(),
+                    static_cast<unsigned long long>( preview.getNumSnapshots() ) );
+            return result;
+        }
+        catch (const std::runtime_error& e) {
+            printf("%s\n", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+    // multi [spp] [resy] [samples|frame]: render with all Vulkan devices at once, see multiDevice.h
+    if ( argc > 1 && strcmp( argv[1], "multi" ) == 0 ) {
+        try {
+            std::vector<MultiDeviceRenderer::SplitMode> splitModes = { MultiDeviceRenderer::eSplitSamples, MultiDeviceRenderer::eSplitFrame };
+            if ( argc > 4 ) {
+                if ( strcmp( argv[4], "samples" ) == 0 ) { splitModes = { MultiDeviceRenderer::eSplitSamples }; }
+                else if ( strcmp( argv[4], "frame" ) == 0 ) { splitModes = { MultiDeviceRenderer::eSplitFrame }; }
+                else { throw std::runtime_error( std::string( "unknown split mode " ) + argv[4] ); }
+            }
+            return benchmark::runMultiDevice( argc > 3 ? static_cast<uint32_t>( atoi( argv[3] ) ) : 400,
+                                              argc > 2 ? atoi( argv[2] ) : 64, 3, splitModes );
+        }
+        catch (const std::runtime_error& e) {
+            printf("%s\n", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
     const int32_t spp = argc>1 ? atoi(argv[1]) : 500;    // samples per pixel 
     const uint32_t resy = argc>2 ? static_cast<uint32_t>( atoi(argv[2]) ) : 600;    // vertical pixel resolution
     const uint32_t resx = resy*3/2;	                    // horiziontal pixel resolution
-    PathtracerApp app = PathtracerApp( resx, resy, spp );
+    PathtracerApp app( resx, resy, spp );
+    if ( argc > 3 ) { // precision mode: fp32, fp64, ds, df64, r128 or auto
+        app.setPrecisionMode( PathtracerApp::precisionModeFromName( argv[3] ) );
+    }
+    app.setDenoiser( static_cast<PathtracerApp::DenoiseMode>( denoise ) );
 #endif
 
+    app.setCompileShadersAtRuntime( watch );
     app.init();
     app.preRun();
     printf( "now running app!\n" );
     try {
         app.run();
         app.saveRenderedImage();
+#if defined( MANDELBROT_MODE )
+        // re-coloring only runs the cheap coloring pass on the stored iteration results
+        const float kColor[4]{ 0.9f, 0.1f, 0.3f, 0.0f };
+        app.recolor( kColor );
+        app.saveRenderedImage( "mandelbrot-recolored.png" );
+#endif
     }
     catch (const std::runtime_error& e) {
         printf("%s\n", e.what());
         return EXIT_FAILURE;
     }
 
+    if ( watch ) {
+        printf( "watching the shader sources, press Ctrl+C to quit\n" );
+        for ( ;; ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+            if ( !app.shaderSourcesChanged() ) { continue; }
+            try {
+                app.rebuildComputePipeline();
+                app.rerun();
+                app.saveRenderedImage();
+            }
+            catch (const std::runtime_error& e) { // keep watching, the next save of the shader may fix it
+                printf("%s\n", e.what());
+            }
+        }
+    }
+
     return EXIT_SUCCESS;
 }
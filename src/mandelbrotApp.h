@@ -5,43 +5,317 @@
 
 #include "external/lodepng/lodepng.h" //Used for png encoding.
 
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
 struct MandelbrotApp : public VulkanComputeApp {
 
+    // push constants of the iteration pass (mandelbrot.comp)
+    struct iterPushConst_t {
+        uint32_t imgdim[2];
+        float    center[2];
+        float    scale;
+        uint32_t maxIter;
+    } iterPushConst;
+
+    // push constants of the coloring pass (mandelbrotColor.comp)
+    struct colorPushConst_t {
+        float    kColor[4];
+        uint32_t imgdim[2];
+        float    deParams[2]; // gain, strength of the distance-estimate shading
+    } colorPushConst;
+
+    // push constants of the subdivision pass (mandelbrotTiles.comp), starts with the ones of the iteration pass
+    struct tilePushConst_t {
+        iterPushConst_t iter;
+        uint32_t level;         // of the tiles that the dispatch processes
+        uint32_t rootTileSize;  // edge length of the tiles of level 0 in pixels
+        uint32_t numRootTilesX;
+        uint32_t numRootTiles;
+        uint32_t minTileSize;   // tiles up to this size are computed pixel by pixel instead of split
+        uint32_t maxGroups;     // at most that many workgroups per dispatch, they loop over the remaining tiles
+        uint32_t listCapacity;  // tiles per tile list, see tileBufferSize()
+    } tilePushConst;
+
+    // push constants of the anti-aliasing passes (mandelbrotEdges.comp, mandelbrotSupersample.comp), the
+    // supersampling pass iterates and colors, so it needs both of the above
+    struct aaPushConst_t {
+        float    kColor[4];
+        uint32_t imgdim[2];
+        float    deParams[2];
+        float    center[2];
+        float    scale;
+        uint32_t maxIter;
+        uint32_t samplesPerAxis; // an edge pixel takes samplesPerAxis^2 samples
+        float    edgeThreshold;  // in iterations, see setAntialiasing()
+        uint32_t maxGroups;      // at most that many workgroups in the supersampling pass
+    } aaPushConst;
+
+    // parameters of one image of a batch, see setBatch() - keep in sync with FractalParams in mandelbrotBatch.comp
+    struct fractalParams_t {
+        enum Type : uint32_t { eMandelbrot = 0, eJulia = 1 };
+        float    center[2];   // the region of the plane, as setViewport()
+        float    scale;
+        uint32_t maxIter;
+        float    c[2];        // of a Julia set
+        uint32_t type;
+        uint32_t pad0;
+        float    kColor[4];   // palette, as recolor()
+        float    deParams[2];
+        float    pad1[2];
+
+        static fractalParams_t makeMandelbrot( const float centerX, const float centerY, const float scale, const uint32_t maxIter ) {
+            fractalParams_t params = {};
+            params.type = eMandelbrot;
+            params.center[0] = centerX;
+            params.center[1] = centerY;
+            params.scale = scale;
+            params.maxIter = maxIter;
+            const float kColor[4]{ 0.1f, 0.7f, 0.6f, 0.0f }; // the default palette of the app
+            memcpy( params.kColor, kColor, sizeof( kColor ) );
+            params.deParams[0] = params.deParams[1] = 0.5f;
+            return params;
+        }
+
+        static fractalParams_t makeJulia( const float cRe, const float cIm, const float centerX, const float centerY, const float scale, const uint32_t maxIter ) {
+            fractalParams_t params = makeMandelbrot( centerX, centerY, scale, maxIter );
+            params.type = eJulia;
+            params.c[0] = cRe;
+            params.c[1] = cIm;
+            return params;
+        }
+    };
+
+    // push constants of the batch pass (mandelbrotBatch.comp)
+    struct batchPushConst_t {
+        uint32_t imgdim[2];     // of one image
+        uint32_t atlasColumns;
+        uint32_t firstImage;    // of the dispatch
+        uint32_t numImages;
+    } batchPushConst;
+
     MandelbrotApp( const uint32_t resx, const uint32_t resy, const uint32_t workgroupSize = 32 ) {
         this->resx = resx;
         this->resy = resy;
         this->workgroupSize = workgroupSize;
-        
-        // Buffer size of the storage buffer that will contain the rendered mandelbrot set.
-        bufferSize = sizeof(Pixel) * resx * resy;
+
+        // Both the packed samples and the RGBA8 colors take 4 bytes per pixel.
+        bufferSize = sizeof(uint32_t) * resx * resy;
+        sampleBufferSize = sizeof(uint32_t) * resx * resy;
+
+        iterPushConst.imgdim[0] = resx;
+        iterPushConst.imgdim[1] = resy;
+        iterPushConst.center[0] = -0.445f;
+        iterPushConst.center[1] = 0.0f;
+        iterPushConst.scale = 2.0f + 1.7f * 0.2f;
+        iterPushConst.maxIter = 128;
+
+        const float kColor[4]{ 0.1f, 0.7f, 0.6f, 0.0f };
+        memcpy( colorPushConst.kColor, kColor, sizeof( kColor ) );
+        colorPushConst.imgdim[0] = resx;
+        colorPushConst.imgdim[1] = resy;
+        colorPushConst.deParams[0] = 0.5f;
+        colorPushConst.deParams[1] = 0.5f;
+
+        tilePushConst.rootTileSize = 64;
+        tilePushConst.minTileSize = 8;
+
+        aaPushConst.samplesPerAxis = 4;
+        aaPushConst.edgeThreshold = 1.0f;
     }
 
     virtual ~MandelbrotApp() {
+        waitAsyncSubmissions(); // see VulkanComputeApp::submitAsync()
+        destroyComputePipeline();
+        vkFreeMemory(device, sampleBufferMemory, NULL);
+        vkDestroyBuffer(device, sampleBuffer, NULL);
+        vkFreeMemory(device, tileBufferMemory, NULL);
+        vkDestroyBuffer(device, tileBuffer, NULL);
+        vkFreeMemory(device, edgeBufferMemory, NULL);
+        vkDestroyBuffer(device, edgeBuffer, NULL);
+        vkFreeMemory(device, paramBufferMemory, NULL);
+        vkDestroyBuffer(device, paramBuffer, NULL);
+    }
+
+    // Enables the cardioid/bulb test and the cycle detection of the iteration pass (specialization constant 0 of mandelbrot.comp).
+    // Must be called before run(), since it is baked into the pipeline.
+    void setInteriorChecks( const bool enabled ) {
+        interiorChecks = enabled;
+    }
+
+    // Mariani-Silver subdivision: instead of iterating every pixel, the image is cut into tiles of rootTileSize pixels,
+    // and only the border of a tile is iterated. If the whole border is interior (does not escape within maxIter), the
+    // inside of the tile is taken as interior too and filled without iterating it - otherwise the tile is split into
+    // four, down to minTileSize. The tile lists of the levels stay on the GPU, each level is a vkCmdDispatchIndirect()
+    // of the tiles that the previous level appended (see shaders/mandelbrotTiles.comp). The border is only sampled at
+    // the pixels, so the fill is a heuristic, but the samples are the same as without it in practice (checked by
+    // benchmark::runMandelbrotSubdivision()), and the coloring pass is unchanged. Pays off for views with large interior areas and many iterations.
+    // Must be called before run().
+    void setSubdivision( const bool enabled, const uint32_t rootTileSize = 64, const uint32_t minTileSize = 8 ) {
+        // the tile records hold the edge lengths in 8 bits, and a tile of less than 4 pixels is all border
+        if ( rootTileSize > 128 || minTileSize < 4 || minTileSize > rootTileSize ) {
+            throw std::runtime_error( "setSubdivision(): need 4 <= minTileSize <= rootTileSize <= 128" );
+        }
+        subdivision = enabled;
+        tilePushConst.rootTileSize = rootTileSize;
+        tilePushConst.minTileSize = minTileSize;
+    }
+
+    // Adaptive anti-aliasing: the iteration pass takes one sample per pixel, at the pixel corner. An edge detection
+    // pass then compares each sample with its four neighbours, and compacts the pixels that need more samples into a
+    // list on the GPU: interior next to exterior, a continuous iteration count that differs by more than
+    // edgeThreshold iterations, or an exterior pixel with the set boundary closer than a pixel (see
+    // shaders/mandelbrotEdges.comp). An indirect dispatch over that list takes samplesPerAxis^2 stratified, jittered
+    // samples per edge pixel and replaces its color with their average (shaders/mandelbrotSupersample.comp). Since
+    // edges are a small part of the image, this costs a fraction of supersampling every pixel. A negative
+    // edgeThreshold makes every pixel an edge pixel - brute-force supersampling, as a reference.
+    // Must be called before run().
+    void setAntialiasing( const bool enabled, const uint32_t samplesPerAxis = 4, const float edgeThreshold = 1.0f ) {
+        if ( samplesPerAxis < 1 || samplesPerAxis > 16 ) {
+            throw std::runtime_error( "setAntialiasing(): need 1 <= samplesPerAxis <= 16" );
+        }
+        antialiasing = enabled;
+        aaPushConst.samplesPerAxis = samplesPerAxis;
+        aaPushConst.edgeThreshold = edgeThreshold;
+    }
+
+    // Batch mode: run() / rerun() render all images of the batch - Mandelbrot or Julia sets, each with its own
+    // region, iterations and palette - in one dispatch, instead of the single image. gl_GlobalInvocationID.z is the
+    // image (see shaders/mandelbrotBatch.comp). The images of imageResX x imageResY pixels are packed into an atlas of
+    // atlasColumns columns (0: as square as possible), which is the output image of the app: getRenderedImageRGBA8()
+    // and saveRenderedImage() read back all images at once. The atlas is iterated and colored in one pass, so
+    // getSamples(), recolor(), the subdivision and the anti-aliasing do not apply to it.
+    // The first call must be before run(), since it creates the pipeline. Later calls change the images, and take
+    // effect with the next rerun().
+    void setBatch( const std::vector<fractalParams_t>& images, const uint32_t imageResX, const uint32_t imageResY, const uint32_t atlasColumns = 0 ) {
+        if ( images.empty() ) { throw std::runtime_error( "setBatch(): no images" ); }
+        if ( pipelineLayout != VK_NULL_HANDLE && batchPipeline == VK_NULL_HANDLE ) {
+            throw std::runtime_error( "setBatch(): the first call must be before run()" );
+        }
+        batch = true;
+        batchParams = images;
+        const uint32_t numImages = static_cast<uint32_t>( images.size() );
+        const uint32_t columns = atlasColumns > 0 ? atlasColumns : static_cast<uint32_t>( ceil( sqrt( static_cast<double>( numImages ) ) ) );
+        const uint32_t rows = ( numImages + columns - 1 ) / columns;
+        batchPushConst.imgdim[0] = imageResX;
+        batchPushConst.imgdim[1] = imageResY;
+        batchPushConst.atlasColumns = columns;
+        batchPushConst.numImages = numImages;
+        resize( columns * imageResX, rows * imageResY );
+    }
+
+    // Changes the region of the complex plane that is rendered. Takes effect with the next run() / rerun().
+    void setViewport( const float centerX, const float centerY, const float scale, const uint32_t maxIter ) {
+        iterPushConst.center[0] = centerX;
+        iterPushConst.center[1] = centerY;
+        iterPushConst.scale = scale;
+        iterPushConst.maxIter = maxIter;
+    }
+
+    // Copies the packed iteration results of the last run to the host.
+    void getSamples( std::vector<uint32_t>& samples ) {
+        void* mappedMemory = NULL;
+        vkMapMemory(device, sampleBufferMemory, 0, sampleBufferSize, 0, &mappedMemory);
+        samples.resize( resx * resy );
+        memcpy( samples.data(), mappedMemory, sampleBufferSize );
+        vkUnmapMemory(device, sampleBufferMemory);
+    }
+
+    // Number of pixels that the last run supersampled, see setAntialiasing().
+    uint32_t getNumEdgePixels() {
+        if ( !antialiasing ) { return 0; }
+        void* mappedMemory = NULL;
+        vkMapMemory(device, edgeBufferMemory, 0, 16, 0, &mappedMemory);
+        const uint32_t numEdgePixels = static_cast<const uint32_t*>( mappedMemory )[3]; // edgeDispatch.w
+        vkUnmapMemory(device, edgeBufferMemory);
+        return numEdgePixels;
     }
-    
+
+    // square workgroups of the iteration and coloring passes, fitted to the device limits in preRun()
+    uint32_t getWorkgroupSize() const { return workgroupSize; }
+
+    virtual void fitToDeviceLimits() override {
+        workgroupSize = fitWorkgroupSize( workgroupSize );
+        checkDispatchSize( resx, resy, workgroupSize );
+    }
+
     virtual void preRun() override {
         printf( " * before createBuffer()\n" ); fflush( stdout );
-        createBuffer( bufferSize ); // output buffer
+        createBuffer( sampleBufferSize, sampleBuffer, sampleBufferMemory ); // packed iteration results
+        createBuffer( bufferSize ); // output buffer (RGBA8)
+        bufferCapacity = bufferSize;
+
+        // the tile lists are only touched by the GPU, and read by vkCmdDispatchIndirect() - without subdivision, a
+        // placeholder for binding 2
+        tileBufferCapacity = tileBufferSize();
+        createBuffer( tileBufferCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      tileBuffer, tileBufferMemory );
+
+        // the same for the edge pixels of the anti-aliasing - host-visible, since getNumEdgePixels() reads the count
+        edgeBufferCapacity = edgeBufferSize();
+        createBuffer( edgeBufferCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      edgeBuffer, edgeBufferMemory );
+
+        // the parameters of the batch are written by the host before each run
+        paramBufferCapacity = paramBufferSize();
+        createBuffer( paramBufferCapacity, paramBuffer, paramBufferMemory );
+    }
+
+    // Changes the resolution after preRun(), e.g. for the next job of a JobRuntime. The buffers only grow,
+    // so going back to a smaller resolution neither reallocates nor touches the descriptor set.
+    // Takes effect with the next rerun(). Returns true, if the buffers had to be reallocated.
+    bool resize( const uint32_t resx, const uint32_t resy ) {
+        this->resx = resx;
+        this->resy = resy;
+        bufferSize = sizeof(uint32_t) * resx * resy;
+        sampleBufferSize = sizeof(uint32_t) * resx * resy;
+        iterPushConst.imgdim[0] = colorPushConst.imgdim[0] = resx;
+        iterPushConst.imgdim[1] = colorPushConst.imgdim[1] = resy;
+
+        // before preRun(), which allocates the buffers for the current resolution
+        if ( bufferCapacity == 0 ) { return false; }
+
+        // the tile lists depend on the aspect ratio as well, so they can grow without the image
+        if ( bufferSize <= bufferCapacity && tileBufferSize() <= tileBufferCapacity && edgeBufferSize() <= edgeBufferCapacity &&
+             paramBufferSize() <= paramBufferCapacity ) { return false; }
+
+        VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+        destroyBuffer( sampleBuffer, sampleBufferMemory );
+        destroyBuffer( buffer, bufferMemory );
+        destroyBuffer( tileBuffer, tileBufferMemory );
+        destroyBuffer( edgeBuffer, edgeBufferMemory );
+        destroyBuffer( paramBuffer, paramBufferMemory );
+        preRun();
+        if ( descriptorSet != VK_NULL_HANDLE ) { updateDescriptorSet(); }
+        return true;
     }
 
+    uint32_t getResX() const { return resx; }
+    uint32_t getResY() const { return resy; }
+
     virtual void createDescriptorSet() override {
 
         // So we will allocate a descriptor set here.
         // But we need to first create a descriptor pool to do that.
 
-    
+
         VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
         descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         descriptorPoolCreateInfo.maxSets = 1; // we only need to allocate one descriptor set from the pool.
         /*
-        Our descriptor pool can only allocate a single storage buffer.
+        Our descriptor pool holds five storage buffers: the packed samples, the colors, the tile lists, the edge pixels and
+        the parameters of the batch.
         */
         VkDescriptorPoolSize descriptorPoolSize = {};
         descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorPoolSize.descriptorCount = 1;
+        descriptorPoolSize.descriptorCount = 5;
         descriptorPoolCreateInfo.poolSizeCount = 1;
         descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
-        
+
         printf( "before vkCreateDescriptorPool()\n" ); fflush( stdout );
         // create descriptor pool.
         VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, NULL, &descriptorPool));
@@ -61,38 +335,112 @@ struct MandelbrotApp : public VulkanComputeApp {
         VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
         printf( "after vkAllocateDescriptorSets()\n" ); fflush( stdout );
 
-        // Next, we need to connect our actual storage buffer with the descrptor.
-        // We use vkUpdateDescriptorSets() to update the descriptor set.
+        updateDescriptorSet();
+    }
+
+    // Next, we need to connect our actual storage buffers with the descrptors.
+    // We use vkUpdateDescriptorSets() to update the descriptor set - again whenever resize() reallocates the buffers.
+    void updateDescriptorSet() {
+
+        // Specify the buffers to bind to the descriptors.
+        // The whole buffers are bound, since they may be larger than the current resolution needs (see resize()).
+        VkDescriptorBufferInfo descriptorSampleBufferInfo = {};
+        descriptorSampleBufferInfo.buffer = sampleBuffer;
+        descriptorSampleBufferInfo.offset = 0;
+        descriptorSampleBufferInfo.range = VK_WHOLE_SIZE;
 
-        // Specify the buffer to bind to the descriptor.
         VkDescriptorBufferInfo descriptorBufferInfo = {};
         descriptorBufferInfo.buffer = buffer;
         descriptorBufferInfo.offset = 0;
-        descriptorBufferInfo.range = bufferSize; // VK_WHOLE_SIZE
-
-        VkWriteDescriptorSet writeDescriptorSet = {};
-        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSet.dstSet = descriptorSet; // write to this descriptor set.
-        writeDescriptorSet.dstBinding = 0; // write to the first, and only binding.
-        writeDescriptorSet.descriptorCount = 1; // update a single descriptor.
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // storage buffer.
-        writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
+        descriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+        VkDescriptorBufferInfo descriptorTileBufferInfo = {};
+        descriptorTileBufferInfo.buffer = tileBuffer;
+        descriptorTileBufferInfo.offset = 0;
+        descriptorTileBufferInfo.range = VK_WHOLE_SIZE;
+
+        VkDescriptorBufferInfo descriptorEdgeBufferInfo = {};
+        descriptorEdgeBufferInfo.buffer = edgeBuffer;
+        descriptorEdgeBufferInfo.offset = 0;
+        descriptorEdgeBufferInfo.range = VK_WHOLE_SIZE;
+
+        VkDescriptorBufferInfo descriptorParamBufferInfo = {};
+        descriptorParamBufferInfo.buffer = paramBuffer;
+        descriptorParamBufferInfo.offset = 0;
+        descriptorParamBufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writeDescriptorSet[5] = {};
+        writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[0].dstSet = descriptorSet; // write to this descriptor set.
+        writeDescriptorSet[0].dstBinding = 0; // samples
+        writeDescriptorSet[0].descriptorCount = 1; // update a single descriptor.
+        writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // storage buffer.
+        writeDescriptorSet[0].pBufferInfo = &descriptorSampleBufferInfo;
+
+        writeDescriptorSet[1] = writeDescriptorSet[0];
+        writeDescriptorSet[1].dstBinding = 1; // colors
+        writeDescriptorSet[1].pBufferInfo = &descriptorBufferInfo;
+
+        writeDescriptorSet[2] = writeDescriptorSet[0];
+        writeDescriptorSet[2].dstBinding = 2; // tile lists
+        writeDescriptorSet[2].pBufferInfo = &descriptorTileBufferInfo;
+
+        writeDescriptorSet[3] = writeDescriptorSet[0];
+        writeDescriptorSet[3].dstBinding = 3; // edge pixels
+        writeDescriptorSet[3].pBufferInfo = &descriptorEdgeBufferInfo;
+
+        writeDescriptorSet[4] = writeDescriptorSet[0];
+        writeDescriptorSet[4].dstBinding = 4; // parameters of the batch
+        writeDescriptorSet[4].pBufferInfo = &descriptorParamBufferInfo;
 
         printf( "before vkUpdateDescriptorSets MANDELBROT_MODE\n" ); fflush( stdout );
 
         // perform the update of the descriptor set.
-        vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+        vkUpdateDescriptorSets(device, 5, writeDescriptorSet, 0, NULL);
+
 
-    
         printf( "after vkUpdateDescriptorSets\n" ); fflush( stdout );
     }
 
+    virtual void destroyComputePipeline() override {
+        vkDestroyPipeline(device, colorPipeline, NULL);
+        vkDestroyShaderModule(device, colorShaderModule, NULL);
+        colorPipeline = VK_NULL_HANDLE;
+        colorShaderModule = VK_NULL_HANDLE;
+        vkDestroyPipeline(device, tilesPipeline, NULL);
+        vkDestroyShaderModule(device, tilesShaderModule, NULL);
+        tilesPipeline = VK_NULL_HANDLE;
+        tilesShaderModule = VK_NULL_HANDLE;
+        vkDestroyPipeline(device, edgesPipeline, NULL);
+        vkDestroyShaderModule(device, edgesShaderModule, NULL);
+        vkDestroyPipeline(device, supersamplePipeline, NULL);
+        vkDestroyShaderModule(device, supersampleShaderModule, NULL);
+        edgesPipeline = supersamplePipeline = VK_NULL_HANDLE;
+        edgesShaderModule = supersampleShaderModule = VK_NULL_HANDLE;
+        vkDestroyPipeline(device, batchPipeline, NULL);
+        vkDestroyShaderModule(device, batchShaderModule, NULL);
+        batchPipeline = VK_NULL_HANDLE;
+        batchShaderModule = VK_NULL_HANDLE;
+        VulkanComputeApp::destroyComputePipeline();
+    }
+
     virtual void createComputePipeline() override {
 
-        createShader( "shaders/mandelbrot.generated.spv", computeShaderModule );
+        loadShader( "shaders/mandelbrot.comp", {}, "shaders/mandelbrot.generated.spv", computeShaderModule );
+        loadShader( "shaders/mandelbrotColor.comp", {}, "shaders/mandelbrotColor.generated.spv", colorShaderModule );
+        if ( subdivision ) {
+            loadShader( "shaders/mandelbrotTiles.comp", {}, "shaders/mandelbrotTiles.generated.spv", tilesShaderModule );
+        }
+        if ( antialiasing ) {
+            loadShader( "shaders/mandelbrotEdges.comp", {}, "shaders/mandelbrotEdges.generated.spv", edgesShaderModule );
+            loadShader( "shaders/mandelbrotSupersample.comp", {}, "shaders/mandelbrotSupersample.generated.spv", supersampleShaderModule );
+        }
+        if ( batch ) {
+            loadShader( "shaders/mandelbrotBatch.comp", {}, "shaders/mandelbrotBatch.generated.spv", batchShaderModule );
+        }
 
         /*
-        Now let us actually create the compute pipeline.
+        Now let us actually create the compute pipelines.
         A compute pipeline is very simple compared to a graphics pipeline.
         It only consists of a single stage with a compute shader.
 
@@ -104,12 +452,35 @@ struct MandelbrotApp : public VulkanComputeApp {
         shaderStageCreateInfo.module = computeShaderModule;
         shaderStageCreateInfo.pName = "main";
 
+        // specialization constants are fixed at pipeline creation time, so the compiler can remove the disabled code paths
+        struct specData_t {
+            VkBool32 interiorChecks;    // constant_id = 0, the passes that iterate
+            uint32_t workgroupSizeX;    // local_size_x_id = 1
+            uint32_t workgroupSizeY;    // local_size_y_id = 2
+        } specData = { interiorChecks ? VK_TRUE : VK_FALSE, workgroupSize, workgroupSize };
+
+        VkSpecializationMapEntry specializationMapEntries[3] = {
+            { 0, offsetof( specData_t, interiorChecks ), sizeof( VkBool32 ) },
+            { 1, offsetof( specData_t, workgroupSizeX ), sizeof( uint32_t ) },
+            { 2, offsetof( specData_t, workgroupSizeY ), sizeof( uint32_t ) },
+        };
+
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = 3;
+        specializationInfo.pMapEntries = specializationMapEntries;
+        specializationInfo.dataSize = sizeof( specData );
+        specializationInfo.pData = &specData;
+        shaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
+
         // [husky]: Define the push constant range used by the pipeline layout
         // Note that the spec only requires a minimum of 128 bytes, so for passing larger blocks of data you'd use UBOs or SSBOs
+        // All passes share the pipeline layout, so the range has to cover the largest of the push constant blocks.
         VkPushConstantRange pushConstantRange{};
         pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         pushConstantRange.offset = 0;
-        pushConstantRange.size = 4 * sizeof( float );
+        pushConstantRange.size = static_cast<uint32_t>( std::max( std::max( std::max( sizeof( iterPushConst_t ), sizeof( colorPushConst_t ) ),
+                                                                            std::max( sizeof( tilePushConst_t ), sizeof( aaPushConst_t ) ) ),
+                                                                  sizeof( batchPushConst_t ) ) );
 
         // The pipeline layout allows the pipeline to access descriptor sets.
         // So we just specify the descriptor set layout we created earlier.
@@ -119,7 +490,7 @@ struct MandelbrotApp : public VulkanComputeApp {
         pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
         // [husky]
         pipelineLayoutCreateInfo.pushConstantRangeCount  = 1;
-        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;        
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
         VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &pipelineLayout));
 
@@ -132,64 +503,307 @@ struct MandelbrotApp : public VulkanComputeApp {
             device, VK_NULL_HANDLE,
             1, &pipelineCreateInfo,
             NULL, &pipeline));
+
+        // the coloring pipeline only differs in the shader module (constants that it does not declare are ignored)
+        pipelineCreateInfo.stage.module = colorShaderModule;
+        VK_CHECK_RESULT(vkCreateComputePipelines(
+            device, VK_NULL_HANDLE,
+            1, &pipelineCreateInfo,
+            NULL, &colorPipeline));
+
+        // the subdivision pipeline has a fixed workgroup size of 64, constants 1 and 2 are ignored as well
+        if ( subdivision ) {
+            pipelineCreateInfo.stage.module = tilesShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &tilesPipeline));
+        }
+
+        if ( antialiasing ) {
+            pipelineCreateInfo.stage.module = edgesShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &edgesPipeline));
+            pipelineCreateInfo.stage.module = supersampleShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &supersamplePipeline));
+        }
+
+        if ( batch ) {
+            pipelineCreateInfo.stage.module = batchShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &batchPipeline));
+        }
     }
 
     virtual void createCommandBuffer() override {
-    
-        float kColor[4]{ 0.1f, 0.7f, 0.6f, 0.0f };
-        //float kColor[4]{ 0.9f, 0.1f, 0.3f, 0.0f };
-        vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( float ) * 4, kColor );
-
-        // Calling vkCmdDispatch basically starts the compute pipeline, and executes the compute shader.
-        // The number of workgroups is specified in the arguments.
-        // If you are already familiar with compute shaders from OpenGL, this should be nothing new to you.
-        vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(resy / float(workgroupSize)), 1);
+
+        if ( batch ) {
+            recordBatch(); // instead of all other passes
+            return;
+        }
+
+        if ( antialiasing ) {
+            // no edge pixels and no workgroups, the edge detection pass appends them
+            const uint32_t edgeDispatch[4] = { 0, 1, 1, 0 };
+            vkCmdUpdateBuffer( commandBuffer, edgeBuffer, 0, sizeof( edgeDispatch ), edgeDispatch );
+            VkMemoryBarrier memoryBarrier = {};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+        }
+
+        if ( subdivision ) {
+            recordSubdivision(); // replaces the iteration pass
+        } else {
+            vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( iterPushConst_t ), &iterPushConst );
+
+            // Calling vkCmdDispatch basically starts the compute pipeline, and executes the compute shader.
+            // The number of workgroups is specified in the arguments.
+            // If you are already familiar with compute shaders from OpenGL, this should be nothing new to you.
+            vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(resy / float(workgroupSize)), 1);
+        }
+
+        // the coloring pass reads what the iteration pass wrote
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+
+        recordColorPass();
+
+        if ( antialiasing ) {
+            // the edge detection only reads the samples, like the coloring pass, so both can run at the same time
+            updateAaPushConst();
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, edgesPipeline);
+            vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( aaPushConst_t ), &aaPushConst );
+            vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(resy / float(workgroupSize)), 1);
+            recordSupersamplePass();
+        }
     }
-    
-    void getRenderedImage( std::vector<uint8_t> &image, const uint32_t bufferSize, const uint32_t resx, const uint32_t resy, float floatScaleFactor ) {
+
+    // Re-colors the last computed frame with a different palette - the iteration pass is not run again.
+    void recolor( const float kColor[4], const float deGain = 0.5f, const float deStrength = 0.5f ) {
+        memcpy( colorPushConst.kColor, kColor, sizeof( colorPushConst.kColor ) );
+        colorPushConst.deParams[0] = deGain;
+        colorPushConst.deParams[1] = deStrength;
+
+        // the command buffer from run() has already been executed, so we can simply re-record it
+        VK_CHECK_RESULT(vkResetCommandPool(device, commandPool, 0));
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        cmdWriteStartTimestamp();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+        recordColorPass();
+        if ( antialiasing ) {
+            // the edge pixels of the last run are still in the list, only their colors change
+            updateAaPushConst();
+            recordSupersamplePass();
+        }
+        cmdWriteEndTimestamp();
+        VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+        runCommandBuffer();
+    }
+
+    // The colors are already packed as RGBA8 by the coloring pass.
+    virtual void getRenderedImageRGBA8( std::vector<uint8_t>& image ) override {
         void* mappedMemory = NULL;
-        // Map the buffer memory, so that we can read from it on the CPU.
-        
         vkMapMemory(device, bufferMemory, 0, bufferSize, 0, &mappedMemory);
-        Pixel* pmappedMemory = (Pixel*)mappedMemory;
-
-        // Get the color data from the buffer, and cast it to bytes.
-        // We save the data to a vector.
-        
-        image.reserve(resx * resy * 4);
-        
-        for (int i = 0; i < resx*resy; i += 1) {
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].r ) ) );
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].g ) ) );
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].b ) ) );
-            image.push_back( 255u );
-        }        
-        
-        // Done reading, so unmap.
+        image.resize( bufferSize );
+        memcpy( image.data(), mappedMemory, bufferSize );
         vkUnmapMemory(device, bufferMemory);
     }
-    
+
     virtual void saveRenderedImage( const char* png_filename = "mandelbrot.png" ) override {
-        std::vector<uint8_t> image;
-        constexpr float scaleFactor = 255.0f;
-        const uint32_t bufferSize = sizeof(Pixel) * resx * resy;
-        getRenderedImage( image, bufferSize, resx, resy, scaleFactor );
-        
+        void* mappedMemory = NULL;
+        // Map the buffer memory, so that we can read from it on the CPU.
+        vkMapMemory(device, bufferMemory, 0, bufferSize, 0, &mappedMemory);
+
         printf( "writing %s\n", png_filename );
-        
-        // Now we save the acquired color data to a .png.
-        unsigned error = lodepng::encode(png_filename, image, resx, resy);
+
+        // The colors are already packed as RGBA8 by the coloring pass, so they can be encoded straight from the mapped memory.
+        unsigned error = lodepng::encode(png_filename, reinterpret_cast<const unsigned char*>( mappedMemory ), resx, resy);
 
         if (error) printf("encoder error %d: %s", error, lodepng_error_text(error));
+
+        // Done reading, so unmap.
+        vkUnmapMemory(device, bufferMemory);
     }
 
-private:    
-    // The pixels of the rendered mandelbrot set are in this format:
-    struct Pixel {
-        float r, g, b, a;
-    };
-    uint32_t bufferSize; // size of `buffer` in bytes.
-    uint32_t resx, resy;    
+private:
+
+    // levels of the subdivision: the tiles of level 0 have rootTileSize pixels, each level halves them (rounding up)
+    // until they are at most minTileSize
+    uint32_t numSubdivisionLevels() const {
+        uint32_t numLevels = 1;
+        for ( uint32_t size = tilePushConst.rootTileSize; size > tilePushConst.minTileSize; size -= size / 2 ) { numLevels++; }
+        return numLevels;
+    }
+
+    // the levels (16 x VkDispatchIndirectCommand + tile count, see tileBuf in mandelbrotTiles.comp), followed by two
+    // tile lists of 8 bytes per tile, which the levels alternate between - a list holds all tiles of the last level
+    uint32_t tileBufferSize() {
+        if ( !subdivision ) { return maxSubdivisionLevels * 16; }
+        const uint32_t rootTileSize = tilePushConst.rootTileSize;
+        tilePushConst.numRootTilesX = ( resx + rootTileSize - 1 ) / rootTileSize;
+        tilePushConst.numRootTiles = tilePushConst.numRootTilesX * ( ( resy + rootTileSize - 1 ) / rootTileSize );
+        tilePushConst.listCapacity = tilePushConst.numRootTiles << ( 2 * ( numSubdivisionLevels() - 1 ) );
+        return maxSubdivisionLevels * 16 + 2 * tilePushConst.listCapacity * 8;
+    }
+
+    void recordSubdivision() {
+        const uint32_t numLevels = numSubdivisionLevels();
+        if ( numLevels > maxSubdivisionLevels ) { throw std::runtime_error( "too many subdivision levels" ); }
+        tilePushConst.iter = iterPushConst;
+        tileBufferSize(); // the tile counts of the current resolution, the buffer is large enough after resize()
+        tilePushConst.maxGroups = std::min( getPhysicalDeviceLimits().maxComputeWorkGroupCount[0], 65535u );
+
+        // no tiles and no workgroups for the levels after 0, the dispatches grow as the tiles are appended
+        uint32_t levels[maxSubdivisionLevels][4];
+        for ( uint32_t i = 0; i < maxSubdivisionLevels; i++ ) { levels[i][0] = 0; levels[i][1] = 1; levels[i][2] = 1; levels[i][3] = 0; }
+        vkCmdUpdateBuffer( commandBuffer, tileBuffer, 0, sizeof( levels ), levels );
+
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                              0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tilesPipeline);
+        for ( uint32_t level = 0; level < numLevels; level++ ) {
+            tilePushConst.level = level;
+            vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( tilePushConst_t ), &tilePushConst );
+            if ( level == 0 ) {
+                vkCmdDispatch( commandBuffer, std::min( tilePushConst.numRootTiles, tilePushConst.maxGroups ), 1, 1 );
+            } else {
+                vkCmdDispatchIndirect( commandBuffer, tileBuffer, level * 16 );
+            }
+
+            // the next level reads the tiles and the dispatch that this one appended, and the samples on their border
+            if ( level + 1 < numLevels ) {
+                memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+                vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                      0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+            }
+        }
+    }
+
+    // sizeof( fractalParams_t ) per image of the batch
+    uint32_t paramBufferSize() const {
+        return static_cast<uint32_t>( sizeof( fractalParams_t ) * std::max( batchParams.size(), size_t( 1 ) ) );
+    }
+
+    void recordBatch() {
+        // the GPU is idle between runs (see runCommandBuffer()), so the parameters can be written directly
+        void* mappedMemory = NULL;
+        vkMapMemory(device, paramBufferMemory, 0, paramBufferSize(), 0, &mappedMemory);
+        memcpy( mappedMemory, batchParams.data(), sizeof( fractalParams_t ) * batchParams.size() );
+        vkUnmapMemory(device, paramBufferMemory);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, batchPipeline);
+        // one dispatch for all cells of the atlas - more, if there are more than maxComputeWorkGroupCount[2] cells
+        const uint32_t numCells = batchPushConst.atlasColumns * ( ( batchPushConst.numImages + batchPushConst.atlasColumns - 1 ) / batchPushConst.atlasColumns );
+        const uint32_t maxCellsPerDispatch = getPhysicalDeviceLimits().maxComputeWorkGroupCount[2];
+        for ( uint32_t first = 0; first < numCells; first += maxCellsPerDispatch ) {
+            batchPushConst.firstImage = first;
+            vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( batchPushConst_t ), &batchPushConst );
+            vkCmdDispatch(commandBuffer, (uint32_t)ceil(batchPushConst.imgdim[0] / float(workgroupSize)), (uint32_t)ceil(batchPushConst.imgdim[1] / float(workgroupSize)),
+                          std::min( numCells - first, maxCellsPerDispatch ));
+        }
+    }
+
+    void updateAaPushConst() {
+        memcpy( aaPushConst.kColor, colorPushConst.kColor, sizeof( aaPushConst.kColor ) );
+        memcpy( aaPushConst.imgdim, iterPushConst.imgdim, sizeof( aaPushConst.imgdim ) );
+        memcpy( aaPushConst.deParams, colorPushConst.deParams, sizeof( aaPushConst.deParams ) );
+        memcpy( aaPushConst.center, iterPushConst.center, sizeof( aaPushConst.center ) );
+        aaPushConst.scale = iterPushConst.scale;
+        aaPushConst.maxIter = iterPushConst.maxIter;
+        aaPushConst.maxGroups = std::min( getPhysicalDeviceLimits().maxComputeWorkGroupCount[0], 65535u );
+    }
+
+    // one index per pixel after the indirect dispatch (see edgeBuf in mandelbrotAntialias.h.glsl)
+    uint32_t edgeBufferSize() const {
+        return 16 + ( antialiasing ? sizeof( uint32_t ) * resx * resy : 0 );
+    }
+
+    // the supersampling pass overwrites the colors of the coloring pass, over the edge pixels and the dispatch that
+    // the edge detection pass wrote
+    void recordSupersamplePass() {
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                              0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, supersamplePipeline);
+        vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( aaPushConst_t ), &aaPushConst );
+        vkCmdDispatchIndirect( commandBuffer, edgeBuffer, 0 );
+    }
+
+    void recordColorPass() {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, colorPipeline);
+        vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( colorPushConst_t ), &colorPushConst );
+        vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(resy / float(workgroupSize)), 1);
+    }
+
+    // The iteration pass writes one packed uint per pixel into this buffer (see shaders/mandelbrot.comp),
+    // while `buffer` holds the RGBA8 output of the coloring pass.
+    VkBuffer sampleBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory sampleBufferMemory = VK_NULL_HANDLE;
+    uint32_t sampleBufferSize; // size of `sampleBuffer` in bytes.
+
+    VkPipeline colorPipeline = VK_NULL_HANDLE;
+    VkShaderModule colorShaderModule = VK_NULL_HANDLE;
+
+    bool interiorChecks = true;
+
+    // the tile lists of the subdivision, see setSubdivision()
+    static const uint32_t maxSubdivisionLevels = 16; // MAX_LEVELS in mandelbrotTiles.comp
+    VkBuffer tileBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory tileBufferMemory = VK_NULL_HANDLE;
+    uint32_t tileBufferCapacity = 0; // allocated size of `tileBuffer` in bytes.
+    VkPipeline tilesPipeline = VK_NULL_HANDLE;
+    VkShaderModule tilesShaderModule = VK_NULL_HANDLE;
+    bool subdivision = false;
+
+    // the edge pixels of the anti-aliasing, see setAntialiasing()
+    VkBuffer edgeBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory edgeBufferMemory = VK_NULL_HANDLE;
+    uint32_t edgeBufferCapacity = 0; // allocated size of `edgeBuffer` in bytes.
+    VkPipeline edgesPipeline = VK_NULL_HANDLE;
+    VkShaderModule edgesShaderModule = VK_NULL_HANDLE;
+    VkPipeline supersamplePipeline = VK_NULL_HANDLE;
+    VkShaderModule supersampleShaderModule = VK_NULL_HANDLE;
+    bool antialiasing = false;
+
+    // the batch, see setBatch()
+    std::vector<fractalParams_t> batchParams;
+    VkBuffer paramBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory paramBufferMemory = VK_NULL_HANDLE;
+    uint32_t paramBufferCapacity = 0; // allocated size of `paramBuffer` in bytes.
+    VkPipeline batchPipeline = VK_NULL_HANDLE;
+    VkShaderModule batchShaderModule = VK_NULL_HANDLE;
+    bool batch = false;
+
+    uint32_t bufferSize; // size of `buffer` in bytes that the current resolution uses.
+    uint32_t bufferCapacity = 0; // allocated size of `buffer` and `sampleBuffer` in bytes.
+    uint32_t resx, resy;
     uint32_t workgroupSize;
 };
 
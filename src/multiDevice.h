@@ -0,0 +1,236 @@
+#ifndef _MULTIDEVICE_H_
+#define _MULTIDEVICE_H_
+
+// Renders path-traced frames with several Vulkan devices at once. Every physical device (dGPU, iGPU, or a
+// software implementation such as lavapipe) gets its own PathtracerApp - with its own instance and logical
+// device - and is driven by its own host thread.
+//
+// A frame is split either into sample ranges (every device renders the whole image with a part of the samples,
+// and the partial accumulations are added up on the host) or into row bands (split frame: the finalized rows are
+// copied together). The work is handed out in chunks from a shared counter, so a device that is done early simply
+// takes the next chunk. The chunk sizes follow the throughput measured in the previous frame (guided
+// self-scheduling): a device takes half of its share of the remaining work, but at least one minimal chunk. A
+// balanced setup thus needs few chunks, and the tail of an unbalanced one is short.
+//
+// pathTracer.comp indexes the samples across the whole image, so the merged image matches a single-device
+// render up to the order of the floating-point additions.
+
+#include "pathtracerApp.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MultiDeviceRenderer {
+
+    enum SplitMode {
+        eSplitSamples,  // sample ranges of the whole image
+        eSplitFrame,    // row bands with all samples
+    };
+
+    static const char* splitModeName( const SplitMode mode ) { return mode == eSplitSamples ? "samples" : "frame"; }
+
+    // deviceIndices: indices into VulkanComputeApp::listPhysicalDevices(), empty for all devices
+    MultiDeviceRenderer( const uint32_t resx, const uint32_t resy, const int32_t spp, const SplitMode splitMode,
+                         const std::vector<int32_t>& deviceIndices = std::vector<int32_t>() )
+        : resx( resx ), resy( resy ), spp( spp ), splitMode( splitMode ) {
+
+        const std::vector<std::string> names = VulkanComputeApp::listPhysicalDevices();
+        std::vector<int32_t> indices = deviceIndices;
+        if ( indices.empty() ) {
+            for ( int32_t i = 0; i < static_cast<int32_t>( names.size() ); i++ ) { indices.push_back( i ); }
+        }
+        if ( indices.empty() ) { throw std::runtime_error( "could not find a device with vulkan support" ); }
+
+        for ( const int32_t index : indices ) {
+            if ( index < 0 || index >= static_cast<int32_t>( names.size() ) ) {
+                throw std::runtime_error( "there is no Vulkan device " + std::to_string( index ) );
+            }
+            devices.push_back( Device() );
+            Device& device = devices.back();
+            device.index = index;
+            device.name = names[ index ];
+            device.app.reset( new PathtracerApp( resx, resy, spp ) );
+            device.app->setPhysicalDeviceIndex( index );
+            // the partial accumulations are merged on the host, an 8 bit image of them is of no use
+            device.app->setReadbackFormat( PathtracerApp::eReadbackFloat );
+            device.app->init();
+            device.app->preRun();
+            device.app->prepare();
+        }
+    }
+
+    void setScene( const Scene& scene ) {
+        for ( Device& device : devices ) { device.app->setScene( scene ); }
+    }
+
+    // Renders a frame on all devices, returns the wall-clock time in ms.
+    double render() {
+        const auto startTime = std::chrono::high_resolution_clock::now();
+
+        totalUnits = ( splitMode == eSplitSamples ) ? static_cast<uint32_t>( spp ) : resy;
+        nextUnit = 0;
+        for ( Device& device : devices ) {
+            device.units = 0;
+            device.numChunks = 0;
+            device.busyMs = 0.0;
+            device.rowChunks.clear();
+            device.error.clear();
+        }
+
+        std::vector<std::thread> threads;
+        for ( size_t i = 0; i < devices.size(); i++ ) {
+            threads.push_back( std::thread( &MultiDeviceRenderer::renderChunks, this, i ) );
+        }
+        for ( std::thread& thread : threads ) { thread.join(); }
+
+        for ( Device& device : devices ) {
+            if ( !device.error.empty() ) { throw std::runtime_error( device.name + ": " + device.error ); }
+            // devices that did not get any work keep their previous estimate
+            if ( device.units > 0 && device.busyMs > 0.0 ) { device.unitsPerMs = device.units / device.busyMs; }
+        }
+
+        lastFrameMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - startTime ).count();
+        return lastFrameMs;
+    }
+
+    // merges the parts of the last frame, see render()
+    void getRenderedImageRGBA8( std::vector<uint8_t>& image ) {
+        std::vector<float> merged( resx * resy * 4, 0.0f );
+        std::vector<float> accumulation;
+        for ( Device& device : devices ) {
+            if ( device.units == 0 ) { continue; }
+            device.app->getAccumulation( accumulation );
+            if ( splitMode == eSplitSamples ) {
+                for ( size_t i = 0; i < merged.size(); i++ ) { merged[i] += accumulation[i]; }
+            } else {
+                // pathTracer.comp stores the image bottom-up, see PathtracerApp::flipImageRGBA8()
+                for ( const auto& rows : device.rowChunks ) {
+                    for ( uint32_t y = rows.first; y < rows.second; y++ ) {
+                        const size_t offset = static_cast<size_t>( resy - 1 - y ) * resx * 4;
+                        std::copy( accumulation.begin() + offset, accumulation.begin() + offset + resx * 4, merged.begin() + offset );
+                    }
+                }
+            }
+        }
+        if ( splitMode == eSplitSamples ) { PathtracerApp::finalizeAccumulation( merged ); }
+        PathtracerApp::accumulationToRGBA8( merged, resx, resy, image );
+    }
+
+    void saveRenderedImage( const char* pngFilename ) {
+        std::vector<uint8_t> image;
+        getRenderedImageRGBA8( image );
+        printf( "writing %s\n", pngFilename );
+        const unsigned error = lodepng::encode( pngFilename, image, resx, resy );
+        if ( error ) { printf( "encoder error %d: %s", error, lodepng_error_text( error ) ); }
+    }
+
+    // what every device contributed to the last frame
+    void printStats() const {
+        const char* unitName = ( splitMode == eSplitSamples ) ? "samples" : "rows";
+        printf( "%-4s %-40s %8s %7s %7s %10s %14s\n", "dev", "name", unitName, "share", "chunks", "busy [ms]", "units/s" );
+        double sumUnitsPerSecond = 0.0;
+        for ( const Device& device : devices ) {
+            const double unitsPerSecond = device.busyMs > 0.0 ? 1000.0 * device.units / device.busyMs : 0.0;
+            sumUnitsPerSecond += unitsPerSecond;
+            printf( "%-4d %-40s %8u %6.1f%% %7u %10.1f %14.1f\n", device.index, device.name.c_str(), device.units,
+                100.0 * device.units / totalUnits, device.numChunks, device.busyMs, unitsPerSecond );
+        }
+        printf( "frame: %.1f ms, %.1f %s/s (sum of the devices: %.1f)\n",
+            lastFrameMs, 1000.0 * totalUnits / lastFrameMs, unitName, sumUnitsPerSecond );
+    }
+
+    size_t getNumDevices() const { return devices.size(); }
+
+private:
+    struct Device {
+        int32_t     index;
+        std::string name;
+        std::unique_ptr<PathtracerApp> app;
+        double      unitsPerMs = 0.0; // measured throughput, 0 until the device rendered a frame
+
+        // of the current frame
+        uint32_t    units = 0;
+        uint32_t    numChunks = 0;
+        double      busyMs = 0.0;
+        std::vector<std::pair<uint32_t, uint32_t>> rowChunks; // [first, end) rows, eSplitFrame only
+        std::string error;
+    };
+
+    // runs on the thread of the device until all work of the frame is taken
+    void renderChunks( const size_t deviceNum ) {
+        Device& device = devices[ deviceNum ];
+        try {
+            uint32_t begin, end;
+            while ( takeChunk( deviceNum, begin, end ) ) {
+                if ( splitMode == eSplitSamples ) {
+                    // the accumulation is only cleared by the first chunk, and finalized on the host after merging
+                    device.app->setSampleRange( static_cast<int32_t>( begin ), static_cast<int32_t>( end ), device.numChunks == 0, false );
+                    device.app->setRowRange( 0, resy );
+                } else {
+                    device.app->setSampleRange( 0, spp, true, true );
+                    device.app->setRowRange( begin, end - begin );
+                    device.rowChunks.push_back( std::make_pair( begin, end ) );
+                }
+
+                const auto chunkStart = std::chrono::high_resolution_clock::now();
+                device.app->rerun();
+                device.busyMs += std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - chunkStart ).count();
+                device.units += end - begin;
+                device.numChunks++;
+            }
+        }
+        catch ( const std::exception& e ) {
+            device.error = e.what();
+        }
+    }
+
+    // hands out the next chunk [begin, end) of the frame to a device, false if all work is taken
+    bool takeChunk( const size_t deviceNum, uint32_t& begin, uint32_t& end ) {
+        std::lock_guard<std::mutex> lock( mutex );
+        const uint32_t remaining = totalUnits - nextUnit;
+        if ( remaining == 0 ) { return false; }
+
+        // equal shares until every device was measured
+        double share = 1.0 / devices.size();
+        double sumUnitsPerMs = 0.0;
+        bool allMeasured = true;
+        for ( const Device& device : devices ) {
+            sumUnitsPerMs += device.unitsPerMs;
+            allMeasured = allMeasured && device.unitsPerMs > 0.0;
+        }
+        if ( allMeasured ) { share = devices[ deviceNum ].unitsPerMs / sumUnitsPerMs; }
+
+        // whole workgroups for row bands
+        const uint32_t minChunk = ( splitMode == eSplitSamples ) ? 1u : 16u;
+        uint32_t chunk = static_cast<uint32_t>( ceil( remaining * share * 0.5 ) );
+        chunk = ( std::max( chunk, minChunk ) + minChunk - 1 ) / minChunk * minChunk;
+        chunk = std::min( chunk, remaining );
+
+        begin = nextUnit;
+        end = begin + chunk;
+        nextUnit = end;
+        return true;
+    }
+
+    uint32_t  resx, resy;
+    int32_t   spp;
+    SplitMode splitMode;
+
+    std::vector<Device> devices;
+
+    std::mutex mutex;       // guards nextUnit
+    uint32_t   totalUnits = 0;
+    uint32_t   nextUnit = 0;
+
+    double lastFrameMs = 0.0;
+};
+
+#endif // _MULTIDEVICE_H_
@@ -3,74 +3,477 @@
 
 #include "vulkanComputeApp.h"
 
+#include "scene.h"
+#include "imageStats.h"
+#include "denoiser.h"
+#include "pixelLayout.h"
+#include "accumulationFormat.h"
+#include "perfCounters.h"
+
 #include "external/lodepng/lodepng.h" //Used for png encoding.
 
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+
 
 //#define PATHTRACER_MODE
 
 #define TEST_PRECISION_WITH_LARGE_SPHERE_WALLS  0
 
-namespace {
-    static float planes[] = { // normal.xyz, distToOrigin  |  emmission.xyz, 0  |  color.rgb, refltype     
-        #if ( TEST_PRECISION_WITH_LARGE_SPHERE_WALLS == 0 )
-            -1.0f,  +0.0f,  +0.0f,  +2.6f,      0, 0, 0, 0,     .85, .25, .25,  1, // Left
-            +1.0f,  +0.0f,  +0.0f,  +2.6f,      0, 0, 0, 0,     .25, .35, .85,  1, // Right
-            +0.0f,  +1.0f,  +0.0f,  +2.0f,      0, 0, 0, 0,     .75, .75, .75,  1, // Top
-            +0.0f,  -1.0f,  +0.0f,  +2.0f,      0, 0, 0, 0,     .75, .75, .75,  1, // Bottom
-            +0.0f,  +0.0f,  -1.0f,  +2.8f,      0, 0, 0, 0,     .85, .85, .25,  1, // Back
-            +0.0f,  +0.0f,  +1.0f,  +7.9f,      0, 0, 0, 0,     0.1, 0.7, 0.7,  1, // Front
-        #else // must have at least one plane here
-            1,0,0,1000,    0,0,0,0,     1,1,1,1, // can't allocate buffers of size 0 => insert one zero dummy plane
-        #endif
+struct PathtracerApp : public VulkanComputeApp {
+
+    // Shader variants for the emulated-precision code paths in intersect(), keep in sync with shaders/precisionModes.h.glsl.
+    // Each mode is compiled into shaders/pathTracer.<name>.generated.spv
+    enum PrecisionMode : int32_t {
+        ePrecisionFp32 = 0,
+        ePrecisionFp64,     // needs shaderFloat64
+        ePrecisionDs,
+        ePrecisionDf64,
+        ePrecisionR128,     // needs shaderInt64
+        ePrecisionAuto,     // best mode the device supports, resolved in createComputePipeline()
+        eNumPrecisionModes = ePrecisionAuto
     };
 
-    static float spheres[] = {  // center.xyz, radius  |  emmission.xyz, 0  |  color.rgb, refltype     
-        #if ( TEST_PRECISION_WITH_LARGE_SPHERE_WALLS != 0 )
-            1e5 - 2.6, 0, 0, 1e5,   0, 0, 0, 0,  .85, .25, .25,  1, // Left (DIFFUSE)
-            1e5 + 2.6, 0, 0, 1e5,   0, 0, 0, 0,  .25, .35, .85,  1, // Right
-            0, 1e5 + 2, 0, 1e5,     0, 0, 0, 0,  .75, .75, .75,  1, // Top
-            0,-1e5 - 2, 0, 1e5,     0, 0, 0, 0,  .75, .75, .75,  1, // Bottom
-            0, 0, -1e5 - 2.8, 1e5,  0, 0, 0, 0,  .85, .85, .25,  1, // Back 
-            0, 0, 1e5 + 7.9, 1e5,   0, 0, 0, 0,  0.1, 0.7, 0.7,  1, // Front
-        #endif
-        -1.3, -1.2, -1.3, 0.8,  0, 0, 0, 0,  .999,.999,.999, 2, // REFLECTIVE
-        1.3, -1.2, -0.2, 0.8,   0, 0, 0, 0,  .999,.999,.999, 3, // REFRACTIVE
-        0, 2*0.8, 0, 0.2,       100,100,100,0,  0, 0, 0,   1, // Light
-    };    
-} // namespace
+    static const char* precisionModeName( const PrecisionMode mode ) {
+        static const char* names[] = { "fp32", "fp64", "ds", "df64", "r128", "auto" };
+        return names[ mode ];
+    }
 
-struct PathtracerApp : public VulkanComputeApp {
+    static PrecisionMode precisionModeFromName( const char* name ) {
+        for ( int32_t mode = 0; mode <= ePrecisionAuto; mode++ ) {
+            if ( strcmp( name, precisionModeName( static_cast<PrecisionMode>( mode ) ) ) == 0 ) { return static_cast<PrecisionMode>( mode ); }
+        }
+        throw std::runtime_error( std::string( "unknown precision mode " ) + name );
+    }
 
     struct pushConst_t {
         uint32_t imgdim[2]; //{ WIDTH, HEIGHT };
         uint32_t samps[2]; //{ 0, spp };
+        float    camOrigin[4]; // camera position in the (possibly rebased) coordinates of the uploaded scene
+        uint32_t work[4]; //{ first sample, end sample, first row, eWorkClear | eWorkFinalize }
+        uint32_t outputBase; // first pixel of the frame in the output buffer, see setAsyncTransfers()
+        uint32_t countersBase; // first uint of the frame in the counters buffer, see setPerfCounters()
     } pushConst;
 
+    // push constants of imageStats.comp
+    struct statsPushConst_t {
+        uint32_t imgdim[2];
+        uint32_t inputBase;     // first pixel of the frame in the output buffer
+        uint32_t statsBase;     // first uint of the frame in the statistics buffer
+        float    logLumRange[2];
+        uint32_t finalized;
+    };
+
+    // push constants of packImage.comp
+    struct packPushConst_t {
+        uint32_t imgdim[2];
+        uint32_t inputBase;     // first pixel of the frame in the output buffer
+        uint32_t outputBase;    // first uint of the frame in the packed buffer
+        uint32_t bytesPerPixel;
+        uint32_t finalized;
+        float    scale;         // of a partial accumulation, see recordPackPass()
+    };
+
+    // push constants of denoise.comp
+    struct denoisePushConst_t {
+        uint32_t imgdim[2];
+        uint32_t base;          // first pixel of the frame in the output buffer
+        uint32_t iteration;
+        uint32_t numIterations;
+        uint32_t finalize;
+        float    sigmaColor, sigmaNormal, sigmaDepth, sigmaAlbedo;
+    };
+
+    // where the accumulation is denoised, see setDenoiser()
+    enum DenoiseMode : int32_t {
+        eDenoiseOff = 0,
+        eDenoiseGpu,            // denoise.comp, in the command buffer of the frame
+        eDenoiseCpu,            // Denoiser::denoise() on the host, when the image is read
+    };
+
+    // what is read back of a frame, see setReadbackFormat()
+    enum ReadbackFormat : int32_t {
+        eReadbackFloat = 0,     // the accumulation buffer, 16 bytes per pixel - converted and flipped on the host
+        eReadbackRGBA8,         // packed by packImage.comp, upright
+        eReadbackRGB8,
+    };
+
+    // which reduction imageStats.comp uses, see setStatistics()
+    enum StatisticsVariant : int32_t {
+        eStatsAuto = 0,         // subgroups if the device supports subgroup arithmetic
+        eStatsSubgroups,
+        eStatsSharedMemory,
+    };
+
+    // how the scene is stored in the GPU buffers, see setSceneLayout()
+    enum SceneLayout : int32_t {
+        eSceneLayoutSoa = 0,    // geometry, local frames and materials in separate arrays, see Scene::toGpuPlaneGeometry()
+        eSceneLayoutAos,        // whole records per object (SCENE_LAYOUT_AOS in pathTracer.comp), the reference of the benchmark
+    };
+
+    // flags of pushConst_t::work, keep in sync with WORK_CLEAR / WORK_FINALIZE in pathTracer.comp
+    enum WorkFlags : uint32_t {
+        eWorkClear = 1,     // clear the accumulation at the first sample of the range
+        eWorkFinalize = 2,  // gamma-encode the accumulation to 8 bit after the last sample of the range
+    };
+
     PathtracerApp( const uint32_t resx, const uint32_t resy, const int32_t spp, const uint32_t workgroupSize = 16 ) {
         this->resx = resx;
         this->resy = resy;
         this->spp = spp;
         this->workgroupSize = workgroupSize;
         // Buffer size of the storage buffer that will contain the rendered mandelbrot set.
-        bufferSize = sizeof(Pixel) * resx * resy;
+        bufferSize = AccumulationFormat::bytesPerPixel( accumulationFormat ) * resx * resy;
         printf("in PathtracerApp ctor\n");
 
         pushConst.imgdim[0] = resx;
         pushConst.imgdim[1] = resy;
         pushConst.samps[0] = 0;
         pushConst.samps[1] = spp;
+        memset( pushConst.camOrigin, 0, sizeof( pushConst.camOrigin ) );
+        pushConst.outputBase = 0;
+        pushConst.countersBase = 0;
+        setWholeImage();
+
+    #if ( TEST_PRECISION_WITH_LARGE_SPHERE_WALLS == 0 )
+        setScene( Scene::makeCornellBox() );
+    #else
+        setScene( Scene::makeLargeSphereWalls() );
+    #endif
+    }
+
+    // The following setters must be called before preRun() / run().
+
+    // Can also be called after preRun(), the new scene is then uploaded right away and used by the next rerun().
+    void setScene( const Scene& scene ) {
+        this->scene = scene;
+        if ( sceneBuffers[ eScenePlanes ].buffer != VK_NULL_HANDLE ) { uploadScene(); }
+    }
+
+    // The structure-of-arrays layout keeps the intersection loops of pathTracer.comp on 16 bytes per object, the
+    // array-of-structures layout is only there for comparison (see benchmark::runSceneLayout()). Its shader
+    // variant is only precompiled for fp32 (shaders/pathTracer.fp32.aos.generated.spv).
+    void setSceneLayout( const SceneLayout layout ) { sceneLayout = layout; }
+
+    // bytes of the scene arrays on the GPU, of the last upload
+    uint32_t getSceneBytes() const {
+        uint32_t bytes = 0;
+        for ( const SceneBuffer& sceneBuffer : sceneBuffers ) { bytes += sceneBuffer.size; }
+        return bytes;
+    }
+
+    // Every workgroup copies the scene geometry (16 bytes per object) to shared memory before it traces, and the
+    // intersection loops read it from there (SCENE_CACHE in pathTracer.comp). The cache takes at most maxBytes, and
+    // never more than maxComputeSharedMemorySize of the device or the scene at the time the pipeline is created -
+    // objects beyond it are read from the storage buffers. Must be set before preRun().
+    void setSceneCache( const bool enabled, const uint32_t maxBytes = 16384 ) {
+        sceneCache = enabled;
+        sceneCacheMaxBytes = maxBytes;
+    }
+
+    // Stores the accumulation (and the AOVs) in 8x8 tiles with the pixels in Z-order instead of row by row (see
+    // shaders/pixelLayout.h.glsl), so that a workgroup reads and writes a few contiguous blocks of the buffers. All
+    // passes index through the same function: packImage.comp detiles and flips in one go, and getAccumulation() /
+    // getAovs() detile on the host, so everything outside of the shaders sees the row-major image. Must be set
+    // before preRun().
+    void setTiledPixels( const bool enabled ) { tiledPixels = enabled; }
+    bool isTiledPixels() const { return tiledPixels; }
+
+    // Stores the accumulation in a more compact format than the 4 floats per pixel of eRGBA32F (see
+    // shaders/accumulationFormat.h.glsl): 3 floats, 4 halfs, or 4 bytes with a shared exponent / as small floats
+    // for previews - less memory and less traffic per sample, at the price of precision (see
+    // benchmark::runAccumulationFormats()). The formats without fp32 cannot hold the 8 bit values of a finalized
+    // frame, so the accumulation stays linear: packImage.comp gamma-encodes it, and getAccumulation() does so on the
+    // host. The primary hits of setOutputPrimaryHits() need eRGBA32F. Must be set before preRun().
+    void setAccumulationFormat( const AccumulationFormat::Format format ) {
+        accumulationFormat = format;
+        bufferSize = AccumulationFormat::bytesPerPixel( accumulationFormat ) * resx * resy;
+    }
+    AccumulationFormat::Format getAccumulationFormat() const { return accumulationFormat; }
+
+    // Rebase the scene to the camera and give huge spheres a local frame before it is converted to float
+    // (see Scene::rebasedToCamera() and Scene::toGpuSphereFrames()). This keeps intersect() on the float path
+    // with an accuracy comparable to the emulated-precision modes. Disable to upload the world coordinates as is.
+    void setCameraRelative( const bool enabled ) { cameraRelative = enabled; }
+
+    void setPrecisionMode( const PrecisionMode mode ) { precisionMode = mode; }
+    PrecisionMode getPrecisionMode() const { return precisionMode; }
+
+    // Restricts the next rerun() to a part of the image, for splitting a frame across devices (see multiDevice.h).
+    // Samples [firstSample, endSample) of all spp samples are added to the accumulation, each weighted with 1 / spp.
+    // With clear, the accumulation is reset first, with finalize, it is gamma-encoded to 8 bit afterwards - a
+    // range that does not cover all samples must not be finalized, the partial accumulations are merged on the host.
+    void setSampleRange( const int32_t firstSample, const int32_t endSample, const bool clear, const bool finalize ) {
+        pushConst.work[0] = static_cast<uint32_t>( firstSample );
+        pushConst.work[1] = static_cast<uint32_t>( endSample );
+        pushConst.work[3] = ( clear ? eWorkClear : 0u ) | ( finalize ? eWorkFinalize : 0u );
+    }
+    // only rows [firstRow, firstRow + numRows) (top to bottom of the final image) are rendered - not with the GPU
+    // denoiser, its filter reads the neighbours across the row boundaries
+    void setRowRange( const uint32_t firstRow, const uint32_t numRows ) {
+        if ( denoiseMode == eDenoiseGpu && ( firstRow != 0 || numRows != static_cast<uint32_t>( resy ) ) ) {
+            throw std::runtime_error( "the GPU denoiser filters the whole image, it cannot be combined with a row range" );
+        }
+        pushConst.work[2] = firstRow;
+        this->numRows = numRows;
+    }
+    // undoes setSampleRange() / setRowRange()
+    void setWholeImage() {
+        setSampleRange( 0, spp, true, true );
+        setRowRange( 0, resy );
+    }
+
+    // Async mode: the accumulation lives in device-local memory, and the readback (as well as scene uploads) is
+    // done by copies on the transfer queue. The copy of frame N then overlaps the rendering of frame N+1:
+    //
+    //   compute:  [ frame 1 ][ frame 2 ][ frame 3 ]
+    //   transfer:            [copy 1]   [copy 2]   [copy 3]
+    //
+    // Two frames can be in flight, so the output and readback buffers have two slots. The queues are ordered by
+    // timeline semaphores - computeTimeline counts the rendered frames, transferTimeline the copied ones, and
+    // uploadTimeline the scene uploads. Frames are rendered with submitFrame() / fetchFrame() instead of rerun().
+    // Needs timeline semaphores, otherwise preRun() falls back to the synchronous mode. Must be set before preRun().
+    void setAsyncTransfers( const bool enabled ) { asyncTransfers = enabled; }
+    bool isAsyncTransfers() const { return asyncTransfers; }
+
+    // Records and submits the next frame and its readback, returns the frame number for fetchFrame(). Waits, if
+    // two frames are already in flight. A frame has to be fetched before two more frames are submitted, since
+    // they reuse its slot of the readback buffer.
+    uint64_t submitFrame() {
+        const uint64_t frame = ++submittedFrames;
+        const uint32_t slot = static_cast<uint32_t>( frame % 2 );
+        if ( frame > 2 ) {
+            if ( fetchedFrames + 2 < frame ) { throw std::runtime_error( "frame " + std::to_string( frame - 2 ) + " was not fetched" ); }
+            // the copy of frame - 2 has finished, so has its rendering - both slots and command buffers are free
+            waitTimelineSemaphore( transferTimeline, frame - 2 );
+        }
+
+        // render into the slot of the output buffer
+        pushConst.outputBase = slot * getPixelCapacity();
+        pushConst.countersBase = slot * countersSlotCapacity;
+        VK_CHECK_RESULT(vkResetCommandBuffer(frameCommandBuffers[ slot ], 0));
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(frameCommandBuffers[ slot ], &beginInfo));
+        vkCmdBindPipeline(frameCommandBuffers[ slot ], VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(frameCommandBuffers[ slot ], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+        recordDispatches( frameCommandBuffers[ slot ], slot );
+        VK_CHECK_RESULT(vkEndCommandBuffer(frameCommandBuffers[ slot ]));
+
+        submitTimes[ slot ] = std::chrono::high_resolution_clock::now();
+        // starts once the last scene upload is done
+        submitTimeline( queue, frameCommandBuffers[ slot ], { uploadTimeline }, { lastUpload }, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        computeTimeline, frame );
+
+        // copy the slot to the host-visible readback buffer, once the frame is rendered
+        VK_CHECK_RESULT(vkResetCommandBuffer(readbackCommandBuffers[ slot ], 0));
+        VK_CHECK_RESULT(vkBeginCommandBuffer(readbackCommandBuffers[ slot ], &beginInfo));
+        // with a packed readback format, only the packed image (see setReadbackFormat())
+        VkBufferCopy region = {};
+        region.srcOffset = static_cast<VkDeviceSize>( slot ) * getReadbackSlotCapacity();
+        region.dstOffset = region.srcOffset;
+        region.size = getReadbackSize();
+        vkCmdCopyBuffer(readbackCommandBuffers[ slot ], isPackedReadback() ? packedBuffer : buffer, readbackBuffer, 1, &region);
+        // make the copy visible to the host
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = readbackBuffer;
+        barrier.offset = region.dstOffset;
+        barrier.size = region.size;
+        vkCmdPipelineBarrier(readbackCommandBuffers[ slot ], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, NULL, 1, &barrier, 0, NULL);
+        VK_CHECK_RESULT(vkEndCommandBuffer(readbackCommandBuffers[ slot ]));
+        submitTimeline( transferQueue, readbackCommandBuffers[ slot ], { computeTimeline }, { frame }, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        transferTimeline, frame );
+        return frame;
+    }
+
+    // Waits until frame (from submitFrame()) is in the readback buffer. getRenderedImageRGBA8(), getAccumulation()
+    // and saveRenderedImage() then return it, and getLastSubmitMs() the time from its submission until now.
+    void fetchFrame( const uint64_t frame ) {
+        waitTimelineSemaphore( transferTimeline, frame );
+        fetchedSlot = static_cast<uint32_t>( frame % 2 );
+        fetchedFrames = std::max( fetchedFrames, frame );
+        lastSubmitMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - submitTimes[ fetchedSlot ] ).count();
+    }
+
+    // Computes luminance statistics of every frame on the GPU (shaders/imageStats.comp) - a pass after the
+    // samples, that only writes a small buffer for getStatistics(). The tiles are the workgroups of the path
+    // tracer. Must be set before preRun(). The statistics of a sample range that does not end the frame (see
+    // setSampleRange()) describe the partial accumulation.
+    void setStatistics( const bool enabled, const StatisticsVariant variant = eStatsAuto ) {
+        statistics = enabled;
+        statisticsVariant = variant;
+    }
+    // log2 of the luminance range covered by the histogram
+    void setHistogramRange( const float logLumMin, const float logLumMax ) {
+        logLumRange[0] = logLumMin;
+        logLumRange[1] = logLumMax;
+    }
+    // the reduction that is used, known after prepare()
+    StatisticsVariant getStatisticsVariant() const { return statisticsVariant; }
+
+    // statistics of the last frame (after rerun(), or fetchFrame() in async mode), see setStatistics()
+    ImageStatistics getStatistics() {
+        if ( !statistics ) { throw std::runtime_error( "statistics are not enabled, see setStatistics()" ); }
+        const uint32_t slot = asyncTransfers ? fetchedSlot : 0;
+        const uint32_t rawSize = ImageStatistics::rawSizeInUints( resx, resy, workgroupSize );
+        void* mappedMemory = NULL;
+        vkMapMemory(device, statsBufferMemory, static_cast<VkDeviceSize>( slot ) * statsSlotCapacity * sizeof( uint32_t ),
+                    rawSize * sizeof( uint32_t ), 0, &mappedMemory);
+        const ImageStatistics stats = ImageStatistics::fromRaw( static_cast<const uint32_t*>( mappedMemory ), resx, resy, workgroupSize,
+                                                                logLumRange[0], logLumRange[1] );
+        vkUnmapMemory(device, statsBufferMemory);
+        return stats;
+    }
+
+    // Counts paths, rays, hits, shadow rays, Russian roulette terminations, misses, intersection tests and
+    // emulated-precision fallbacks in pathTracer.comp (PERF_COUNTERS), per tile of workgroupSize pixels, for
+    // getPerfCounters(). If the device has subgroup arithmetic, the shader variant with USE_SUBGROUPS
+    // (shaders/pathTracer.<mode>.counters.generated.spv) sums the counts of a subgroup before it adds them with
+    // atomics, otherwise every invocation adds its own. The counters are reset at the start of every frame. Must
+    // be set before preRun().
+    void setPerfCounters( const bool enabled ) { perfCounters = enabled; }
+    bool isPerfCounters() const { return perfCounters; }
+
+    // counters of the last frame (after rerun(), or fetchFrame() in async mode), see setPerfCounters()
+    PerfCounters getPerfCounters() {
+        if ( !perfCounters ) { throw std::runtime_error( "the performance counters are not enabled, see setPerfCounters()" ); }
+        const uint32_t slot = asyncTransfers ? fetchedSlot : 0;
+        const uint32_t rawSize = PerfCounters::rawSizeInUints( resx, resy, workgroupSize );
+        void* mappedMemory = NULL;
+        vkMapMemory(device, countersBufferMemory, static_cast<VkDeviceSize>( slot ) * countersSlotCapacity * sizeof( uint32_t ),
+                    rawSize * sizeof( uint32_t ), 0, &mappedMemory);
+        const PerfCounters counters = PerfCounters::fromRaw( static_cast<const uint32_t*>( mappedMemory ), resx, resy, workgroupSize );
+        vkUnmapMemory(device, countersBufferMemory);
+        return counters;
+    }
+
+    // With a packed format, a last pass of every frame (shaders/packImage.comp) flips the image upright, gamma-encodes
+    // and quantizes it to 8 bit, and only this packed image is read: saveRenderedImage() hands the mapped memory to
+    // the PNG encoder as is, getRenderedImageRGBA8() copies it. eReadbackFloat converts the float accumulation on
+    // the host instead. The float accumulation stays available in the synchronous mode (getAccumulation()), in
+    // async mode only the packed image is copied to the host. Must be set before preRun().
+    void setReadbackFormat( const ReadbackFormat format ) { readbackFormat = format; }
+    ReadbackFormat getReadbackFormat() const { return readbackFormat; }
+    bool isPackedReadback() const { return readbackFormat != eReadbackFloat; }
+    // bytes that are read back per frame
+    uint32_t getReadbackSize() const { return isPackedReadback() ? getPackedImageSize() : bufferSize; }
+
+    // Denoises every frame with an edge-avoiding à-trous filter (see denoiser.h), guided by first-hit albedo and
+    // normal that pathTracer.comp accumulates alongside the radiance (see setOutputAovs()). eDenoiseGpu runs the
+    // filter iterations as dispatches after the last sample range (the one that finalizes, see setSampleRange()),
+    // so getAccumulation(), the statistics and the packed image are of the denoised frame - the ranges before stay
+    // unfiltered, the next range adds to them. Not with a row range, see setRowRange(). eDenoiseCpu filters on the
+    // host when the image is read (getRenderedImageRGBA8(), saveRenderedImage()) - it needs the float readback and
+    // the synchronous mode. Must be set before preRun().
+    void setDenoiser( const DenoiseMode mode, const Denoiser::Params& params = Denoiser::Params() ) {
+        if ( mode == eDenoiseGpu && ( pushConst.work[2] != 0 || numRows != static_cast<uint32_t>( resy ) ) ) {
+            throw std::runtime_error( "the GPU denoiser filters the whole image, it cannot be combined with a row range" );
+        }
+        denoiseMode = mode;
+        denoiseParams = params;
+        denoiseParams.numIterations = std::max( params.numIterations, 2u );
+        if ( mode != eDenoiseOff ) { outputAovs = true; }
+    }
+    DenoiseMode getDenoiseMode() const { return denoiseMode; }
+
+    // Accumulates the first-hit features (OUTPUT_AOVS in pathTracer.comp) for getAovs(), also without denoising.
+    // Must be set before preRun().
+    void setOutputAovs( const bool enabled ) { outputAovs = enabled || denoiseMode != eDenoiseOff; }
+
+    // The features of the last frame, 2 vec4 per pixel in the orientation of the accumulation: albedo (w: weight
+    // of the samples that hit something) and normal (w: distance, weighted). Synchronous mode only.
+    void getAovs( std::vector<float>& aovs ) {
+        if ( !outputAovs ) { throw std::runtime_error( "the AOVs are not written, see setOutputAovs()" ); }
+        if ( asyncTransfers ) { throw std::runtime_error( "the AOVs are not read back in async mode" ); }
+        void* mappedMemory = NULL;
+        const uint32_t aovSize = 2 * sizeof( Pixel ) * resx * resy;
+        vkMapMemory(device, aovBufferMemory, 0, aovSize, 0, &mappedMemory);
+        aovs.resize( aovSize / sizeof( float ) );
+        memcpy( aovs.data(), mappedMemory, aovSize );
+        vkUnmapMemory(device, aovBufferMemory);
+        if ( tiledPixels ) { PixelLayout::toLinear( aovs, 8, resx, resy ); }
+    }
+
+    // spheres with a radius / distance larger than this get a local frame, or are intersected with the emulated precision
+    void setMaxLenForFloatCalc( const float maxLen ) { maxLenForFloatCalc = maxLen; }
+
+    // debug mode for the precision benchmark, see OUTPUT_PRIMARY_HIT in pathTracer.comp
+    void setOutputPrimaryHits( const bool enabled ) { outputPrimaryHits = enabled; }
+
+    // can only be answered after init(), since it depends on the device features
+    bool isPrecisionModeSupported( const PrecisionMode mode ) const {
+        switch ( mode ) {
+            case ePrecisionFp64: return physicalDeviceFeatures.shaderFloat64 == VK_TRUE;
+            case ePrecisionR128: return physicalDeviceFeatures.shaderInt64 == VK_TRUE;
+            default: return true;
+        }
     }
     
     virtual ~PathtracerApp() {        
-        vkFreeMemory(device, planeBufferMemory, NULL);
-        vkDestroyBuffer(device, planesBuffer, NULL);
-        vkFreeMemory(device, sphereBufferMemory, NULL);
-        vkDestroyBuffer(device, spheresBuffer, NULL);
+        waitAsyncSubmissions(); // see VulkanComputeApp::submitAsync()
+        if ( asyncTransfers && device != VK_NULL_HANDLE ) {
+            vkDeviceWaitIdle(device);
+            vkDestroySemaphore(device, computeTimeline, NULL);
+            vkDestroySemaphore(device, transferTimeline, NULL);
+            vkDestroySemaphore(device, uploadTimeline, NULL);
+            vkDestroyCommandPool(device, frameCommandPool, NULL);
+            vkDestroyCommandPool(device, transferCommandPool, NULL);
+            destroyBuffer( readbackBuffer, readbackBufferMemory );
+            destroyBuffer( stagingBuffer, stagingBufferMemory );
+        }
+        destroyComputePipeline();
+        destroyBuffer( packedBuffer, packedBufferMemory );
+        destroyBuffer( aovBuffer, aovBufferMemory );
+        destroyBuffer( denoiseScratchBuffer, denoiseScratchBufferMemory );
+        destroyBuffer( statsBuffer, statsBufferMemory );
+        destroyBuffer( countersBuffer, countersBufferMemory );
+        for ( SceneBuffer& sceneBuffer : sceneBuffers ) { destroyBuffer( sceneBuffer.buffer, sceneBuffer.memory ); }
     }
     
     virtual void createComputePipeline() override {
 
-        createShader( "shaders/pathTracer.generated.spv", computeShaderModule );
+        if ( precisionMode == ePrecisionAuto ) {
+            // a camera-relative scene does not need the emulated precision at all,
+            // otherwise native doubles are the fastest exact option, double-single is the most accurate emulation that runs everywhere
+            if ( cameraRelative ) { precisionMode = ePrecisionFp32; }
+            else { precisionMode = isPrecisionModeSupported( ePrecisionFp64 ) ? ePrecisionFp64 : ePrecisionDs; }
+        }
+        if ( !isPrecisionModeSupported( precisionMode ) ) {
+            throw std::runtime_error( std::string( "precision mode " ) + precisionModeName( precisionMode ) + " is not supported by the device" );
+        }
+        printf( "using precision mode %s\n", precisionModeName( precisionMode ) );
+
+        std::string modeDefine = std::string( "PRECISION_MODE=PRECISION_" ) + precisionModeName( precisionMode );
+        std::transform( modeDefine.begin(), modeDefine.end(), modeDefine.begin(), ::toupper );
+        std::vector<std::string> defines = { modeDefine };
+        std::string spvFilename = std::string( "shaders/pathTracer." ) + precisionModeName( precisionMode );
+        if ( sceneLayout == eSceneLayoutAos ) {
+            if ( !compileShadersAtRuntime && precisionMode != ePrecisionFp32 ) {
+                throw std::runtime_error( "the array-of-structures scene layout is only precompiled for fp32" );
+            }
+            defines.push_back( "SCENE_LAYOUT_AOS=1" );
+            spvFilename += ".aos";
+        }
+        // the counters are summed per subgroup where the device can, see setPerfCounters()
+        const bool countersWithSubgroups = perfCounters && physicalDeviceInfo.subgroupArithmetic && sceneLayout != eSceneLayoutAos;
+        if ( countersWithSubgroups ) {
+            defines.push_back( "USE_SUBGROUPS=1" );
+            spvFilename += ".counters";
+        }
+        spvFilename += ".generated.spv";
+        loadShader( "shaders/pathTracer.comp", defines, spvFilename.c_str(), computeShaderModule, countersWithSubgroups ? "vulkan1.1" : "" );
+        if ( perfCounters ) { printf( "performance counters with %s\n", countersWithSubgroups ? "subgroup operations" : "atomics per invocation" ); }
 
         /*
         Now let us actually create the compute pipeline.
@@ -85,12 +488,56 @@ struct PathtracerApp : public VulkanComputeApp {
         shaderStageCreateInfo.module = computeShaderModule;
         shaderStageCreateInfo.pName = "main";
 
+        // specialization constants of pathTracer.comp
+        struct specData_t {
+            float    maxLenForFloatCalc;    // constant_id = 0
+            VkBool32 outputPrimaryHit;      // constant_id = 1
+            uint32_t workgroupSizeX;        // local_size_x_id = 2
+            uint32_t workgroupSizeY;        // local_size_y_id = 3
+            VkBool32 outputAovs;            // constant_id = 4
+            VkBool32 sceneCache;            // constant_id = 5
+            int32_t  sceneCacheSize;        // constant_id = 6
+            VkBool32 tiledPixels;           // constant_id = 7, of all passes (pixelLayout.h.glsl)
+            int32_t  accumulationFormat;    // constant_id = 8, of all passes (accumulationFormat.h.glsl)
+            VkBool32 perfCounters;          // constant_id = 9
+        } specData = { maxLenForFloatCalc, outputPrimaryHits ? VK_TRUE : VK_FALSE, workgroupSize, workgroupSize, outputAovs ? VK_TRUE : VK_FALSE,
+                       VK_FALSE, 1, tiledPixels ? VK_TRUE : VK_FALSE, accumulationFormat, perfCounters ? VK_TRUE : VK_FALSE };
+
+        // the cache is sized for the current scene, so that a small scene does not reserve shared memory it does not use
+        const uint32_t sceneCacheCapacity = std::min( sceneCacheMaxBytes, getPhysicalDeviceLimits().maxComputeSharedMemorySize ) / 16;
+        const uint32_t sceneCacheObjects = std::min( sceneCacheCapacity, static_cast<uint32_t>( scene.numPlanes() + scene.numSpheres() ) );
+        if ( sceneCache && sceneCacheObjects > 0 ) {
+            specData.sceneCache = VK_TRUE;
+            specData.sceneCacheSize = static_cast<int32_t>( sceneCacheObjects );
+            printf( "scene cache: %u of %u objects in shared memory\n", sceneCacheObjects, static_cast<uint32_t>( scene.numPlanes() + scene.numSpheres() ) );
+        }
+
+        VkSpecializationMapEntry specializationMapEntries[10] = {
+            { 0, offsetof( specData_t, maxLenForFloatCalc ), sizeof( float ) },
+            { 1, offsetof( specData_t, outputPrimaryHit ), sizeof( VkBool32 ) },
+            { 2, offsetof( specData_t, workgroupSizeX ), sizeof( uint32_t ) },
+            { 3, offsetof( specData_t, workgroupSizeY ), sizeof( uint32_t ) },
+            { 4, offsetof( specData_t, outputAovs ), sizeof( VkBool32 ) },
+            { 5, offsetof( specData_t, sceneCache ), sizeof( VkBool32 ) },
+            { 6, offsetof( specData_t, sceneCacheSize ), sizeof( int32_t ) },
+            { 7, offsetof( specData_t, tiledPixels ), sizeof( VkBool32 ) },
+            { 8, offsetof( specData_t, accumulationFormat ), sizeof( int32_t ) },
+            { 9, offsetof( specData_t, perfCounters ), sizeof( VkBool32 ) },
+        };
+
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = 10;
+        specializationInfo.pMapEntries = specializationMapEntries;
+        specializationInfo.dataSize = sizeof( specData );
+        specializationInfo.pData = &specData;
+        shaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
+
         // [husky]: Define the push constant range used by the pipeline layout
         // Note that the spec only requires a minimum of 128 bytes, so for passing larger blocks of data you'd use UBOs or SSBOs
         VkPushConstantRange pushConstantRange{};
         pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof( pushConst_t );
+        pushConstantRange.size = static_cast<uint32_t>( std::max( { sizeof( pushConst_t ), sizeof( statsPushConst_t ), sizeof( packPushConst_t ), sizeof( denoisePushConst_t ) } ) ); // shared with the other passes
 
         // The pipeline layout allows the pipeline to access descriptor sets.
         // So we just specify the descriptor set layout we created earlier.
@@ -113,97 +560,218 @@ struct PathtracerApp : public VulkanComputeApp {
             device, VK_NULL_HANDLE,
             1, &pipelineCreateInfo,
             NULL, &pipeline));
-    }
-    
-    virtual void preRun() override {
-        printf( " * before createBuffer()\n" ); fflush( stdout );
-        createBuffer( bufferSize ); // output buffer
-        
-        VkBufferCreateInfo bufferCreateInfo = {};
-        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferCreateInfo.size = bufferSize; // buffer size in bytes.
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // buffer is used as a storage buffer.
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
-        
-        printf( "planebuffer create!\n" ); fflush( stdout );
-        VkBufferCreateInfo planeBufferCreateInfo = {};
-        planeBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        planeBufferCreateInfo.size = planeBufferSize; // buffer size in bytes.
-        planeBufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // buffer is used as a storage buffer.
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
 
-        VK_CHECK_RESULT(vkCreateBuffer(device, &planeBufferCreateInfo, NULL, &planesBuffer)); // create buffer.
-
-        VkMemoryRequirements planeBufferMemoryRequirements;
-        vkGetBufferMemoryRequirements(device, planesBuffer, &planeBufferMemoryRequirements);
-
-        VkMemoryAllocateInfo planeBufferAllocateInfo = {};
-        planeBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        planeBufferAllocateInfo.allocationSize = planeBufferMemoryRequirements.size; // specify required memory.
-
-        planeBufferAllocateInfo.memoryTypeIndex = findMemoryType(
-            planeBufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        // the denoiser shares layout and workgroup size (constant_id 2 and 3) with the path tracer
+        if ( denoiseMode == eDenoiseGpu ) {
+            loadShader( "shaders/denoise.comp", {}, "shaders/denoise.generated.spv", denoiseShaderModule );
+            pipelineCreateInfo.stage.module = denoiseShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &denoisePipeline));
+        }
 
-        VK_CHECK_RESULT(vkAllocateMemory(device, &planeBufferAllocateInfo, NULL, &planeBufferMemory)); // allocate memory on device.
+        // the packing pass has a workgroup size of its own, the specialization constants of the path tracer do not apply
+        if ( isPackedReadback() ) {
+            loadShader( "shaders/packImage.comp", {}, "shaders/packImage.generated.spv", packShaderModule );
+            pipelineCreateInfo.stage.module = packShaderModule;
+            VK_CHECK_RESULT(vkCreateComputePipelines(
+                device, VK_NULL_HANDLE,
+                1, &pipelineCreateInfo,
+                NULL, &packPipeline));
+        }
 
-        // Now associate that allocated memory with the buffer. With that, the buffer is backed by actual memory.
-        VK_CHECK_RESULT(vkBindBufferMemory(device, planesBuffer, planeBufferMemory, 0));
+        if ( !statistics ) { return; }
 
-        // upload planes[] data from host to device
-        {
-            void* vpMappedMemory = NULL;
-            // Map the buffer memory, so that we can read from it on the CPU.
-            vkMapMemory(device, planeBufferMemory, 0, planeBufferSize, 0, &vpMappedMemory);
-            float* pMappedMemory = (float *)vpMappedMemory;
-            memcpy( pMappedMemory, planes, sizeof( planes ) );
-            // Done writing, so unmap.
-            vkUnmapMemory(device, planeBufferMemory);
+        // the statistics pipeline shares layout and workgroup size (constant_id 2 and 3) with the path tracer
+        if ( statisticsVariant == eStatsAuto ) {
+            statisticsVariant = physicalDeviceInfo.subgroupArithmetic ? eStatsSubgroups : eStatsSharedMemory;
+        }
+        if ( statisticsVariant == eStatsSubgroups && !physicalDeviceInfo.subgroupArithmetic ) {
+            throw std::runtime_error( "the device does not support subgroup arithmetic in compute shaders" );
         }
+        if ( statisticsVariant == eStatsSubgroups ) {
+            loadShader( "shaders/imageStats.comp", { "USE_SUBGROUPS=1" }, "shaders/imageStats.subgroups.generated.spv", statsShaderModule, "vulkan1.1" );
+        } else {
+            loadShader( "shaders/imageStats.comp", { "USE_SUBGROUPS=0" }, "shaders/imageStats.shared.generated.spv", statsShaderModule );
+        }
+        printf( "image statistics with %s\n", statisticsVariant == eStatsSubgroups ? "subgroup operations" : "shared memory" );
+        pipelineCreateInfo.stage.module = statsShaderModule;
+        VK_CHECK_RESULT(vkCreateComputePipelines(
+            device, VK_NULL_HANDLE,
+            1, &pipelineCreateInfo,
+            NULL, &statsPipeline));
+    }
 
+    virtual void destroyComputePipeline() override {
+        vkDestroyPipeline(device, statsPipeline, NULL);
+        vkDestroyShaderModule(device, statsShaderModule, NULL);
+        statsPipeline = VK_NULL_HANDLE;
+        statsShaderModule = VK_NULL_HANDLE;
+        vkDestroyPipeline(device, packPipeline, NULL);
+        vkDestroyShaderModule(device, packShaderModule, NULL);
+        packPipeline = VK_NULL_HANDLE;
+        packShaderModule = VK_NULL_HANDLE;
+        vkDestroyPipeline(device, denoisePipeline, NULL);
+        vkDestroyShaderModule(device, denoiseShaderModule, NULL);
+        denoisePipeline = VK_NULL_HANDLE;
+        denoiseShaderModule = VK_NULL_HANDLE;
+        VulkanComputeApp::destroyComputePipeline();
+    }
+    
+    virtual void fitToDeviceLimits() override {
+        workgroupSize = fitWorkgroupSize( workgroupSize );
+        checkDispatchSize( resx, resy, workgroupSize );
+    }
 
+    virtual void preRun() override {
+        if ( asyncTransfers && !hasTimelineSemaphores() ) {
+            printf( "the device has no timeline semaphores, using synchronous transfers\n" );
+            asyncTransfers = false;
+        }
+        if ( denoiseMode == eDenoiseCpu ) {
+            if ( asyncTransfers ) { throw std::runtime_error( "the host denoiser needs the synchronous mode, see setDenoiser()" ); }
+            // the host filters the float accumulation
+            readbackFormat = eReadbackFloat;
+        }
+        if ( outputPrimaryHits && accumulationFormat != AccumulationFormat::eRGBA32F ) {
+            throw std::runtime_error( "the primary hits need the RGBA32F accumulation format, see setAccumulationFormat()" );
+        }
+        if ( asyncTransfers ) {
+            printf( "async transfers on %s\n", hasSeparateTransferQueue() ? "a separate transfer queue" : "the compute queue" );
+            createAsyncResources();
+        }
 
-        printf( "spherebuffer create!\n" ); fflush( stdout );
-        VkBufferCreateInfo sphereBufferCreateInfo = {};
-        sphereBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        sphereBufferCreateInfo.size = sphereBufferSize; // buffer size in bytes.
-        sphereBufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // buffer is used as a storage buffer.
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
+        printf( " * before createBuffer()\n" ); fflush( stdout );
+        createOutputBuffers( bufferSize );
+        if ( statistics ) { createStatisticsBuffer(); }
+        createCountersBuffer();
 
-        VK_CHECK_RESULT(vkCreateBuffer(device, &sphereBufferCreateInfo, NULL, &spheresBuffer)); // create buffer.
+        uploadScene();
+    }
 
-        VkMemoryRequirements sphereBufferMemoryRequirements;
-        vkGetBufferMemoryRequirements(device, spheresBuffer, &sphereBufferMemoryRequirements);
+    // in async mode, the frame goes through submitFrame() / fetchFrame() instead of the command buffer of the base class
+    virtual void run() override {
+        if ( !asyncTransfers ) {
+            VulkanComputeApp::run();
+            return;
+        }
+        prepare();
+        fetchFrame( submitFrame() );
+    }
 
-        VkMemoryAllocateInfo sphereBufferAllocateInfo = {};
-        sphereBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        sphereBufferAllocateInfo.allocationSize = sphereBufferMemoryRequirements.size; // specify required memory.
+    // Changes resolution and samples per pixel after preRun(), e.g. for the next job of a JobRuntime.
+    // The output buffer only grows. Takes effect with the next rerun(). Returns true, if the buffer had to be reallocated.
+    bool resize( const uint32_t resx, const uint32_t resy, const int32_t spp ) {
+        this->resx = resx;
+        this->resy = resy;
+        this->spp = spp;
+        bufferSize = AccumulationFormat::bytesPerPixel( accumulationFormat ) * resx * resy;
+        pushConst.imgdim[0] = resx;
+        pushConst.imgdim[1] = resy;
+        pushConst.samps[1] = spp;
+        setWholeImage();
+
+        // the number of tiles of the statistics does not only depend on the number of pixels
+        const bool statsGrow = statistics && ImageStatistics::rawSizeInUints( resx, resy, workgroupSize ) > statsSlotCapacity;
+        const bool countersGrow = perfCounters && PerfCounters::rawSizeInUints( resx, resy, workgroupSize ) > countersSlotCapacity;
+        // so does the size of the packed image (RGB8)
+        const bool outputGrow = bufferSize > bufferCapacity || getPackedImageSize() > packedCapacity;
+        if ( !outputGrow && !statsGrow && !countersGrow ) { return false; }
+
+        VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+        if ( outputGrow ) {
+            destroyBuffer( buffer, bufferMemory );
+            destroyBuffer( packedBuffer, packedBufferMemory );
+            destroyBuffer( aovBuffer, aovBufferMemory );
+            destroyBuffer( denoiseScratchBuffer, denoiseScratchBufferMemory );
+            if ( asyncTransfers ) { destroyBuffer( readbackBuffer, readbackBufferMemory ); }
+            createOutputBuffers( bufferSize );
+        }
+        if ( statsGrow ) {
+            destroyBuffer( statsBuffer, statsBufferMemory );
+            createStatisticsBuffer();
+        }
+        if ( countersGrow ) {
+            destroyBuffer( countersBuffer, countersBufferMemory );
+            createCountersBuffer();
+        }
+        if ( descriptorSet != VK_NULL_HANDLE ) { updateDescriptorSet(); }
+        return true;
+    }
 
-        sphereBufferAllocateInfo.memoryTypeIndex = findMemoryType(
-            sphereBufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    // Converts the scene to the float arrays of pathTracer.comp and uploads them. Called by preRun(), and
+    // by setScene() once the buffers exist. The scene buffers are only reallocated if the scene grew.
+    // In async mode, the scene goes through a staging buffer and is copied on the transfer queue, after the
+    // frames in flight - so an upload overlaps them, unless the descriptor ranges change.
+    void uploadScene() {
+        const Scene gpuScene = cameraRelative ? scene.rebasedToCamera() : scene;
+        if ( sceneLayout == eSceneLayoutAos ) {
+            sceneBuffers[ eScenePlanes ].data = Scene::toFloat( gpuScene.planes );
+            sceneBuffers[ eSceneSpheres ].data = gpuScene.toGpuSpheres( maxLenForFloatCalc, cameraRelative );
+            sceneBuffers[ eSceneSphereFrames ].data.clear();
+            sceneBuffers[ eSceneMaterials ].data = gpuScene.toGpuInstancedMaterials();
+        } else {
+            sceneBuffers[ eScenePlanes ].data = gpuScene.toGpuPlaneGeometry();
+            sceneBuffers[ eSceneSpheres ].data = gpuScene.toGpuSphereGeometry();
+            sceneBuffers[ eSceneSphereFrames ].data = gpuScene.toGpuSphereFrames( maxLenForFloatCalc, cameraRelative );
+            sceneBuffers[ eSceneMaterials ].data = gpuScene.toGpuMaterials();
+        }
+        sceneBuffers[ eScenePrototypeSpheres ].data = gpuScene.toGpuPrototypeSpheres();
+        sceneBuffers[ eScenePrototypes ].data = gpuScene.toGpuPrototypes();
+        sceneBuffers[ eSceneInstances ].data = gpuScene.toGpuInstances();
+        // pathTracer.comp declares the instancing arrays in both layouts, so they are never empty
+        const SceneBufferIndex declared[3] = { eSceneMaterials, eScenePrototypeSpheres, eScenePrototypes };
+        for ( const SceneBufferIndex i : declared ) {
+            if ( sceneBuffers[i].data.empty() ) { sceneBuffers[i].data.assign( 8, 0.0f ); }
+        }
+        for ( int k = 0; k < 3; k++ ) { pushConst.camOrigin[k] = static_cast<float>( gpuScene.camera[k] ); }
 
-        VK_CHECK_RESULT(vkAllocateMemory(device, &sphereBufferAllocateInfo, NULL, &sphereBufferMemory)); // allocate memory on device.
+        bool grows = false;
+        for ( SceneBuffer& sceneBuffer : sceneBuffers ) {
+            sceneBuffer.size = static_cast<uint32_t>( sceneBuffer.data.size() * sizeof( float ) );
+            grows = grows || sceneBuffer.size > sceneBuffer.capacity;
+        }
+        if ( grows ) {
+            VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+        }
+        for ( int i = 0; i < eNumSceneBuffers; i++ ) {
+            SceneBuffer& sceneBuffer = sceneBuffers[i];
+            if ( sceneBuffer.size <= sceneBuffer.capacity ) { continue; }
+            printf( "scene buffer %s create!\n", sceneBufferName( i ) ); fflush( stdout );
+            destroyBuffer( sceneBuffer.buffer, sceneBuffer.memory );
+            createSceneBuffer( sceneBuffer.size, sceneBuffer.buffer, sceneBuffer.memory );
+            sceneBuffer.capacity = sceneBuffer.size;
+        }
 
-        // Now associate that allocated memory with the buffer. With that, the buffer is backed by actual memory.
-        VK_CHECK_RESULT(vkBindBufferMemory(device, spheresBuffer, sphereBufferMemory, 0));
+        if ( asyncTransfers ) {
+            uploadSceneAsync();
+            return;
+        }
 
-        // upload spheres[] data from host to device
-        {
+        // upload the arrays from host to device
+        for ( SceneBuffer& sceneBuffer : sceneBuffers ) {
+            if ( sceneBuffer.size == 0 ) { continue; } // unused by the layout
             void* vpMappedMemory = NULL;
-            // Map the buffer memory, so that we can read from it on the CPU.
-            vkMapMemory(device, sphereBufferMemory, 0, sphereBufferSize, 0, &vpMappedMemory);
-            float* pMappedMemory = (float *)vpMappedMemory;
-            memcpy( pMappedMemory, spheres, sizeof( spheres ) );
+            // Map the buffer memory, so that we can write to it on the CPU.
+            vkMapMemory(device, sceneBuffer.memory, 0, sceneBuffer.size, 0, &vpMappedMemory);
+            memcpy( vpMappedMemory, sceneBuffer.data.data(), sceneBuffer.size );
             // Done writing, so unmap.
-            vkUnmapMemory(device, sphereBufferMemory);
+            vkUnmapMemory(device, sceneBuffer.memory);
         }
-        
+
+        // the shader loops over the length of the arrays, so the descriptor ranges must match the scene
+        if ( descriptorSet != VK_NULL_HANDLE ) { updateDescriptorSet(); }
     }
     
     void getRenderedImage( std::vector<uint8_t> &image, const uint32_t bufferSize, const uint32_t resx, const uint32_t resy, float floatScaleFactor ) {
+        checkAccumulationReadable();
         void* mappedMemory = NULL;
         // Map the buffer memory, so that we can read from it on the CPU.
+        // In async mode, the frame is in its slot of the readback buffer, see fetchFrame().
         
-        vkMapMemory(device, bufferMemory, 0, bufferSize, 0, &mappedMemory);
+        const VkDeviceMemory memory = asyncTransfers ? readbackBufferMemory : bufferMemory;
+        vkMapMemory(device, memory, getFetchedOffset(), bufferSize, 0, &mappedMemory);
         Pixel* pmappedMemory = (Pixel*)mappedMemory;
 
         // Get the color data from the buffer, and cast it to bytes.
@@ -212,26 +780,105 @@ struct PathtracerApp : public VulkanComputeApp {
         image.reserve(resx * resy * 4);
         
         for (int i = 0; i < resx*resy; i += 1) {
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].r ) ) );
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].g ) ) );
-            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ i ].b ) ) );
+            // row-major, still upside-down - the tiled layout is undone while reading
+            const uint32_t p = PixelLayout::index( i % resx, i / resx, resx, resy, tiledPixels );
+            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ p ].r ) ) );
+            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ p ].g ) ) );
+            image.push_back( static_cast<uint8_t>( floatScaleFactor * ( pmappedMemory[ p ].b ) ) );
             image.push_back( 255u );
         }        
         
         // Done reading, so unmap.
-        vkUnmapMemory(device, bufferMemory);
+        vkUnmapMemory(device, memory);
     }
 
-    virtual void saveRenderedImage( const char* png_filename = "pathtracer.png" ) override {
-        std::vector<uint8_t> image;
+    // Copies the raw accumulation buffer (4 floats per pixel) to the host.
+    void getAccumulation( std::vector<float>& accumulation ) {
+        checkAccumulationReadable();
+        void* mappedMemory = NULL;
+        const VkDeviceMemory memory = asyncTransfers ? readbackBufferMemory : bufferMemory;
+        vkMapMemory(device, memory, getFetchedOffset(), bufferSize, 0, &mappedMemory);
+        accumulation.resize( 4 * resx * resy );
+        AccumulationFormat::decode( accumulationFormat, mappedMemory, resx * resy, accumulation.data() );
+        vkUnmapMemory(device, memory);
+        if ( tiledPixels ) { PixelLayout::toLinear( accumulation, 4, resx, resy ); }
+        // a compact format holds the linear radiance of a finalized frame, see setAccumulationFormat()
+        if ( !AccumulationFormat::holdsFinalized( accumulationFormat ) && ( pushConst.work[3] & eWorkFinalize ) && denoiseMode != eDenoiseCpu ) {
+            finalizeAccumulation( accumulation );
+        }
+    }
+
+    uint32_t getResX() const { return resx; }
+    uint32_t getResY() const { return resy; }
+    int32_t  getSpp() const { return spp; }
+    // fitted to the device limits in preRun()
+    uint32_t getWorkgroupSize() const { return workgroupSize; }
+
+    // The final image as RGBA8, upright.
+    virtual void getRenderedImageRGBA8( std::vector<uint8_t>& image ) override {
+        if ( isPackedReadback() ) {
+            image.resize( resx * resy * 4 );
+            getRenderedImageRGBA8( image.data() );
+            return;
+        }
+        if ( denoiseMode == eDenoiseCpu ) {
+            std::vector<float> accumulation, aovs;
+            getAccumulation( accumulation );
+            getAovs( aovs );
+            Denoiser::denoise( accumulation, aovs, resx, resy, denoiseParams );
+            finalizeAccumulation( accumulation );
+            accumulationToRGBA8( accumulation, resx, resy, image );
+            return;
+        }
+        if ( accumulationFormat != AccumulationFormat::eRGBA32F ) {
+            std::vector<float> accumulation;
+            getAccumulation( accumulation );
+            accumulationToRGBA8( accumulation, resx, resy, image );
+            return;
+        }
+        image.clear();
         constexpr float scaleFactor = 1.0f;
         const uint32_t bufferSize = sizeof(Pixel) * resx * resy;
         getRenderedImage( image, bufferSize, resx, resy, scaleFactor );
-        
-        printf( "writing %s\n", png_filename );
-        
-        // Now we save the acquired color data to a .png.
+        flipImageRGBA8( image, resx, resy );
+    }
 
+    // The same into resx * resy * 4 bytes at dst, e.g. shared memory - only with a packed readback format.
+    void getRenderedImageRGBA8( uint8_t* dst ) {
+        if ( !isPackedReadback() ) { throw std::runtime_error( "only a packed image can be copied as is, see setReadbackFormat()" ); }
+        const uint8_t* packed = mapPackedImage();
+        if ( readbackFormat == eReadbackRGBA8 ) {
+            memcpy( dst, packed, resx * resy * 4 );
+        } else {
+            for ( uint32_t i = 0; i < resx * resy; i++ ) {
+                dst[ i * 4 + 0 ] = packed[ i * 3 + 0 ];
+                dst[ i * 4 + 1 ] = packed[ i * 3 + 1 ];
+                dst[ i * 4 + 2 ] = packed[ i * 3 + 2 ];
+                dst[ i * 4 + 3 ] = 255u;
+            }
+        }
+        unmapPackedImage();
+    }
+
+    // Same as the last step of pathTracer.comp (WORK_FINALIZE), for accumulations that were merged on the host.
+    static void finalizeAccumulation( std::vector<float>& accumulation ) {
+        for ( size_t i = 0; i < accumulation.size(); i++ ) {
+            if ( i % 4 == 3 ) { continue; }
+            accumulation[i] = powf( std::min( std::max( accumulation[i], 0.0f ), 1.0f ), 0.45f ) * 255.0f + 0.5f;
+        }
+    }
+
+    // Converts a finalized accumulation buffer (as written by pathTracer.comp) to the upright RGBA8 image.
+    static void accumulationToRGBA8( const std::vector<float>& accumulation, const uint32_t resx, const uint32_t resy, std::vector<uint8_t>& image ) {
+        image.resize( resx * resy * 4 );
+        for ( uint32_t i = 0; i < resx * resy; i++ ) {
+            for ( int c = 0; c < 3; c++ ) { image[ i * 4 + c ] = static_cast<uint8_t>( accumulation[ i * 4 + c ] ); }
+            image[ i * 4 + 3 ] = 255u;
+        }
+        flipImageRGBA8( image, resx, resy );
+    }
+
+    static void flipImageRGBA8( std::vector<uint8_t>& image, const uint32_t resx, const uint32_t resy ) {
         // due to pinhole cam the image is upside-down and mirrored - undo that!
         uint32_t* pRGBA = ( uint32_t* ) ( &image[ 0 ] );
         for ( int y = 0; y < resy; y++ ) {
@@ -241,7 +888,23 @@ struct PathtracerApp : public VulkanComputeApp {
                 std::swap( pRGBA[ from ], pRGBA[ to ] );
             }
         }
+    }
 
+    virtual void saveRenderedImage( const char* png_filename = "pathtracer.png" ) override {
+        printf( "writing %s\n", png_filename );
+
+        // the packed image is encoded straight from the mapped memory
+        if ( isPackedReadback() ) {
+            const unsigned error = lodepng::encode( png_filename, mapPackedImage(), resx, resy, readbackFormat == eReadbackRGB8 ? LCT_RGB : LCT_RGBA );
+            unmapPackedImage();
+            if (error) printf("encoder error %d: %s", error, lodepng_error_text(error));
+            return;
+        }
+
+        std::vector<uint8_t> image;
+        getRenderedImageRGBA8( image );
+        
+        // Now we save the acquired color data to a .png.
         unsigned error = lodepng::encode(png_filename, image, resx, resy);
 
         if (error) printf("encoder error %d: %s", error, lodepng_error_text(error));
@@ -252,10 +915,10 @@ struct PathtracerApp : public VulkanComputeApp {
         // So we will allocate a descriptor set here.
         // But we need to first create a descriptor pool to do that.
 
-        //create a descriptor pool that will hold 3 storage buffers // image, planes, spheres
+        //create a descriptor pool that will hold 13 storage buffers // image, planes, spheres, statistics, packed image, AOVs, denoiser scratch, sphere frames, materials, prototype spheres, prototypes, instances, counters
         VkDescriptorPoolSize descriptorPoolSize = {
             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-            3
+            13
         };
 
         VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
@@ -287,9 +950,13 @@ struct PathtracerApp : public VulkanComputeApp {
         VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
         printf( "after vkAllocateDescriptorSets()\n" ); fflush( stdout );
 
-        // Next, we need to connect our actual storage buffer with the descrptor.
-        // We use vkUpdateDescriptorSets() to update the descriptor set.
+        updateDescriptorSet();
+        printf( "after vkUpdateDescriptorSets\n" ); fflush( stdout );
+    }
 
+    // Next, we need to connect our actual storage buffer with the descrptor.
+    // We use vkUpdateDescriptorSets() to update the descriptor set - again whenever the buffers or the scene change.
+    void updateDescriptorSet() {
 
         printf( "before binding buffers to descriptors\n" ); fflush( stdout );
         // Specify the buffer to bind to the descriptor.
@@ -298,17 +965,7 @@ struct PathtracerApp : public VulkanComputeApp {
         descriptorBufferInfo.offset = 0;
         descriptorBufferInfo.range = VK_WHOLE_SIZE;//bufferSize;
 
-        VkDescriptorBufferInfo descriptorPlaneBufferInfo = {};
-        descriptorPlaneBufferInfo.buffer = planesBuffer;
-        descriptorPlaneBufferInfo.offset = 0;
-        descriptorPlaneBufferInfo.range = VK_WHOLE_SIZE;
-
-        VkDescriptorBufferInfo descriptorSphereBufferInfo = {};
-        descriptorSphereBufferInfo.buffer = spheresBuffer;
-        descriptorSphereBufferInfo.offset = 0;
-        descriptorSphereBufferInfo.range = VK_WHOLE_SIZE;//sphereBufferSize;
-
-        VkWriteDescriptorSet writeDescriptorSet[3] = {
+        VkWriteDescriptorSet writeDescriptorSet[1] = {
             {
                 VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                 0,
@@ -320,45 +977,106 @@ struct PathtracerApp : public VulkanComputeApp {
                 0,
                 &descriptorBufferInfo,
                 0
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                0,
-                descriptorSet,
-                1, // dstBinding - planes
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                0,
-                &descriptorPlaneBufferInfo,
-                0
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                0,
-                descriptorSet,
-                2, // dstBinding - spheres
-                0,
-                1,
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                0,
-                &descriptorSphereBufferInfo,
-                0
             }
         };
 
         printf( "before vkUpdateDescriptorSets PATHTRACER_MODE\n" ); fflush( stdout );
 
         // perform the update of the descriptor set.
-        vkUpdateDescriptorSets(device, 3, writeDescriptorSet, 0, 0); // 3 buffers: image, planes, spheres
+        vkUpdateDescriptorSets(device, 1, writeDescriptorSet, 0, 0);
+
+        // the scene arrays - the frames are not used (and empty) with eSceneLayoutAos
+        for ( int i = 0; i < eNumSceneBuffers; i++ ) {
+            SceneBuffer& sceneBuffer = sceneBuffers[i];
+            sceneBuffer.boundSize = sceneBuffer.size;
+            if ( sceneBuffer.size == 0 ) { continue; }
+            VkDescriptorBufferInfo descriptorSceneBufferInfo = {};
+            descriptorSceneBufferInfo.buffer = sceneBuffer.buffer;
+            descriptorSceneBufferInfo.offset = 0;
+            descriptorSceneBufferInfo.range = sceneBuffer.size;
+            VkWriteDescriptorSet writeScene = writeDescriptorSet[0];
+            writeScene.dstBinding = sceneBufferBinding( i );
+            writeScene.pBufferInfo = &descriptorSceneBufferInfo;
+            vkUpdateDescriptorSets(device, 1, &writeScene, 0, 0);
+        }
 
-        printf( "after vkUpdateDescriptorSets\n" ); fflush( stdout );
+        // only imageStats.comp uses the statistics buffer, so it is left out if the statistics are disabled
+        if ( statsBuffer != VK_NULL_HANDLE ) {
+            VkDescriptorBufferInfo descriptorStatsBufferInfo = {};
+            descriptorStatsBufferInfo.buffer = statsBuffer;
+            descriptorStatsBufferInfo.offset = 0;
+            descriptorStatsBufferInfo.range = VK_WHOLE_SIZE;
+            VkWriteDescriptorSet writeStats = writeDescriptorSet[0];
+            writeStats.dstBinding = 3;
+            writeStats.pBufferInfo = &descriptorStatsBufferInfo;
+            vkUpdateDescriptorSets(device, 1, &writeStats, 0, 0);
+        }
+        // same for the packed image of packImage.comp
+        if ( packedBuffer != VK_NULL_HANDLE ) {
+            VkDescriptorBufferInfo descriptorPackedBufferInfo = {};
+            descriptorPackedBufferInfo.buffer = packedBuffer;
+            descriptorPackedBufferInfo.offset = 0;
+            descriptorPackedBufferInfo.range = VK_WHOLE_SIZE;
+            VkWriteDescriptorSet writePacked = writeDescriptorSet[0];
+            writePacked.dstBinding = 4;
+            writePacked.pBufferInfo = &descriptorPackedBufferInfo;
+            vkUpdateDescriptorSets(device, 1, &writePacked, 0, 0);
+        }
+        // pathTracer.comp declares the AOVs, so they are always bound (to a placeholder without OUTPUT_AOVS)
+        VkDescriptorBufferInfo descriptorAovBufferInfo = {};
+        descriptorAovBufferInfo.buffer = aovBuffer;
+        descriptorAovBufferInfo.offset = 0;
+        descriptorAovBufferInfo.range = VK_WHOLE_SIZE;
+        VkWriteDescriptorSet writeAovs = writeDescriptorSet[0];
+        writeAovs.dstBinding = 5;
+        writeAovs.pBufferInfo = &descriptorAovBufferInfo;
+        vkUpdateDescriptorSets(device, 1, &writeAovs, 0, 0);
+        if ( denoiseScratchBuffer != VK_NULL_HANDLE ) {
+            VkDescriptorBufferInfo descriptorScratchBufferInfo = descriptorAovBufferInfo;
+            descriptorScratchBufferInfo.buffer = denoiseScratchBuffer;
+            VkWriteDescriptorSet writeScratch = writeAovs;
+            writeScratch.dstBinding = 6;
+            writeScratch.pBufferInfo = &descriptorScratchBufferInfo;
+            vkUpdateDescriptorSets(device, 1, &writeScratch, 0, 0);
+        }
+        // declared by pathTracer.comp as well, a placeholder without the counters
+        VkDescriptorBufferInfo descriptorCountersBufferInfo = descriptorAovBufferInfo;
+        descriptorCountersBufferInfo.buffer = countersBuffer;
+        VkWriteDescriptorSet writeCounters = writeAovs;
+        writeCounters.dstBinding = 12;
+        writeCounters.pBufferInfo = &descriptorCountersBufferInfo;
+        vkUpdateDescriptorSets(device, 1, &writeCounters, 0, 0);
     }
     
     virtual void createCommandBuffer() override {
+        recordDispatches( commandBuffer, 0 );
+    }
+
+private:
+    // one dispatch per sample of the sample range, then the denoiser, statistics and packing passes; slot: of the async mode
+    void recordDispatches( const VkCommandBuffer commandBuffer, const uint32_t slot ) {
+
+        // the denoiser needs the linear radiance, it finalizes the frame itself (or the host does, see setDenoiser()) -
+        // and a compact accumulation format stays linear, see setAccumulationFormat(). The GPU denoiser only filters
+        // the last sample range, a range that does not finalize is followed by more samples on the unfiltered radiance.
+        const uint32_t workFlags = pushConst.work[3];
+        const bool finalizeInBuffer = AccumulationFormat::holdsFinalized( accumulationFormat );
+        const bool gpuDenoise = denoiseMode == eDenoiseGpu && ( workFlags & eWorkFinalize ) != 0;
+        if ( denoiseMode == eDenoiseCpu || gpuDenoise || !finalizeInBuffer ) { pushConst.work[3] &= ~static_cast<uint32_t>( eWorkFinalize ); }
+
+        VkMemoryBarrier countersBarrier = {};
+        countersBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        if ( perfCounters ) {
+            // the counters of the slot start from zero, before the atomics of the first sample
+            vkCmdFillBuffer( commandBuffer, countersBuffer, static_cast<VkDeviceSize>( slot ) * countersSlotCapacity * sizeof( uint32_t ),
+                             static_cast<VkDeviceSize>( PerfCounters::rawSizeInUints( resx, resy, workgroupSize ) ) * sizeof( uint32_t ), 0u );
+            countersBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            countersBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                  1, &countersBarrier, 0, NULL, 0, NULL );
+        }
 
-        printf( "\n   ### entering spp loop ###\n\n" ); fflush( stdout );
-        for ( int32_t sampNum = 0; sampNum < spp; sampNum++ ) {
+        for ( int32_t sampNum = static_cast<int32_t>( pushConst.work[0] ); sampNum < static_cast<int32_t>( pushConst.work[1] ); sampNum++ ) {
 
             pushConst.samps[ 0 ] = sampNum;
 
@@ -372,28 +1090,423 @@ struct PathtracerApp : public VulkanComputeApp {
             // Calling vkCmdDispatch basically starts the compute pipeline, and executes the compute shader.
             // The number of workgroups is specified in the arguments.
             // If you are already familiar with compute shaders from OpenGL, this should be nothing new to you.
-            vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(resy / float(workgroupSize)), 1);
+            vkCmdDispatch(commandBuffer, (uint32_t)ceil(resx / float(workgroupSize)), (uint32_t)ceil(numRows / float(workgroupSize)), 1);
+        }
+        if ( perfCounters ) {
+            // read by getPerfCounters()
+            countersBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            countersBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &countersBarrier, 0, NULL, 0, NULL );
+        }
+
+        if ( gpuDenoise ) {
+            recordDenoisePasses( commandBuffer, finalizeInBuffer );
+            if ( finalizeInBuffer ) { pushConst.work[3] = workFlags; }
         }
-        printf( "\n   ### leaving spp loop ###\n\n" ); fflush( stdout );
+        if ( statistics ) { recordStatisticsPass( commandBuffer, slot ); }
+        if ( isPackedReadback() ) { recordPackPass( commandBuffer, slot ); }
+        pushConst.work[3] = workFlags;
     }
 
-private:
-    VkBuffer planesBuffer;
-    VkDeviceMemory planeBufferMemory;
-    uint32_t planeBufferSize = sizeof( planes ); // size of `buffer` in bytes.
+    // one dispatch per iteration of the filter, each reads what the previous one wrote
+    void recordDenoisePasses( const VkCommandBuffer commandBuffer, const bool finalize ) {
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        denoisePushConst_t denoisePushConst = {};
+        denoisePushConst.imgdim[0] = resx;
+        denoisePushConst.imgdim[1] = resy;
+        denoisePushConst.base = pushConst.outputBase;
+        denoisePushConst.numIterations = denoiseParams.numIterations;
+        denoisePushConst.finalize = finalize ? 1u : 0u;
+        denoisePushConst.sigmaColor = denoiseParams.sigmaColor;
+        denoisePushConst.sigmaNormal = denoiseParams.sigmaNormal;
+        denoisePushConst.sigmaDepth = denoiseParams.sigmaDepth;
+        denoisePushConst.sigmaAlbedo = denoiseParams.sigmaAlbedo;
+        vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline );
+        for ( uint32_t iteration = 0; iteration < denoiseParams.numIterations; iteration++ ) {
+            vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                  1, &memoryBarrier, 0, NULL, 0, NULL );
+            denoisePushConst.iteration = iteration;
+            vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( denoisePushConst_t ), &denoisePushConst );
+            vkCmdDispatch( commandBuffer, ( resx + workgroupSize - 1 ) / workgroupSize, ( resy + workgroupSize - 1 ) / workgroupSize, 1 );
+        }
+        // the passes after it (and the host) read the denoised frame
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+                              1, &memoryBarrier, 0, NULL, 0, NULL );
+    }
+
+    void recordPackPass( const VkCommandBuffer commandBuffer, const uint32_t slot ) {
+        // reads the accumulation of the samples
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                              1, &memoryBarrier, 0, NULL, 0, NULL );
+
+        packPushConst_t packPushConst = {};
+        packPushConst.imgdim[0] = resx;
+        packPushConst.imgdim[1] = resy;
+        packPushConst.inputBase = pushConst.outputBase;
+        packPushConst.outputBase = slot * ( packedCapacity / sizeof( uint32_t ) );
+        packPushConst.bytesPerPixel = getBytesPerPackedPixel();
+        packPushConst.finalized = ( pushConst.work[3] & eWorkFinalize ) ? 1u : 0u;
+        // samples [0, end sample) are in the accumulation, each weighted with 1 / spp - an unfinished frame is brightened
+        // to the full weight (see ProgressivePreview)
+        packPushConst.scale = pushConst.work[1] > 0 ? static_cast<float>( spp ) / pushConst.work[1] : 1.0f;
+        vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, packPipeline );
+        vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( packPushConst_t ), &packPushConst );
+        // 64 uints per workgroup (see packImage.comp), spread over rows of workgroups
+        const uint32_t numGroups = ( getPackedImageSize() / sizeof( uint32_t ) + 63 ) / 64;
+        const uint32_t numGroupsX = std::min( numGroups, 65535u );
+        vkCmdDispatch( commandBuffer, numGroupsX, ( numGroups + numGroupsX - 1 ) / numGroupsX, 1 );
+
+        // read by the host, or copied to the readback buffer in async mode (which the timeline semaphore orders)
+        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+    }
+
+    uint32_t getBytesPerPackedPixel() const { return readbackFormat == eReadbackRGB8 ? 3 : 4; }
+    // size of the packed image of the current resolution, a whole number of uints
+    uint32_t getPackedImageSize() const { return ( resx * resy * getBytesPerPackedPixel() + 3 ) / 4 * 4; }
+    // size of a slot of the readback buffer (async mode)
+    uint32_t getReadbackSlotCapacity() const { return isPackedReadback() ? packedCapacity : bufferCapacity; }
+    // pixels of a slot of the output buffer, in the accumulation format
+    uint32_t getPixelCapacity() const { return bufferCapacity / AccumulationFormat::bytesPerPixel( accumulationFormat ); }
+
+    // the packed image of the last frame (after rerun(), or fetchFrame() in async mode)
+    const uint8_t* mapPackedImage() {
+        void* mappedMemory = NULL;
+        vkMapMemory(device, asyncTransfers ? readbackBufferMemory : packedBufferMemory, getFetchedOffset(), getPackedImageSize(), 0, &mappedMemory);
+        return static_cast<const uint8_t*>( mappedMemory );
+    }
+    void unmapPackedImage() {
+        vkUnmapMemory(device, asyncTransfers ? readbackBufferMemory : packedBufferMemory);
+    }
+
+    // in async mode, a packed image is read back instead of the accumulation
+    void checkAccumulationReadable() const {
+        if ( asyncTransfers && isPackedReadback() ) {
+            throw std::runtime_error( "the accumulation is not read back in async mode with a packed readback format, see setReadbackFormat()" );
+        }
+    }
+
+    void recordStatisticsPass( const VkCommandBuffer commandBuffer, const uint32_t slot ) {
+        // reset min (to FLT_MAX), max and the histogram - the tiles are overwritten anyway
+        const VkDeviceSize statsOffset = static_cast<VkDeviceSize>( slot ) * statsSlotCapacity * sizeof( uint32_t );
+        vkCmdFillBuffer( commandBuffer, statsBuffer, statsOffset, sizeof( uint32_t ), 0x7F7FFFFFu );
+        vkCmdFillBuffer( commandBuffer, statsBuffer, statsOffset + sizeof( uint32_t ), ( ImageStatistics::kHeaderUints - 1 ) * sizeof( uint32_t ), 0u );
+
+        // the statistics read the accumulation of the samples, and update what the fill wrote
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                              1, &memoryBarrier, 0, NULL, 0, NULL );
+
+        statsPushConst_t statsPushConst = {};
+        statsPushConst.imgdim[0] = resx;
+        statsPushConst.imgdim[1] = resy;
+        statsPushConst.inputBase = pushConst.outputBase;
+        statsPushConst.statsBase = slot * statsSlotCapacity;
+        statsPushConst.logLumRange[0] = logLumRange[0];
+        statsPushConst.logLumRange[1] = logLumRange[1];
+        statsPushConst.finalized = ( pushConst.work[3] & eWorkFinalize ) ? 1u : 0u;
+        vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, statsPipeline );
+        vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( statsPushConst_t ), &statsPushConst );
+        vkCmdDispatch( commandBuffer, ( resx + workgroupSize - 1 ) / workgroupSize, ( resy + workgroupSize - 1 ) / workgroupSize, 1 );
+
+        // read by getStatistics()
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, NULL, 0, NULL );
+    }
+
+    // two slots (see setAsyncTransfers()) for the statistics of the current resolution
+    void createStatisticsBuffer() {
+        statsSlotCapacity = ImageStatistics::rawSizeInUints( resx, resy, workgroupSize );
+        createBuffer( 2 * statsSlotCapacity * sizeof( uint32_t ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      statsBuffer, statsBufferMemory );
+    }
+
+    // two slots (see setAsyncTransfers()) for the counters of the current resolution, or a placeholder for binding 12
+    void createCountersBuffer() {
+        if ( !perfCounters ) {
+            countersSlotCapacity = 0;
+            createBuffer( 16, countersBuffer, countersBufferMemory );
+            return;
+        }
+        countersSlotCapacity = PerfCounters::rawSizeInUints( resx, resy, workgroupSize );
+        createBuffer( 2 * countersSlotCapacity * sizeof( uint32_t ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      countersBuffer, countersBufferMemory );
+    }
+
+    // The output buffer - and the packed image (see setReadbackFormat()) and in async mode, the readback buffer - for
+    // frames of bufferSize bytes.
+    void createOutputBuffers( const uint32_t bufferSize ) {
+        bufferCapacity = bufferSize;
+        packedCapacity = isPackedReadback() ? getPackedImageSize() : 0;
+        createFeatureBuffers();
+        if ( !asyncTransfers ) {
+            createBuffer( bufferSize ); // output buffer
+            // read on the host, cached memory makes that much faster
+            if ( isPackedReadback() ) {
+                createBuffer( packedCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                              packedBuffer, packedBufferMemory );
+            }
+            return;
+        }
+        // two slots each, device-local memory if there is any (there is no such thing on some software implementations)
+        createBuffer( 2 * bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      buffer, bufferMemory );
+        if ( isPackedReadback() ) {
+            createBuffer( 2 * packedCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                          packedBuffer, packedBufferMemory );
+        }
+        // cached memory makes reading on the host much faster
+        createBuffer( 2 * getReadbackSlotCapacity(), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      readbackBuffer, readbackBufferMemory );
+    }
+
+    // AOVs and the scratch images of the denoiser, two vec4 per pixel of the output buffer each (whatever its format)
+    void createFeatureBuffers() {
+        const uint32_t numSlots = asyncTransfers ? 2 : 1;
+        if ( !outputAovs ) {
+            createBuffer( 16, aovBuffer, aovBufferMemory ); // placeholder for binding 5, see updateDescriptorSet()
+        } else if ( asyncTransfers ) {
+            createBuffer( numSlots * 2 * sizeof( Pixel ) * getPixelCapacity(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                          aovBuffer, aovBufferMemory );
+        } else {
+            createBuffer( 2 * sizeof( Pixel ) * getPixelCapacity(), aovBuffer, aovBufferMemory ); // read by getAovs()
+        }
+        if ( denoiseMode == eDenoiseGpu ) {
+            createBuffer( numSlots * 2 * sizeof( Pixel ) * getPixelCapacity(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                          denoiseScratchBuffer, denoiseScratchBufferMemory );
+        }
+    }
+
+    // host-visible in the synchronous mode, device-local and filled from the staging buffer in async mode
+    void createSceneBuffer( const uint32_t size, VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory ) {
+        if ( !asyncTransfers ) {
+            createBuffer( size, dstBuffer, dstBufferMemory );
+            return;
+        }
+        createBuffer( size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT },
+                      dstBuffer, dstBufferMemory );
+    }
+
+    // timeline semaphores and command buffers of the async mode
+    void createAsyncResources() {
+        computeTimeline = createTimelineSemaphore();
+        transferTimeline = createTimelineSemaphore();
+        uploadTimeline = createTimelineSemaphore();
+
+        // the command buffers are re-recorded for every frame, so they must be resettable individually
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, NULL, &frameCommandPool));
+        commandPoolCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+        VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, NULL, &transferCommandPool));
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandPool = frameCommandPool;
+        commandBufferAllocateInfo.commandBufferCount = 2;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, frameCommandBuffers));
+        commandBufferAllocateInfo.commandPool = transferCommandPool;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, readbackCommandBuffers));
+        commandBufferAllocateInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &uploadCommandBuffer));
+    }
+
+    // second half of uploadScene() in async mode
+    void uploadSceneAsync() {
+        // the previous upload has to be done with the staging buffer and the command buffer
+        waitTimelineSemaphore( uploadTimeline, lastUpload );
+
+        uint32_t stagingSize = 0;
+        for ( const SceneBuffer& sceneBuffer : sceneBuffers ) { stagingSize += sceneBuffer.size; }
+        if ( stagingSize > stagingBufferCapacity ) {
+            destroyBuffer( stagingBuffer, stagingBufferMemory );
+            createBuffer( stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT }, stagingBuffer, stagingBufferMemory );
+            stagingBufferCapacity = stagingSize;
+        }
+        void* vpMappedMemory = NULL;
+        vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &vpMappedMemory);
+        uint32_t offset = 0;
+        for ( const SceneBuffer& sceneBuffer : sceneBuffers ) {
+            memcpy( static_cast<uint8_t*>( vpMappedMemory ) + offset, sceneBuffer.data.data(), sceneBuffer.size );
+            offset += sceneBuffer.size;
+        }
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        // A descriptor set must not be updated while a submitted command buffer uses it, so a scene with other
+        // sizes waits for the frames in flight. Scenes of the same size keep the descriptor set as it is.
+        bool rangesChanged = false;
+        for ( const SceneBuffer& sceneBuffer : sceneBuffers ) { rangesChanged = rangesChanged || sceneBuffer.size != sceneBuffer.boundSize; }
+        if ( rangesChanged && descriptorSet != VK_NULL_HANDLE ) {
+            waitTimelineSemaphore( computeTimeline, submittedFrames );
+            updateDescriptorSet();
+        }
+
+        VK_CHECK_RESULT(vkResetCommandBuffer(uploadCommandBuffer, 0));
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(uploadCommandBuffer, &beginInfo));
+        offset = 0;
+        for ( const SceneBuffer& sceneBuffer : sceneBuffers ) {
+            if ( sceneBuffer.size > 0 ) {
+                VkBufferCopy region = { offset, 0, sceneBuffer.size };
+                vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, sceneBuffer.buffer, 1, &region);
+            }
+            offset += sceneBuffer.size;
+        }
+        VK_CHECK_RESULT(vkEndCommandBuffer(uploadCommandBuffer));
 
-    VkBuffer spheresBuffer;
-    VkDeviceMemory sphereBufferMemory;
-    uint32_t sphereBufferSize = sizeof( spheres ); // size of `buffer` in bytes.
+        // Overwriting the scene has to wait for the frames in flight that still read it. The next frames wait for
+        // lastUpload (see submitFrame()), the semaphore makes the copy visible to them.
+        lastUpload++;
+        submitTimeline( transferQueue, uploadCommandBuffer, { computeTimeline }, { submittedFrames }, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        uploadTimeline, lastUpload );
+    }
+
+    // offset of the fetched frame in the readback buffer (async mode), 0 in the synchronous mode
+    VkDeviceSize getFetchedOffset() const {
+        return asyncTransfers ? static_cast<VkDeviceSize>( fetchedSlot ) * getReadbackSlotCapacity() : 0;
+    }
+
+    Scene scene;
+    bool cameraRelative = true;
+
+    SceneLayout sceneLayout = eSceneLayoutSoa;
+    bool sceneCache = true;                 // see setSceneCache()
+    uint32_t sceneCacheMaxBytes = 16384;
+    bool tiledPixels = false;               // see setTiledPixels()
+    AccumulationFormat::Format accumulationFormat = AccumulationFormat::eRGBA32F;
+
+    // the arrays of the scene, see Scene::toGpuPlaneGeometry() and Scene::toGpuInstances() - with eSceneLayoutAos,
+    // the planes and spheres hold the whole records, the frames are empty and the materials are those of the instances
+    enum SceneBufferIndex : int32_t {
+        eScenePlanes = 0,       // binding 1
+        eSceneSpheres,          // binding 2
+        eSceneSphereFrames,     // binding 7
+        eSceneMaterials,        // binding 8
+        eScenePrototypeSpheres, // binding 9
+        eScenePrototypes,       // binding 10
+        eSceneInstances,        // binding 11
+        eNumSceneBuffers
+    };
+    struct SceneBuffer {
+        std::vector<float> data;            // as uploaded to the GPU
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint32_t size = 0;                  // of the current scene in bytes
+        uint32_t capacity = 0;              // allocated size of `buffer` in bytes
+        uint32_t boundSize = 0;             // range in the descriptor set, see uploadSceneAsync()
+    };
+    SceneBuffer sceneBuffers[eNumSceneBuffers];
+
+    static uint32_t sceneBufferBinding( const int index ) {
+        static const uint32_t bindings[eNumSceneBuffers] = { 1, 2, 7, 8, 9, 10, 11 };
+        return bindings[ index ];
+    }
+    static const char* sceneBufferName( const int index ) {
+        static const char* names[eNumSceneBuffers] = { "planes", "spheres", "sphere frames", "materials", "prototype spheres", "prototypes", "instances" };
+        return names[ index ];
+    }
+
+    PrecisionMode precisionMode = ePrecisionAuto;
+    float maxLenForFloatCalc = 500.0f;
+    bool outputPrimaryHits = false;
 
     // The pixels of the rendered mandelbrot set are in this format:
     struct Pixel {
         float r, g, b, a;
     };
-    uint32_t bufferSize; // size of `buffer` in bytes.
+    uint32_t bufferSize; // size of `buffer` in bytes that the current resolution uses.
+    uint32_t bufferCapacity = 0; // allocated size of `buffer` in bytes.
     uint32_t resx, resy;
     int32_t  spp;
+    uint32_t numRows; // of the row range, see setRowRange()
     uint32_t workgroupSize;
+
+    // image statistics, see setStatistics()
+    bool statistics = false;
+    StatisticsVariant statisticsVariant = eStatsAuto;
+    float logLumRange[2] = { -10.0f, 6.0f };
+    VkPipeline statsPipeline = VK_NULL_HANDLE;
+    VkShaderModule statsShaderModule = VK_NULL_HANDLE;
+    VkBuffer statsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory statsBufferMemory = VK_NULL_HANDLE;
+    uint32_t statsSlotCapacity = 0; // in uints
+
+    // performance counters, see setPerfCounters()
+    bool perfCounters = false;
+    VkBuffer countersBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory countersBufferMemory = VK_NULL_HANDLE;
+    uint32_t countersSlotCapacity = 0; // in uints
+
+    // packed 8 bit image, see setReadbackFormat()
+    ReadbackFormat readbackFormat = eReadbackRGBA8;
+    VkPipeline packPipeline = VK_NULL_HANDLE;
+    VkShaderModule packShaderModule = VK_NULL_HANDLE;
+    VkBuffer packedBuffer = VK_NULL_HANDLE;     // one slot (two in async mode) of packedCapacity bytes
+    VkDeviceMemory packedBufferMemory = VK_NULL_HANDLE;
+    uint32_t packedCapacity = 0;
+
+    // denoiser, see setDenoiser() / setOutputAovs()
+    DenoiseMode denoiseMode = eDenoiseOff;
+    Denoiser::Params denoiseParams;
+    bool outputAovs = false;
+    VkPipeline denoisePipeline = VK_NULL_HANDLE;
+    VkShaderModule denoiseShaderModule = VK_NULL_HANDLE;
+    VkBuffer aovBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory aovBufferMemory = VK_NULL_HANDLE;
+    VkBuffer denoiseScratchBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory denoiseScratchBufferMemory = VK_NULL_HANDLE;
+
+    // async mode, see setAsyncTransfers()
+    bool asyncTransfers = false;
+    VkBuffer readbackBuffer = VK_NULL_HANDLE;    // host-visible, two slots of getReadbackSlotCapacity() bytes
+    VkDeviceMemory readbackBufferMemory = VK_NULL_HANDLE;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;     // the scene arrays, one after the other
+    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+    uint32_t stagingBufferCapacity = 0;
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    VkSemaphore transferTimeline = VK_NULL_HANDLE;
+    VkSemaphore uploadTimeline = VK_NULL_HANDLE;
+    VkCommandPool frameCommandPool = VK_NULL_HANDLE;     // compute queue family
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;  // transfer queue family
+    VkCommandBuffer frameCommandBuffers[2];
+    VkCommandBuffer readbackCommandBuffers[2];
+    VkCommandBuffer uploadCommandBuffer;
+    uint64_t submittedFrames = 0;
+    uint64_t fetchedFrames = 0;
+    uint64_t lastUpload = 0;
+    uint32_t fetchedSlot = 0;
+    std::chrono::high_resolution_clock::time_point submitTimes[2];
 };
 
 #endif // _PATHTRACERAPP_H_
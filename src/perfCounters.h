@@ -0,0 +1,142 @@
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+// Performance counters of pathTracer.comp (PERF_COUNTERS, see PathtracerApp::setPerfCounters()): camera paths,
+// rays, path vertices, shadow rays, Russian roulette terminations, misses, intersection tests and emulated-precision
+// fallbacks - per tile of the image and in total, for one frame. The shader sums them per subgroup (or per
+// invocation) and adds them to the tile with atomics, only these raw records are read back.
+//
+// From the totals and the frame time follow rays/s, the average path length and the precision-fallback rate; the
+// tiles are written as heatmaps (writeHeatmapPNG()) that show where in the image the work is, and everything can
+// be exported as JSON next to the timing report (toJson()).
+
+#include "json.h"
+
+#include "external/lodepng/lodepng.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct PerfCounters {
+
+    // keep in sync with PERF_* in pathTracer.comp
+    enum Counter : int32_t {
+        ePaths = 0,         // camera paths, one per pixel and sample
+        eRays,              // calls of intersect(): path segments, shadow rays and misses
+        eHits,              // path vertices, the surfaces the paths hit
+        eShadowRays,        // next event estimation
+        eRoulette,          // paths ended by Russian roulette
+        eMisses,            // path segments that leave the scene
+        ePrimitiveTests,    // ray-plane, ray-sphere and bounding-sphere tests
+        ePrecisionFallbacks,// sphere tests that took the emulated-precision path
+        eNumCounters
+    };
+
+    static const char* name( const Counter counter ) {
+        static const char* names[eNumCounters] = { "paths", "rays", "hits", "shadow-rays", "roulette", "misses", "primitive-tests", "precision-fallbacks" };
+        return names[ counter ];
+    }
+
+    uint32_t resx = 0, resy = 0;
+    uint32_t tileSize = 0;                  // tiles are tileSize x tileSize pixels, the last row / column may be smaller
+    uint32_t numTilesX = 0, numTilesY = 0;
+
+    uint64_t totals[eNumCounters] = {};
+    std::vector<uint64_t> tiles;            // eNumCounters per tile, tiles in rows top to bottom (as the final image)
+
+    // size of the raw record of pathTracer.comp for the given resolution: a 64 bit counter (low, high uint) per
+    // counter and tile
+    static uint32_t rawSizeInUints( const uint32_t resx, const uint32_t resy, const uint32_t tileSize ) {
+        return 2 * eNumCounters * ( ( resx + tileSize - 1 ) / tileSize ) * ( ( resy + tileSize - 1 ) / tileSize );
+    }
+
+    static PerfCounters fromRaw( const uint32_t* raw, const uint32_t resx, const uint32_t resy, const uint32_t tileSize ) {
+        PerfCounters counters;
+        counters.resx = resx;
+        counters.resy = resy;
+        counters.tileSize = tileSize;
+        counters.numTilesX = ( resx + tileSize - 1 ) / tileSize;
+        counters.numTilesY = ( resy + tileSize - 1 ) / tileSize;
+        counters.tiles.resize( static_cast<size_t>( counters.numTilesX ) * counters.numTilesY * eNumCounters );
+        for ( size_t i = 0; i < counters.tiles.size(); i++ ) {
+            counters.tiles[i] = raw[ 2 * i ] | ( static_cast<uint64_t>( raw[ 2 * i + 1 ] ) << 32 );
+            counters.totals[ i % eNumCounters ] += counters.tiles[i];
+        }
+        return counters;
+    }
+
+    uint64_t tile( const uint32_t tileX, const uint32_t tileY, const Counter counter ) const {
+        return tiles[ ( static_cast<size_t>( tileY ) * numTilesX + tileX ) * eNumCounters + counter ];
+    }
+
+    // rays (path segments and shadow rays) per second, for a frame of frameMs
+    double raysPerSecond( const double frameMs ) const { return frameMs > 0.0 ? totals[eRays] / ( frameMs * 1e-3 ) : 0.0; }
+    // surfaces hit per camera path
+    double averagePathLength() const { return ratio( totals[eHits], totals[ePaths] ); }
+    // share of the intersection tests that took the emulated-precision path - 0 for fp32, which has none
+    double precisionFallbackRate() const { return ratio( totals[ePrecisionFallbacks], totals[ePrimitiveTests] ); }
+
+    void print( const double frameMs ) const {
+        printf( "%.3f Mrays/s, %.3f hits per path, %.2f rays per path, %.2f%% of the paths ended by Russian roulette, precision fallback rate %.3e\n",
+            raysPerSecond( frameMs ) * 1e-6, averagePathLength(), ratio( totals[eRays], totals[ePaths] ),
+            100.0 * ratio( totals[eRoulette], totals[ePaths] ), precisionFallbackRate() );
+        for ( int32_t c = 0; c < eNumCounters; c++ ) {
+            printf( "  %-20s %16llu\n", name( static_cast<Counter>( c ) ), static_cast<unsigned long long>( totals[c] ) );
+        }
+    }
+
+    // Colors every pixel of a resx x resy image after the value of counter in its tile, per camera path of the
+    // tile (or in total), from black over red and yellow to white at the largest value of a tile.
+    void writeHeatmapPNG( const char* filename, const Counter counter, const bool perPath = true ) const {
+        std::vector<double> values( static_cast<size_t>( numTilesX ) * numTilesY );
+        double maxValue = 0.0;
+        for ( uint32_t ty = 0; ty < numTilesY; ty++ ) {
+            for ( uint32_t tx = 0; tx < numTilesX; tx++ ) {
+                const uint64_t value = tile( tx, ty, counter );
+                double& v = values[ ty * numTilesX + tx ];
+                v = perPath ? ratio( value, tile( tx, ty, ePaths ) ) : static_cast<double>( value );
+                maxValue = std::max( maxValue, v );
+            }
+        }
+        std::vector<uint8_t> image( static_cast<size_t>( resx ) * resy * 4 );
+        for ( uint32_t y = 0; y < resy; y++ ) {
+            for ( uint32_t x = 0; x < resx; x++ ) {
+                const double t = maxValue > 0.0 ? values[ ( y / tileSize ) * numTilesX + x / tileSize ] / maxValue : 0.0;
+                uint8_t* rgba = &image[ ( static_cast<size_t>( y ) * resx + x ) * 4 ];
+                rgba[0] = toByte( 3.0 * t );
+                rgba[1] = toByte( 3.0 * t - 1.0 );
+                rgba[2] = toByte( 3.0 * t - 2.0 );
+                rgba[3] = 255;
+            }
+        }
+        const unsigned error = lodepng::encode( filename, image, resx, resy );
+        if ( error ) { printf( "encoder error %u: %s\n", error, lodepng_error_text( error ) ); }
+    }
+
+    // the totals and the derived numbers as a JSON object, frameMs: the time of the frame
+    std::string toJson( const double frameMs ) const {
+        std::string json = "{ \"resolution\": [ " + std::to_string( resx ) + ", " + std::to_string( resy ) + " ], \"tileSize\": " + std::to_string( tileSize );
+        json += ", \"frameMs\": " + number( frameMs ) + ", \"raysPerSecond\": " + number( raysPerSecond( frameMs ) );
+        json += ", \"averagePathLength\": " + number( averagePathLength() ) + ", \"precisionFallbackRate\": " + number( precisionFallbackRate() );
+        json += ", \"totals\": { ";
+        for ( int32_t c = 0; c < eNumCounters; c++ ) {
+            json += ( c > 0 ? ", " : "" ) + jsonString( name( static_cast<Counter>( c ) ) ) + ": " + std::to_string( totals[c] );
+        }
+        return json + " } }";
+    }
+
+private:
+    static double ratio( const uint64_t a, const uint64_t b ) { return b > 0 ? static_cast<double>( a ) / b : 0.0; }
+    static uint8_t toByte( const double v ) { return static_cast<uint8_t>( std::min( std::max( v, 0.0 ), 1.0 ) * 255.0 + 0.5 ); }
+    static std::string number( const double v ) {
+        char buffer[32];
+        snprintf( buffer, sizeof( buffer ), "%.6g", v );
+        return buffer;
+    }
+};
+
+#endif // _PERFCOUNTERS_H_
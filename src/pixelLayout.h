@@ -0,0 +1,51 @@
+#ifndef _PIXEL_LAYOUT_H_
+#define _PIXEL_LAYOUT_H_
+
+// Order of the pixels in the accumulation buffer of pathTracer.comp - the host side of shaders/pixelLayout.h.glsl,
+// see PathtracerApp::setTiledPixels(). Row-major, or 8x8 tiles in row-major order with the pixels of a tile in
+// Z-order. The host always works with the row-major image, the float readbacks are detiled with toLinear().
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+struct PixelLayout {
+
+    // keep in sync with PIXEL_TILE_SIZE in pixelLayout.h.glsl
+    static const uint32_t tileSize = 8;
+
+    // same as pixelIndex() in pixelLayout.h.glsl
+    static uint32_t index( const uint32_t x, const uint32_t y, const uint32_t resx, const uint32_t resy, const bool tiled ) {
+        if ( !tiled ) { return y * resx + x; }
+        const uint32_t tileX = x / tileSize, tileY = y / tileSize, localX = x % tileSize, localY = y % tileSize;
+        // the border tiles are smaller
+        const uint32_t restX = resx - tileX * tileSize, restY = resy - tileY * tileSize;
+        const uint32_t tileW = restX < tileSize ? restX : tileSize, tileH = restY < tileSize ? restY : tileSize;
+        const uint32_t first = tileY * tileSize * resx + tileX * tileSize * tileH;
+        if ( tileW == tileSize && tileH == tileSize ) { return first + ( spreadBits3( localX ) | ( spreadBits3( localY ) << 1 ) ); }
+        return first + localY * tileW + localX;
+    }
+
+    // reorders an image with floatsPerPixel floats per pixel from the tiled to the row-major layout
+    static void toLinear( std::vector<float>& data, const uint32_t floatsPerPixel, const uint32_t resx, const uint32_t resy ) {
+        std::vector<float> linear( data.size() );
+        for ( uint32_t y = 0; y < resy; y++ ) {
+            for ( uint32_t x = 0; x < resx; x++ ) {
+                const size_t from = static_cast<size_t>( index( x, y, resx, resy, true ) ) * floatsPerPixel;
+                const size_t to = ( static_cast<size_t>( y ) * resx + x ) * floatsPerPixel;
+                std::copy( data.begin() + from, data.begin() + from + floatsPerPixel, linear.begin() + to );
+            }
+        }
+        data.swap( linear );
+    }
+
+private:
+    // b2 b1 b0 -> b2 0 b1 0 b0
+    static uint32_t spreadBits3( uint32_t v ) {
+        v = ( v | ( v << 2 ) ) & 0x33u;
+        return ( v | ( v << 1 ) ) & 0x55u;
+    }
+};
+
+#endif // _PIXEL_LAYOUT_H_
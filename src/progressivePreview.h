@@ -0,0 +1,323 @@
+#ifndef _PROGRESSIVEPREVIEW_H_
+#define _PROGRESSIVEPREVIEW_H_
+
+// Interactive preview: renders a frame progressively, so that a first image is there after a few milliseconds and
+// then gets better, instead of after the whole render. Made for iterating on a scene with an external viewer.
+//
+//   1. 1/8 of the resolution with one sample per pixel (setFirstDownscale()), then 1/4 with two and 1/2 with four
+//      samples - each a frame of its own, whose samples are discarded by the next level
+//   2. the full resolution, in batches of samples that are added to the accumulation until spp is reached. A batch
+//      is sized to take about setBatchTargetMs(), from the time per sample of the previous batch
+//
+// Every level and every batch ends with a snapshot - the partial accumulation is brightened to the full weight by
+// packImage.comp. Snapshots go to a ring of slots in POSIX shared memory (setSharedMemoryRing(), layout below)
+// and / or to a PNG that is rewritten at most every setPngInterval() ms and at the end.
+//
+// setScene() - from any thread, e.g. a UI - cancels the refinement: the batch in flight finishes (batches are short),
+// its snapshot is dropped, and the preview starts over at the lowest level with the new scene / camera.
+//
+// Shared-memory layout, all little-endian: a RingHeader followed by numSlots slots of a SlotHeader and slotCapacity
+// bytes of RGBA8 pixels (rows top to bottom). The writer clears the sequence of a slot while writing it, sets it
+// when done, and publishes it in RingHeader::latest. A reader takes the slot latest % numSlots, and checks that its
+// sequence is latest before and after copying the pixels (otherwise the writer has lapped it, and it reads again).
+
+#if defined( PATHTRACER_MODE )
+
+#include "pathtracerApp.h"
+#include "scene.h"
+
+#include "external/lodepng/lodepng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if !defined( _WIN32 )
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+struct ProgressivePreview {
+
+    struct RingHeader {
+        char     magic[8];          // "PTPREV1"
+        uint32_t numSlots;
+        uint32_t slotCapacity;      // bytes of pixels per slot, for the full resolution
+        uint64_t latest;            // sequence of the newest snapshot, 0: none yet
+        uint32_t slotStride;        // bytes from one SlotHeader to the next
+        uint32_t reserved[9];
+    };
+
+    struct SlotHeader {
+        uint64_t sequence;          // 1, 2, ... - 0 while the slot is written
+        uint32_t width, height;
+        uint32_t samples;           // samples per pixel in the snapshot
+        uint32_t targetSamples;     // samples per pixel of the finished image
+        uint32_t level;             // downscale factor, 1 at the full resolution
+        uint32_t generation;        // counts the setScene() calls, a viewer can drop older snapshots
+        double   elapsedMs;         // since the start of this generation
+        uint32_t reserved[6];
+    };
+
+    ProgressivePreview( const uint32_t resx, const uint32_t resy, const int32_t spp ) : app( resx, resy, spp ), resx( resx ), resy( resy ), spp( spp ) {
+        // the snapshots are read as RGBA8, straight from the packed image
+        app.setReadbackFormat( PathtracerApp::eReadbackRGBA8 );
+        scene = Scene::makeCornellBox();
+    }
+
+    ~ProgressivePreview() {
+        closeSharedMemoryRing();
+    }
+
+    // The following setters must be called before run().
+
+    void setFirstDownscale( const uint32_t downscale ) { firstDownscale = std::max( downscale, 1u ); }
+    void setBatchTargetMs( const double ms ) { batchTargetMs = ms; }
+    void setPngOutput( const std::string& filename, const double intervalMs ) {
+        pngFilename = filename;
+        pngIntervalMs = intervalMs;
+    }
+
+    // creates (or replaces) the shared-memory object name with numSlots snapshots of the full resolution
+    void setSharedMemoryRing( const std::string& name, const uint32_t numSlots = 3 ) {
+    #if defined( _WIN32 )
+        (void)name; (void)numSlots;
+        throw std::runtime_error( "the shared-memory ring needs POSIX shared memory, use setPngOutput()" );
+    #else
+        closeSharedMemoryRing();
+        const uint32_t slotCapacity = resx * resy * 4;
+        const uint32_t slotStride = static_cast<uint32_t>( ( sizeof( SlotHeader ) + slotCapacity + 63 ) / 64 * 64 );
+        shmSize = sizeof( RingHeader ) + static_cast<size_t>( numSlots ) * slotStride;
+        shm_unlink( name.c_str() );
+        const int fd = shm_open( name.c_str(), O_CREAT | O_RDWR, 0600 );
+        if ( fd < 0 ) { throw std::runtime_error( "could not create the shared memory " + name ); }
+        void* mapped = ftruncate( fd, static_cast<off_t>( shmSize ) ) == 0 ? mmap( NULL, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+        close( fd );
+        if ( mapped == MAP_FAILED ) {
+            shm_unlink( name.c_str() );
+            throw std::runtime_error( "could not map the shared memory " + name );
+        }
+        shmName = name;
+        shm = static_cast<uint8_t*>( mapped );
+        RingHeader* ring = reinterpret_cast<RingHeader*>( shm );
+        memset( ring, 0, sizeof( RingHeader ) );
+        ring->numSlots = numSlots;
+        ring->slotCapacity = slotCapacity;
+        ring->slotStride = slotStride;
+        memcpy( ring->magic, "PTPREV1", 8 );
+        printf( "preview snapshots in the shared memory %s, %u slots\n", name.c_str(), numSlots );
+    #endif
+    }
+
+    // Thread-safe: the preview starts over with this scene after the batch in flight.
+    void setScene( const Scene& scene ) {
+        std::lock_guard<std::mutex> lock( mutex );
+        pendingScene.reset( new Scene( scene ) );
+        condition.notify_all();
+    }
+    // the scene of the preview - setScene() makes a copy of it, e.g. to move the camera
+    Scene getScene() {
+        std::lock_guard<std::mutex> lock( mutex );
+        return pendingScene ? *pendingScene : scene;
+    }
+
+    // Thread-safe: run() returns after the batch in flight.
+    void stop() {
+        std::lock_guard<std::mutex> lock( mutex );
+        stopRequested = true;
+        condition.notify_all();
+    }
+    // Thread-safe: with keepAlive, run() waits for the next setScene() once the image is finished, otherwise it returns.
+    void setKeepAlive( const bool enabled ) {
+        std::lock_guard<std::mutex> lock( mutex );
+        keepAlive = enabled;
+        condition.notify_all();
+    }
+
+    // Renders until the image has spp samples per pixel (and, with keepAlive, again after every setScene()), or until stop().
+    int run() {
+        app.init();
+        app.preRun();
+        app.prepare();
+        std::shared_ptr<Scene> firstScene;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            firstScene.swap( pendingScene );
+        }
+        restart( firstScene ? *firstScene : scene );
+
+        for ( ;; ) {
+            std::shared_ptr<Scene> newScene;
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                // the image is finished: wait for a change
+                while ( finished && keepAlive && !stopRequested && !pendingScene ) { condition.wait( lock ); }
+                if ( stopRequested || ( finished && !pendingScene ) ) { break; }
+                newScene.swap( pendingScene );
+            }
+            if ( newScene ) {
+                printf( "scene changed, restarting the preview\n" );
+                restart( *newScene );
+            }
+            step();
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // ms from the start of the last generation to its first snapshot
+    double getTimeToFirstImageMs() const { return timeToFirstImageMs; }
+    uint64_t getNumSnapshots() const { return sequence; }
+
+private:
+    void restart( const Scene& newScene ) {
+        {
+            std::lock_guard<std::mutex> lock( mutex ); // read by getScene()
+            scene = newScene;
+        }
+        app.setScene( newScene );
+        app.resize( resx, resy, spp );
+        generation++;
+        downscale = firstDownscale;
+        samplesDone = 0;
+        finished = false;
+        timeToFirstImageMs = -1.0;
+        msPerSamplePerPixel = 0.0;
+        generationStart = std::chrono::high_resolution_clock::now();
+    }
+
+    // renders the next level or batch, and writes its snapshot
+    void step() {
+        if ( downscale > 1 ) {
+            // a small frame of its own, with 1, 2, 4, ... samples per pixel
+            const uint32_t w = std::max( resx / downscale, 1u ), h = std::max( resy / downscale, 1u );
+            const int32_t levelSpp = std::min( spp, static_cast<int32_t>( std::max( firstDownscale / downscale, 1u ) ) );
+            app.resize( w, h, levelSpp );
+            app.rerun();
+            msPerSamplePerPixel = app.getLastSubmitMs() / ( static_cast<double>( w ) * h * levelSpp );
+            snapshot( w, h, levelSpp, downscale );
+            downscale /= 2;
+            if ( downscale <= 1 ) {
+                app.resize( resx, resy, spp );
+            }
+            return;
+        }
+
+        // the next batch of samples at the full resolution, sized from the time per sample so far
+        int32_t batch = 1;
+        if ( msPerSamplePerPixel > 0.0 ) {
+            batch = static_cast<int32_t>( batchTargetMs / ( msPerSamplePerPixel * resx * resy ) );
+        }
+        batch = std::max( 1, std::min( batch, spp - samplesDone ) );
+        const int32_t endSample = samplesDone + batch;
+        app.setSampleRange( samplesDone, endSample, samplesDone == 0, endSample == spp );
+        app.rerun();
+        msPerSamplePerPixel = app.getLastSubmitMs() / ( static_cast<double>( resx ) * resy * batch );
+        samplesDone = endSample;
+        finished = samplesDone >= spp;
+        snapshot( resx, resy, samplesDone, 1 );
+    }
+
+    void snapshot( const uint32_t w, const uint32_t h, const int32_t samples, const uint32_t level ) {
+        {
+            // a newer scene is waiting, this snapshot is outdated already
+            std::lock_guard<std::mutex> lock( mutex );
+            if ( pendingScene ) { return; }
+        }
+        const double elapsedMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - generationStart ).count();
+        sequence++;
+        if ( shm != NULL ) { writeSlot( w, h, samples, level, elapsedMs ); }
+
+        const bool pngDue = !pngFilename.empty() &&
+            ( finished || std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - lastPngTime ).count() >= pngIntervalMs );
+        if ( pngDue ) { writePng(); }
+
+        if ( timeToFirstImageMs < 0.0 ) { timeToFirstImageMs = elapsedMs; }
+        printf( "preview %ux%u, %d / %d spp, %.1f ms%s\n", w, h, samples, spp, elapsedMs, finished ? ", done" : "" );
+    }
+
+    // one slot of the ring, see the layout at the top
+    void writeSlot( const uint32_t w, const uint32_t h, const int32_t samples, const uint32_t level, const double elapsedMs ) {
+        RingHeader* ring = reinterpret_cast<RingHeader*>( shm );
+        uint8_t* slot = shm + sizeof( RingHeader ) + ( sequence % ring->numSlots ) * ring->slotStride;
+        volatile SlotHeader* header = reinterpret_cast<volatile SlotHeader*>( slot );
+        header->sequence = 0;
+        std::atomic_thread_fence( std::memory_order_release );
+        header->width = w;
+        header->height = h;
+        header->samples = static_cast<uint32_t>( samples );
+        header->targetSamples = static_cast<uint32_t>( spp );
+        header->level = level;
+        header->generation = generation;
+        header->elapsedMs = elapsedMs;
+        app.getRenderedImageRGBA8( slot + sizeof( SlotHeader ) );
+        std::atomic_thread_fence( std::memory_order_release );
+        header->sequence = sequence;
+        std::atomic_thread_fence( std::memory_order_release );
+        reinterpret_cast<volatile RingHeader*>( ring )->latest = sequence;
+    }
+
+    // written under another name and renamed, so that a viewer never sees a partial file
+    void writePng() {
+        const std::string tmpFilename = pngFilename + ".tmp";
+        app.saveRenderedImage( tmpFilename.c_str() );
+        remove( pngFilename.c_str() ); // rename() does not replace files on Windows
+        if ( rename( tmpFilename.c_str(), pngFilename.c_str() ) != 0 ) { printf( "could not write %s\n", pngFilename.c_str() ); }
+        lastPngTime = std::chrono::high_resolution_clock::now();
+    }
+
+    void closeSharedMemoryRing() {
+    #if !defined( _WIN32 )
+        if ( shm == NULL ) { return; }
+        munmap( shm, shmSize );
+        shm_unlink( shmName.c_str() );
+        shm = NULL;
+    #endif
+    }
+
+    PathtracerApp app;
+    const uint32_t resx, resy;
+    const int32_t spp;
+
+    uint32_t firstDownscale = 8;
+    double batchTargetMs = 50.0;
+    std::string pngFilename;
+    double pngIntervalMs = 1000.0;
+    std::chrono::high_resolution_clock::time_point lastPngTime;
+
+    std::string shmName;
+    uint8_t* shm = NULL;
+    size_t shmSize = 0;
+    uint64_t sequence = 0;  // of the last snapshot
+
+    // shared with setScene() / stop() / setKeepAlive()
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::shared_ptr<Scene> pendingScene;
+    bool stopRequested = false;
+    bool keepAlive = false;
+
+    Scene scene;    // of the current generation
+
+    // the current generation, only used by the thread in run()
+    uint32_t generation = 0;
+    uint32_t downscale = 1;         // of the next level, 1: the full resolution
+    int32_t samplesDone = 0;        // at the full resolution
+    bool finished = false;
+    double msPerSamplePerPixel = 0.0;
+    double timeToFirstImageMs = -1.0;
+    std::chrono::high_resolution_clock::time_point generationStart;
+};
+
+#endif // PATHTRACER_MODE
+
+#endif // _PROGRESSIVEPREVIEW_H_
@@ -0,0 +1,426 @@
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Scene description for the path tracer. Kept in double precision on the host, since the
+// large-sphere-walls test scene already loses precision when its coordinates are stored as float.
+// The records are converted to float when they are uploaded (see PathtracerApp::preRun()).
+struct Scene {
+
+    // both record types consist of 12 values, matching the Plane struct in pathTracer.comp
+    static constexpr int recordSize = 12;
+    // with SCENE_LAYOUT_AOS every sphere carries an additional local frame, see toGpuSpheres()
+    static constexpr int gpuSphereRecordSize = recordSize + 4;
+
+    std::vector<double> planes;  // normal.xyz, distToOrigin  |  emmission.xyz, 0  |  color.rgb, refltype
+    std::vector<double> spheres; // center.xyz, radius  |  emmission.xyz, 0  |  color.rgb, refltype
+
+    // # Instancing
+    // A prototype is a group of spheres (records like spheres[]) in its own object space, stored once. An instance
+    // places a prototype in the scene with a similarity transform - rotation, uniform scale, translation - so that
+    // its spheres stay spheres, and can replace the materials of all its spheres by one of instanceMaterials.
+    // intersect() transforms the ray into the object space of every instance whose bounding sphere it hits, so
+    // repeated geometry costs 32 bytes per instance on the GPU instead of the records of all its spheres.
+    struct Prototype {
+        uint32_t firstSphere, numSpheres;   // in prototypeSpheres
+    };
+    struct Instance {
+        double   translation[3];
+        double   scale;
+        double   rotation[4];               // unit quaternion x, y, z, w
+        uint32_t prototype;
+        int32_t  material;                  // in instanceMaterials, or noMaterialOverride
+    };
+    static constexpr int32_t noMaterialOverride = -1;
+    // the GPU record stores both indices in 16 bits, 0xFFFF is no override
+    static constexpr uint32_t maxInstanceIndex = 0xFFFE;
+
+    std::vector<double> prototypeSpheres;   // center.xyz, radius  |  emmission.xyz, 0  |  color.rgb, refltype - in object space
+    std::vector<Prototype> prototypes;
+    std::vector<Instance> instances;
+    std::vector<double> instanceMaterials;  // emmission.xyz, 0  |  color.rgb, refltype
+
+    // camera position, the viewing direction is fixed in pathTracer.comp
+    double camera[3] = { 0.0, 0.52, 7.4 };
+
+    const char* name = "";
+
+    size_t numPlanes() const { return planes.size() / recordSize; }
+    size_t numSpheres() const { return spheres.size() / recordSize; }
+    size_t numPrototypeSpheres() const { return prototypeSpheres.size() / recordSize; }
+    size_t numInstanceMaterials() const { return instanceMaterials.size() / 8; }
+
+    // spheres of all instances, as if they were expanded
+    size_t numInstancedSpheres() const {
+        size_t count = 0;
+        for ( const Instance& instance : instances ) { count += prototypes[ instance.prototype ].numSpheres; }
+        return count;
+    }
+
+    // adds a prototype made of the given sphere records, returns its index
+    uint32_t addPrototype( const std::vector<double>& sphereRecords ) {
+        if ( prototypes.size() > maxInstanceIndex ) { throw std::runtime_error( "too many prototypes" ); }
+        Prototype prototype = { static_cast<uint32_t>( numPrototypeSpheres() ), static_cast<uint32_t>( sphereRecords.size() / recordSize ) };
+        prototypeSpheres.insert( prototypeSpheres.end(), sphereRecords.begin(), sphereRecords.end() );
+        prototypes.push_back( prototype );
+        return static_cast<uint32_t>( prototypes.size() - 1 );
+    }
+
+    // adds a material for instances (emmission.xyz, 0  |  color.rgb, refltype), returns its index
+    int32_t addInstanceMaterial( const double material[8] ) {
+        if ( numInstanceMaterials() > maxInstanceIndex ) { throw std::runtime_error( "too many instance materials" ); }
+        instanceMaterials.insert( instanceMaterials.end(), material, material + 8 );
+        return static_cast<int32_t>( numInstanceMaterials() - 1 );
+    }
+
+    // rotation: axis (normalized here) and angle in radians
+    void addInstance( const uint32_t prototype, const double translation[3], const double scale, const double axis[3], const double angle,
+                      const int32_t material = noMaterialOverride ) {
+        Instance instance;
+        const double axisLength = sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] );
+        const double sinHalf = axisLength > 0.0 ? sin( 0.5 * angle ) / axisLength : 0.0;
+        for ( int k = 0; k < 3; k++ ) {
+            instance.translation[k] = translation[k];
+            instance.rotation[k] = axis[k] * sinHalf;
+        }
+        instance.rotation[3] = axisLength > 0.0 ? cos( 0.5 * angle ) : 1.0;
+        instance.scale = scale;
+        instance.prototype = prototype;
+        instance.material = material;
+        instances.push_back( instance );
+    }
+
+    // rotates v by the unit quaternion q (x, y, z, w)
+    static void rotate( const double q[4], const double v[3], double result[3] ) {
+        // v + 2 * cross( q.xyz, cross( q.xyz, v ) + q.w * v )
+        const double c[3] = { q[1] * v[2] - q[2] * v[1] + q[3] * v[0], q[2] * v[0] - q[0] * v[2] + q[3] * v[1], q[0] * v[1] - q[1] * v[0] + q[3] * v[2] };
+        result[0] = v[0] + 2.0 * ( q[1] * c[2] - q[2] * c[1] );
+        result[1] = v[1] + 2.0 * ( q[2] * c[0] - q[0] * c[2] );
+        result[2] = v[2] + 2.0 * ( q[0] * c[1] - q[1] * c[0] );
+    }
+
+    // the same scene with every instance expanded into spheres[] - the reference for the instanced render
+    Scene flattened() const {
+        Scene scene = *this;
+        scene.prototypeSpheres.clear();
+        scene.prototypes.clear();
+        scene.instances.clear();
+        scene.instanceMaterials.clear();
+        scene.spheres.reserve( spheres.size() + numInstancedSpheres() * recordSize );
+        for ( const Instance& instance : instances ) {
+            const Prototype& prototype = prototypes[ instance.prototype ];
+            for ( uint32_t i = 0; i < prototype.numSpheres; i++ ) {
+                const double* s = &prototypeSpheres[ ( prototype.firstSphere + i ) * recordSize ];
+                double record[recordSize];
+                std::copy( s, s + recordSize, record );
+                rotate( instance.rotation, s, record );
+                for ( int k = 0; k < 3; k++ ) { record[k] = instance.translation[k] + instance.scale * record[k]; }
+                record[3] = instance.scale * s[3];
+                if ( instance.material != noMaterialOverride ) {
+                    std::copy( &instanceMaterials[ instance.material * 8 ], &instanceMaterials[ instance.material * 8 + 8 ], record + 4 );
+                }
+                scene.spheres.insert( scene.spheres.end(), record, record + recordSize );
+            }
+        }
+        return scene;
+    }
+
+    static std::vector<float> toFloat( const std::vector<double>& records ) {
+        return std::vector<float>( records.begin(), records.end() );
+    }
+
+    // moves all geometry and the camera by offset
+    Scene translated( const double offset[3] ) const {
+        Scene scene = *this;
+        for ( size_t i = 0; i < scene.numPlanes(); i++ ) {
+            double* p = &scene.planes[ i * recordSize ];
+            p[3] += p[0] * offset[0] + p[1] * offset[1] + p[2] * offset[2];
+        }
+        for ( size_t i = 0; i < scene.numSpheres(); i++ ) {
+            double* s = &scene.spheres[ i * recordSize ];
+            for ( int k = 0; k < 3; k++ ) { s[k] += offset[k]; }
+        }
+        for ( Instance& instance : scene.instances ) {
+            for ( int k = 0; k < 3; k++ ) { instance.translation[k] += offset[k]; }
+        }
+        for ( int k = 0; k < 3; k++ ) { scene.camera[k] += offset[k]; }
+        return scene;
+    }
+
+    // Moves the camera into the origin. Done in double precision before the conversion to float, so that
+    // the float coordinates are most precise where the rays start and no precision is wasted on a scene
+    // that is located far away from the origin.
+    Scene rebasedToCamera() const {
+        const double offset[3] = { -camera[0], -camera[1], -camera[2] };
+        return translated( offset );
+    }
+
+    // # GPU layout
+    // The intersection loops of pathTracer.comp only need the geometry of every object, the material only of the
+    // closest hit. So the records are split into structure-of-arrays buffers: plane equations and sphere
+    // centers / radii (16 bytes per object), the local frames of the spheres (only read for large spheres) and the
+    // materials of all objects (emission, color + type; planes first, then spheres). The old array-of-structures
+    // records are still available as a reference for the benchmark, see SCENE_LAYOUT_AOS in pathTracer.comp.
+
+    // normal.xyz, distToOrigin per plane
+    std::vector<float> toGpuPlaneGeometry() const { return geometryOf( planes ); }
+    // center.xyz, radius per sphere
+    std::vector<float> toGpuSphereGeometry() const { return geometryOf( spheres ); }
+
+    // Spheres with a radius or distance to the origin above maxLenForFloatCalc (e.g. the 1e5 walls) get a local
+    // frame ( n.xyz, h ) if localFrames is set: n is the unit vector from the center towards the origin and h the
+    // signed distance of the origin to the surface (negative inside). Both are small numbers that survive the
+    // conversion to float, unlike the difference of center and radius - intersect() uses them to stay on the float
+    // path. Other spheres get a zero frame.
+    std::vector<float> toGpuSphereFrames( const double maxLenForFloatCalc, const bool localFrames ) const {
+        std::vector<float> frames;
+        frames.reserve( numSpheres() * 4 );
+        for ( size_t i = 0; i < numSpheres(); i++ ) {
+            double frame[4];
+            localFrame( &spheres[ i * recordSize ], maxLenForFloatCalc, localFrames, frame );
+            frames.insert( frames.end(), frame, frame + 4 );
+        }
+        return frames;
+    }
+
+    // emmission.xyz, 0  |  color.rgb, refltype - of the planes, followed by the spheres and toGpuInstancedMaterials()
+    std::vector<float> toGpuMaterials() const {
+        std::vector<float> materials;
+        materials.reserve( ( numPlanes() + numSpheres() ) * 8 );
+        for ( size_t i = 0; i < numPlanes(); i++ ) {
+            materials.insert( materials.end(), &planes[ i * recordSize + 4 ], &planes[ i * recordSize + recordSize ] );
+        }
+        for ( size_t i = 0; i < numSpheres(); i++ ) {
+            materials.insert( materials.end(), &spheres[ i * recordSize + 4 ], &spheres[ i * recordSize + recordSize ] );
+        }
+        const std::vector<float> instancedMaterials = toGpuInstancedMaterials();
+        materials.insert( materials.end(), instancedMaterials.begin(), instancedMaterials.end() );
+        return materials;
+    }
+
+    // the materials of the prototype spheres, followed by instanceMaterials
+    std::vector<float> toGpuInstancedMaterials() const {
+        std::vector<float> materials;
+        materials.reserve( ( numPrototypeSpheres() + numInstanceMaterials() ) * 8 );
+        for ( size_t i = 0; i < numPrototypeSpheres(); i++ ) {
+            materials.insert( materials.end(), &prototypeSpheres[ i * recordSize + 4 ], &prototypeSpheres[ i * recordSize + recordSize ] );
+        }
+        materials.insert( materials.end(), instanceMaterials.begin(), instanceMaterials.end() );
+        return materials;
+    }
+
+    // center.xyz, radius per prototype sphere, in object space
+    std::vector<float> toGpuPrototypeSpheres() const { return geometryOf( prototypeSpheres ); }
+
+    // per prototype: bounding sphere ( center.xyz, radius in object space ) | first sphere, number of spheres, 0, 0 (uint)
+    std::vector<float> toGpuPrototypes() const {
+        std::vector<float> gpuPrototypes;
+        gpuPrototypes.reserve( prototypes.size() * 8 );
+        for ( const Prototype& prototype : prototypes ) {
+            // centered at the mean of the centers - not the smallest, but a tight enough bound for clusters
+            double center[3] = { 0.0, 0.0, 0.0 }, radius = 0.0;
+            for ( uint32_t i = 0; i < prototype.numSpheres; i++ ) {
+                for ( int k = 0; k < 3; k++ ) { center[k] += prototypeSpheres[ ( prototype.firstSphere + i ) * recordSize + k ] / prototype.numSpheres; }
+            }
+            for ( uint32_t i = 0; i < prototype.numSpheres; i++ ) {
+                const double* s = &prototypeSpheres[ ( prototype.firstSphere + i ) * recordSize ];
+                const double dist = sqrt( ( s[0] - center[0] ) * ( s[0] - center[0] ) + ( s[1] - center[1] ) * ( s[1] - center[1] ) + ( s[2] - center[2] ) * ( s[2] - center[2] ) );
+                radius = std::max( radius, dist + s[3] );
+            }
+            const float record[8] = { static_cast<float>( center[0] ), static_cast<float>( center[1] ), static_cast<float>( center[2] ),
+                                      static_cast<float>( radius * ( 1.0 + 1e-5 ) ), // covers the rounding to float
+                                      asFloat( prototype.firstSphere ), asFloat( prototype.numSpheres ), 0.0f, 0.0f };
+            gpuPrototypes.insert( gpuPrototypes.end(), record, record + 8 );
+        }
+        return gpuPrototypes;
+    }
+
+    // A header ( number of instances, 0, 0, 0 as uint ) followed by 8 floats per instance: translation.xyz, scale |
+    // rotation.xyz, prototype | material override << 16 (uint). The rotation is stored with w >= 0, so that
+    // pathTracer.comp can restore w from the length of xyz.
+    std::vector<float> toGpuInstances() const {
+        std::vector<float> gpuInstances;
+        gpuInstances.reserve( 4 + instances.size() * 8 );
+        const float header[4] = { asFloat( static_cast<uint32_t>( instances.size() ) ), 0.0f, 0.0f, 0.0f };
+        gpuInstances.insert( gpuInstances.end(), header, header + 4 );
+        for ( const Instance& instance : instances ) {
+            const double sign = instance.rotation[3] < 0.0 ? -1.0 : 1.0;
+            const uint32_t material = instance.material == noMaterialOverride ? 0xFFFFu : static_cast<uint32_t>( instance.material );
+            const float record[8] = {
+                static_cast<float>( instance.translation[0] ), static_cast<float>( instance.translation[1] ), static_cast<float>( instance.translation[2] ),
+                static_cast<float>( instance.scale ),
+                static_cast<float>( sign * instance.rotation[0] ), static_cast<float>( sign * instance.rotation[1] ), static_cast<float>( sign * instance.rotation[2] ),
+                asFloat( instance.prototype | ( material << 16 ) )
+            };
+            gpuInstances.insert( gpuInstances.end(), record, record + 8 );
+        }
+        return gpuInstances;
+    }
+
+    // Converts the spheres to the Sphere struct of pathTracer.comp with SCENE_LAYOUT_AOS: the record followed by
+    // the local frame (see toGpuSphereFrames()).
+    std::vector<float> toGpuSpheres( const double maxLenForFloatCalc, const bool localFrames ) const {
+        std::vector<float> gpuSpheres;
+        gpuSpheres.reserve( numSpheres() * gpuSphereRecordSize );
+        for ( size_t i = 0; i < numSpheres(); i++ ) {
+            const double* s = &spheres[ i * recordSize ];
+            gpuSpheres.insert( gpuSpheres.end(), s, s + recordSize );
+            double frame[4];
+            localFrame( s, maxLenForFloatCalc, localFrames, frame );
+            gpuSpheres.insert( gpuSpheres.end(), frame, frame + 4 );
+        }
+        return gpuSpheres;
+    }
+
+    // Cornell-box like room made of planes
+    static Scene makeCornellBox() {
+        Scene scene;
+        scene.name = "cornell-box";
+        scene.planes = {
+            -1.0,  +0.0,  +0.0,  +2.6,      0, 0, 0, 0,     .85, .25, .25,  1, // Left
+            +1.0,  +0.0,  +0.0,  +2.6,      0, 0, 0, 0,     .25, .35, .85,  1, // Right
+            +0.0,  +1.0,  +0.0,  +2.0,      0, 0, 0, 0,     .75, .75, .75,  1, // Top
+            +0.0,  -1.0,  +0.0,  +2.0,      0, 0, 0, 0,     .75, .75, .75,  1, // Bottom
+            +0.0,  +0.0,  -1.0,  +2.8,      0, 0, 0, 0,     .85, .85, .25,  1, // Back
+            +0.0,  +0.0,  +1.0,  +7.9,      0, 0, 0, 0,     0.1, 0.7, 0.7,  1, // Front
+        };
+        scene.spheres = commonSpheres();
+        return scene;
+    }
+
+    // same room, but the walls are huge spheres (smallpt style) - the test scene for the emulated-precision code paths
+    static Scene makeLargeSphereWalls() {
+        Scene scene;
+        scene.name = "large-sphere-walls";
+        scene.planes = { // must have at least one plane here
+            1,0,0,1000,    0,0,0,0,     1,1,1,1, // can't allocate buffers of size 0 => insert one zero dummy plane
+        };
+        scene.spheres = {
+            1e5 - 2.6, 0, 0, 1e5,   0, 0, 0, 0,  .85, .25, .25,  1, // Left (DIFFUSE)
+            1e5 + 2.6, 0, 0, 1e5,   0, 0, 0, 0,  .25, .35, .85,  1, // Right
+            0, 1e5 + 2, 0, 1e5,     0, 0, 0, 0,  .75, .75, .75,  1, // Top
+            0,-1e5 - 2, 0, 1e5,     0, 0, 0, 0,  .75, .75, .75,  1, // Bottom
+            0, 0, -1e5 - 2.8, 1e5,  0, 0, 0, 0,  .85, .85, .25,  1, // Back
+            0, 0, 1e5 + 7.9, 1e5,   0, 0, 0, 0,  0.1, 0.7, 0.7,  1, // Front
+        };
+        const std::vector<double> spheres = commonSpheres();
+        scene.spheres.insert( scene.spheres.end(), spheres.begin(), spheres.end() );
+        return scene;
+    }
+
+    // the Cornell box filled with a grid of count small spheres - the benchmark scene for the scene layout, where
+    // the intersection loops dominate (see benchmark::runSceneLayout())
+    static Scene makeSphereField( const size_t count ) {
+        Scene scene = makeCornellBox();
+        scene.name = "sphere-field";
+        scene.spheres = { 0, 2*0.8, 0, 0.2,  100,100,100,0,  0, 0, 0,  1 }; // Light
+        const size_t n = std::max<size_t>( 1, static_cast<size_t>( ceil( cbrt( static_cast<double>( count ) ) ) ) );
+        const double lo[3] = { -2.3, -1.8, -2.5 }, hi[3] = { 2.3, 1.2, 1.5 };
+        const double spacing = std::min( ( hi[0] - lo[0] ), std::min( hi[1] - lo[1], hi[2] - lo[2] ) ) / n;
+        for ( size_t i = 0; i < count; i++ ) {
+            const size_t cell[3] = { i % n, ( i / n ) % n, i / ( n * n ) };
+            double center[3];
+            for ( int k = 0; k < 3; k++ ) { center[k] = lo[k] + ( hi[k] - lo[k] ) * ( cell[k] + 0.5 ) / n; }
+            // mostly diffuse, with a few mirrors and glass spheres in between
+            const double type = ( i % 13 == 0 ) ? 2 : ( ( i % 17 == 0 ) ? 3 : 1 );
+            const double record[recordSize] = {
+                center[0], center[1], center[2], 0.35 * spacing,
+                0, 0, 0, 0,
+                0.2 + 0.7 * ( ( i * 37 ) % 11 ) / 10.0, 0.2 + 0.7 * ( ( i * 53 ) % 7 ) / 6.0, 0.2 + 0.7 * ( ( i * 71 ) % 5 ) / 4.0, type
+            };
+            scene.spheres.insert( scene.spheres.end(), record, record + recordSize );
+        }
+        return scene;
+    }
+
+    // The Cornell box with numInstances copies of a cluster of spheresPerPrototype small spheres, each instance
+    // rotated, scaled and some with a material override - the benchmark scene for instancing (see
+    // benchmark::runInstancing()). A few prototypes are shared by all instances.
+    static Scene makeInstancedField( const size_t numInstances, const size_t spheresPerPrototype, const size_t numPrototypes = 4 ) {
+        Scene scene = makeCornellBox();
+        scene.name = "instanced-field";
+        scene.spheres = { 0, 2*0.8, 0, 0.2,  100,100,100,0,  0, 0, 0,  1 }; // Light
+
+        // the spheres of a prototype on a spiral through the unit ball
+        const double pi = 3.141592653589793;
+        for ( size_t p = 0; p < numPrototypes; p++ ) {
+            std::vector<double> records;
+            const double radius = 0.6 / cbrt( static_cast<double>( std::max<size_t>( spheresPerPrototype, 1 ) ) );
+            for ( size_t i = 0; i < spheresPerPrototype; i++ ) {
+                const double u = ( i + 0.5 ) / spheresPerPrototype;
+                const double r = ( 1.0 - radius ) * cbrt( u ), phi = i * ( 2.399963 + 0.1 * p ), z = 1.0 - 2.0 * fmod( i * 0.618034, 1.0 );
+                const double rho = sqrt( std::max( 0.0, 1.0 - z * z ) );
+                const double record[recordSize] = {
+                    r * rho * cos( phi ), r * rho * sin( phi ), r * z, radius,
+                    0, 0, 0, 0,
+                    0.3 + 0.6 * ( ( i * 37 + p ) % 11 ) / 10.0, 0.3 + 0.6 * ( ( i * 53 ) % 7 ) / 6.0, 0.3 + 0.6 * ( ( i * 71 + 3 * p ) % 5 ) / 4.0,
+                    ( i % 29 == 0 ) ? 2.0 : 1.0
+                };
+                records.insert( records.end(), record, record + recordSize );
+            }
+            scene.addPrototype( records );
+        }
+        const double mirror[8] = { 0, 0, 0, 0,  .999, .999, .999, 2 };
+        const double gold[8] = { 0, 0, 0, 0,  .9, .7, .2, 1 };
+        const int32_t materials[2] = { scene.addInstanceMaterial( mirror ), scene.addInstanceMaterial( gold ) };
+
+        const size_t n = std::max<size_t>( 1, static_cast<size_t>( ceil( cbrt( static_cast<double>( numInstances ) ) ) ) );
+        const double lo[3] = { -2.2, -1.7, -2.4 }, hi[3] = { 2.2, 1.1, 1.4 };
+        const double spacing = std::min( hi[0] - lo[0], std::min( hi[1] - lo[1], hi[2] - lo[2] ) ) / n;
+        for ( size_t i = 0; i < numInstances; i++ ) {
+            const size_t cell[3] = { i % n, ( i / n ) % n, i / ( n * n ) };
+            double translation[3];
+            for ( int k = 0; k < 3; k++ ) { translation[k] = lo[k] + ( hi[k] - lo[k] ) * ( cell[k] + 0.5 ) / n; }
+            const double axis[3] = { sin( i * 1.3 ), cos( i * 0.7 ), sin( i * 2.1 + 0.5 ) };
+            const int32_t material = ( i % 7 == 3 ) ? materials[0] : ( ( i % 11 == 5 ) ? materials[1] : noMaterialOverride );
+            scene.addInstance( static_cast<uint32_t>( i % numPrototypes ), translation, 0.45 * spacing * ( 0.8 + 0.2 * ( ( i * 13 ) % 5 ) / 4.0 ),
+                               axis, fmod( i * 0.9, 2.0 * pi ), material );
+        }
+        return scene;
+    }
+
+private:
+    static float asFloat( const uint32_t bits ) {
+        float value;
+        memcpy( &value, &bits, sizeof( value ) );
+        return value;
+    }
+
+    // the first 4 values of every record
+    static std::vector<float> geometryOf( const std::vector<double>& records ) {
+        std::vector<float> geometry;
+        geometry.reserve( records.size() / recordSize * 4 );
+        for ( size_t i = 0; i < records.size(); i += recordSize ) {
+            geometry.insert( geometry.end(), &records[i], &records[ i + 4 ] );
+        }
+        return geometry;
+    }
+
+    static void localFrame( const double* s, const double maxLenForFloatCalc, const bool localFrames, double frame[4] ) {
+        frame[0] = frame[1] = frame[2] = frame[3] = 0.0;
+        const double centerDist = sqrt( s[0] * s[0] + s[1] * s[1] + s[2] * s[2] );
+        if ( localFrames && centerDist > 0.0 && ( s[3] > maxLenForFloatCalc || centerDist > maxLenForFloatCalc ) ) {
+            frame[0] = -s[0] / centerDist;
+            frame[1] = -s[1] / centerDist;
+            frame[2] = -s[2] / centerDist;
+            frame[3] = centerDist - s[3];
+        }
+    }
+
+    static std::vector<double> commonSpheres() {
+        return {
+            -1.3, -1.2, -1.3, 0.8,  0, 0, 0, 0,  .999,.999,.999, 2, // REFLECTIVE
+            1.3, -1.2, -0.2, 0.8,   0, 0, 0, 0,  .999,.999,.999, 3, // REFRACTIVE
+            0, 2*0.8, 0, 0.2,       100,100,100,0,  0, 0, 0,   1, // Light
+        };
+    }
+};
+
+#endif // _SCENE_H_
@@ -0,0 +1,245 @@
+#include "shaderCompiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <stdexcept>
+
+#if defined( USE_SHADERC )
+    #include <shaderc/shaderc.h>
+#endif
+
+namespace {
+
+    #if defined( USE_SHADERC )
+    static const char* compilerTag = "shaderc";
+    #else
+    static const char* compilerTag = "glslc";
+    #endif
+
+    // 64 bit FNV-1a, good enough to tell shader sources apart
+    static uint64_t hashFnv1a( const std::string& data, uint64_t hash = 14695981039346656037ull ) {
+        for ( const char c : data ) {
+            hash ^= static_cast<uint8_t>( c );
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static bool readFile( const std::string& filename, std::string& content ) {
+        FILE* fp = fopen( filename.c_str(), "rb" );
+        if ( fp == NULL ) { return false; }
+        fseek( fp, 0, SEEK_END );
+        const long filesize = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+        content.resize( filesize > 0 ? filesize : 0 );
+        const size_t numRead = filesize > 0 ? fread( &content[0], sizeof( char ), filesize, fp ) : 0;
+        fclose( fp );
+        return numRead == content.size();
+    }
+
+    static bool writeFile( const std::string& filename, const void* data, const size_t size ) {
+        FILE* fp = fopen( filename.c_str(), "wb" );
+        if ( fp == NULL ) { return false; }
+        const size_t numWritten = fwrite( data, 1, size, fp );
+        fclose( fp );
+        return numWritten == size;
+    }
+
+    static bool bytesToSpv( const std::string& bytes, std::vector<uint32_t>& spv ) {
+        if ( bytes.empty() || bytes.size() % 4 != 0 ) { return false; }
+        spv.resize( bytes.size() / 4 );
+        memcpy( spv.data(), bytes.data(), bytes.size() );
+        return spv[0] == 0x07230203u; // SPIR-V magic number
+    }
+
+    // one argument of the glslc command line for system(): in single quotes for sh, so that spaces and shell
+    // characters in a define or path stay part of it. cmd.exe only has double quotes, and cannot quote '"' or '%'.
+    static std::string shellArgument( const std::string& argument ) {
+    #if defined( _WIN32 )
+        if ( argument.find_first_of( "\"%\r\n" ) != std::string::npos ) {
+            throw std::runtime_error( "cannot pass " + argument + " to glslc" );
+        }
+        return "\"" + argument + "\"";
+    #else
+        std::string quoted = "'";
+        for ( const char c : argument ) {
+            if ( c == '\'' ) { quoted += "'\\''"; } // end the quotes, an escaped quote, quote again
+            else { quoted += c; }
+        }
+        return quoted + "'";
+    #endif
+    }
+
+    // matches   #include "name"   (the only form used by our shaders)
+    static bool parseInclude( const std::string& line, std::string& includeName ) {
+        size_t pos = line.find_first_not_of( " \t" );
+        if ( pos == std::string::npos || line[pos] != '#' ) { return false; }
+        pos = line.find_first_not_of( " \t", pos + 1 );
+        if ( pos == std::string::npos || line.compare( pos, 7, "include" ) != 0 ) { return false; }
+        const size_t begin = line.find( '"', pos + 7 );
+        const size_t end = ( begin == std::string::npos ) ? std::string::npos : line.find( '"', begin + 1 );
+        if ( end == std::string::npos ) { return false; }
+        includeName = line.substr( begin + 1, end - begin - 1 );
+        return true;
+    }
+
+    static std::string glslcPath() {
+        const char* sdk = getenv( "VULKAN_SDK" );
+        if ( sdk == NULL || sdk[0] == '\0' ) { return "glslc"; }
+        std::string path( sdk );
+        if ( path.back() != '/' && path.back() != '\\' ) { path += '/'; }
+        return path + "bin/glslc";
+    }
+
+} // namespace
+
+
+std::vector<uint32_t> ShaderCompiler::compile( const std::string& filename, const std::vector<std::string>& defines, const std::string& targetEnv ) {
+    sourceStrings.clear();
+    const std::string source = expandIncludes( filename, 0 );
+
+    uint64_t hash = hashFnv1a( source );
+    hash = hashFnv1a( compilerTag, hash );
+    for ( const std::string& define : defines ) { hash = hashFnv1a( "\n-D" + define, hash ); }
+    if ( !targetEnv.empty() ) { hash = hashFnv1a( "\n--target-env=" + targetEnv, hash ); }
+
+    char hashString[17];
+    snprintf( hashString, sizeof( hashString ), "%016llx", static_cast<unsigned long long>( hash ) );
+    const size_t extPos = filename.rfind( ".comp" );
+    const std::string spvCacheFilename = filename.substr( 0, extPos ) + "." + hashString + ".cache.spv";
+
+    std::string cached;
+    std::vector<uint32_t> spv;
+    if ( readFile( spvCacheFilename, cached ) && bytesToSpv( cached, spv ) ) {
+        printf( "using cached SPIR-V %s\n", spvCacheFilename.c_str() );
+        return spv;
+    }
+
+    printf( "compiling %s\n", filename.c_str() );
+    return compileExpanded( filename, source, defines, targetEnv, spvCacheFilename );
+}
+
+std::vector<uint32_t> ShaderCompiler::compileExpanded( const std::string& filename, const std::string& source,
+                                                       const std::vector<std::string>& defines, const std::string& targetEnv,
+                                                       const std::string& spvCacheFilename ) {
+    std::string errorMessage;
+    std::vector<uint32_t> spv;
+
+#if defined( USE_SHADERC )
+    shaderc_compiler_t compiler = shaderc_compiler_initialize();
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    for ( const std::string& define : defines ) {
+        const size_t eqPos = define.find( '=' );
+        const std::string name = define.substr( 0, eqPos );
+        const std::string value = ( eqPos == std::string::npos ) ? std::string() : define.substr( eqPos + 1 );
+        shaderc_compile_options_add_macro_definition( options, name.c_str(), name.size(), value.c_str(), value.size() );
+    }
+    if ( targetEnv == "vulkan1.1" ) { shaderc_compile_options_set_target_env( options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1 ); }
+    else if ( targetEnv == "vulkan1.2" ) { shaderc_compile_options_set_target_env( options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2 ); }
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(
+        compiler, source.c_str(), source.size(), shaderc_compute_shader, filename.c_str(), "main", options );
+    if ( shaderc_result_get_compilation_status( result ) == shaderc_compilation_status_success ) {
+        bytesToSpv( std::string( shaderc_result_get_bytes( result ), shaderc_result_get_length( result ) ), spv );
+    } else {
+        errorMessage = shaderc_result_get_error_message( result );
+    }
+    shaderc_result_release( result );
+    shaderc_compile_options_release( options );
+    shaderc_compiler_release( compiler );
+#else
+    // glslc prints its messages itself
+    const std::string expandedFilename = spvCacheFilename.substr( 0, spvCacheFilename.rfind( ".spv" ) ) + ".comp";
+    if ( !writeFile( expandedFilename, source.data(), source.size() ) ) {
+        throw std::runtime_error( "could not write " + expandedFilename );
+    }
+    std::string command = shellArgument( glslcPath() ) + " -fshader-stage=compute";
+    for ( const std::string& define : defines ) { command += " " + shellArgument( "-D" + define ); }
+    if ( !targetEnv.empty() ) { command += " " + shellArgument( "--target-env=" + targetEnv ); }
+    command += " " + shellArgument( expandedFilename ) + " -o " + shellArgument( spvCacheFilename );
+    const int status = system( command.c_str() );
+    remove( expandedFilename.c_str() );
+
+    std::string bytes;
+    if ( status != 0 || !readFile( spvCacheFilename, bytes ) || !bytesToSpv( bytes, spv ) ) {
+        errorMessage = "'" + command + "' failed";
+        spv.clear();
+    }
+#endif
+
+    if ( spv.empty() ) {
+        // the source-string number of the messages is the second number of the #line directives
+        for ( size_t i = 0; i < sourceStrings.size(); i++ ) {
+            errorMessage += "\n  source string " + std::to_string( i ) + ": " + sourceStrings[i];
+        }
+        throw std::runtime_error( "could not compile " + filename + ": " + errorMessage );
+    }
+
+#if defined( USE_SHADERC )
+    if ( !writeFile( spvCacheFilename, spv.data(), spv.size() * sizeof( uint32_t ) ) ) {
+        printf( "could not write SPIR-V cache %s\n", spvCacheFilename.c_str() );
+    }
+#endif
+    return spv;
+}
+
+std::string ShaderCompiler::expandIncludes( const std::string& filename, const int depth ) {
+    if ( depth > 16 ) {
+        throw std::runtime_error( "#include nesting too deep (recursive include?) at " + filename );
+    }
+
+    std::string text;
+    if ( !readFile( filename, text ) ) {
+        throw std::runtime_error( "could not find or open shader source: " + filename );
+    }
+    watchedFiles[ filename ] = getFileStamp( filename );
+
+    const size_t sourceString = sourceStrings.size();
+    sourceStrings.push_back( filename );
+    const std::string directory = filename.substr( 0, filename.find_last_of( "/\\" ) + 1 );
+
+    std::string expanded;
+    size_t lineNumber = 0;
+    size_t pos = 0;
+    while ( pos < text.size() ) {
+        size_t end = text.find( '\n', pos );
+        if ( end == std::string::npos ) { end = text.size(); }
+        std::string line = text.substr( pos, end - pos );
+        if ( !line.empty() && line.back() == '\r' ) { line.pop_back(); }
+        pos = end + 1;
+        lineNumber++;
+
+        std::string includeName;
+        if ( parseInclude( line, includeName ) ) {
+            // #line keeps the compiler messages pointing at the original files (see sourceStrings)
+            expanded += "#line 1 " + std::to_string( sourceStrings.size() ) + "\n";
+            expanded += expandIncludes( directory + includeName, depth + 1 );
+            expanded += "#line " + std::to_string( lineNumber + 1 ) + " " + std::to_string( sourceString ) + "\n";
+        } else {
+            expanded += line;
+            expanded += '\n';
+        }
+    }
+    return expanded;
+}
+
+ShaderCompiler::FileStamp ShaderCompiler::getFileStamp( const std::string& filename ) {
+    struct stat fileStat;
+    if ( stat( filename.c_str(), &fileStat ) != 0 ) { return FileStamp{ 0, -1 }; }
+    return FileStamp{ fileStat.st_mtime, static_cast<long>( fileStat.st_size ) };
+}
+
+bool ShaderCompiler::sourcesChanged() const {
+    for ( const auto& watched : watchedFiles ) {
+        if ( getFileStamp( watched.first ) != watched.second ) { return true; }
+    }
+    return false;
+}
+
+void ShaderCompiler::markSourcesSeen() {
+    for ( auto& watched : watchedFiles ) {
+        watched.second = getFileStamp( watched.first );
+    }
+}
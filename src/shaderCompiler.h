@@ -0,0 +1,53 @@
+#ifndef _SHADERCOMPILER_H_
+#define _SHADERCOMPILER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Compiles GLSL compute shaders to SPIR-V at runtime, so that shaders can be changed without a make cycle
+// and a process restart (see VulkanComputeApp::setCompileShadersAtRuntime()).
+//
+// #include "..." directives are resolved here (relative to the including file), the expanded source is then
+// compiled either in-process with libshaderc (build with -DUSE_SHADERC and link shaderc_combined), or by
+// running glslc from $VULKAN_SDK/bin or the PATH.
+// The resulting SPIR-V is cached next to the shader as <name>.<hash>.cache.spv, where the hash is taken over
+// the expanded source and the defines - an unchanged shader is not compiled again, even across runs.
+struct ShaderCompiler {
+
+    // defines are given as "NAME" or "NAME=VALUE", like -D on the glslc command line, targetEnv like --target-env
+    // of glslc ("vulkan1.1" e.g. for subgroup operations, which need SPIR-V 1.3), empty for the default Vulkan 1.0
+    std::vector<uint32_t> compile( const std::string& filename, const std::vector<std::string>& defines, const std::string& targetEnv = std::string() );
+
+    // true, if one of the files that went into compile() was modified since it was read
+    bool sourcesChanged() const;
+
+    // treat the current state of all files as seen, so that a failing compile() does not trigger again and again
+    void markSourcesSeen();
+
+private:
+    // reads filename and recursively replaces its #include "..." directives by the file contents
+    std::string expandIncludes( const std::string& filename, const int depth );
+
+    std::vector<uint32_t> compileExpanded( const std::string& filename, const std::string& source,
+                                           const std::vector<std::string>& defines, const std::string& targetEnv,
+                                           const std::string& spvCacheFilename );
+
+    struct FileStamp {
+        time_t mtime;
+        long   size;
+        bool operator!=( const FileStamp& b ) const { return mtime != b.mtime || size != b.size; }
+    };
+    static FileStamp getFileStamp( const std::string& filename );
+
+    // every file read by compile(), with its state at that time
+    std::map<std::string, FileStamp> watchedFiles;
+
+    // maps #line source-string numbers back to files for the compiler messages
+    std::vector<std::string> sourceStrings;
+};
+
+#endif // _SHADERCOMPILER_H_
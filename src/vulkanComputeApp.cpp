@@ -1,9 +1,14 @@
 #include "vulkanComputeApp.h"
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <stdexcept>
+#include <string>
+#include <chrono>
 
 namespace {
 
@@ -35,13 +40,17 @@ namespace {
 
         FILE* fp = fopen(filename, "rb");
         if (fp == NULL) {
-            printf("Could not find or open file: %s\n", filename);
+            throw std::runtime_error( std::string( "could not find or open file: " ) + filename );
         }
 
         // get file size.
         fseek(fp, 0, SEEK_END);
         long filesize = ftell(fp);
         fseek(fp, 0, SEEK_SET);
+        if (filesize <= 0) {
+            fclose(fp);
+            throw std::runtime_error( std::string( "empty or unreadable file: " ) + filename );
+        }
 
         long filesizepadded = long(ceil(filesize / 4.0)) * 4;
 
@@ -49,8 +58,11 @@ namespace {
         content.resize( filesizepadded / 4 );
         
         char *str = reinterpret_cast<char*>( content.data() );
-        fread(str, filesize, sizeof(char), fp);
+        const size_t numRead = fread(str, sizeof(char), filesize, fp);
         fclose(fp);
+        if (numRead != static_cast<size_t>(filesize)) {
+            throw std::runtime_error( std::string( "could not read file: " ) + filename );
+        }
 
         printf( "read and closed file '%s'\n", filename );
 
@@ -69,6 +81,123 @@ namespace {
 } // namespace
 
 
+VulkanComputeApp::DeviceInfo VulkanComputeApp::rateDevice( const VkPhysicalDevice candidate, const int32_t index ) const {
+    DeviceInfo info = {};
+    info.index = index;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( candidate, &properties );
+    info.name = properties.deviceName;
+    info.type = properties.deviceType;
+    info.apiVersion = properties.apiVersion;
+
+    // subgroup size and UUID need vkGetPhysicalDeviceProperties2 and a Vulkan 1.1 device
+    PFN_vkGetPhysicalDeviceProperties2KHR getProperties2 = NULL;
+    if ( hasPhysicalDeviceProperties2 ) {
+        getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+    }
+    if ( getProperties2 != NULL && properties.apiVersion >= VK_API_VERSION_1_1 ) {
+        VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+        subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+        VkPhysicalDeviceIDProperties idProperties = {};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        idProperties.pNext = &subgroupProperties;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &idProperties;
+        getProperties2( candidate, &properties2 );
+
+        info.subgroupSize = subgroupProperties.subgroupSize;
+        // subgroupAdd() & co. in compute shaders, SPIR-V 1.3 needs a Vulkan 1.1 instance as well
+        info.subgroupArithmetic = instanceApiVersion >= VK_API_VERSION_1_1 &&
+                                  ( subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT ) &&
+                                  ( subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT );
+        // formatted like vulkaninfo does: 8-4-4-4-12 hex digits
+        for ( int i = 0; i < VK_UUID_SIZE; i++ ) {
+            char hex[3];
+            snprintf( hex, sizeof( hex ), "%02x", idProperties.deviceUUID[i] );
+            info.uuid += hex;
+            if ( i == 3 || i == 5 || i == 7 || i == 9 ) { info.uuid += '-'; }
+        }
+    }
+
+    VkPhysicalDeviceFeatures features = {};
+    vkGetPhysicalDeviceFeatures( candidate, &features );
+    info.float64 = features.shaderFloat64 == VK_TRUE;
+    info.int64 = features.shaderInt64 == VK_TRUE;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties( candidate, &memoryProperties );
+    for ( uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++ ) {
+        if ( memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ) {
+            info.deviceLocalBytes = std::max( info.deviceLocalBytes, memoryProperties.memoryHeaps[i].size );
+        }
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( candidate, &queueFamilyCount, NULL );
+    std::vector<VkQueueFamilyProperties> queueFamilies( queueFamilyCount );
+    vkGetPhysicalDeviceQueueFamilyProperties( candidate, &queueFamilyCount, queueFamilies.data() );
+    for ( const VkQueueFamilyProperties& queueFamily : queueFamilies ) {
+        if ( queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT ) { info.numComputeQueues += queueFamily.queueCount; }
+    }
+
+    // (this used to be queried on the not yet selected physicalDevice, which crashed)
+    uint32_t deviceExtensionCount = 0;
+    vkEnumerateDeviceExtensionProperties( candidate, NULL, &deviceExtensionCount, NULL );
+    std::vector<VkExtensionProperties> deviceExtensions( deviceExtensionCount );
+    vkEnumerateDeviceExtensionProperties( candidate, NULL, &deviceExtensionCount, deviceExtensions.data() );
+    for ( const VkExtensionProperties& deviceExtension : deviceExtensions ) {
+        if ( strcmp( deviceExtension.extensionName, "VK_KHR_portability_subset" ) == 0 ) { info.portabilitySubset = true; }
+        if ( strcmp( deviceExtension.extensionName, "VK_KHR_timeline_semaphore" ) == 0 ) { info.timelineSemaphore = true; }
+    }
+    info.numExtensions = deviceExtensionCount;
+    // core since Vulkan 1.2, if both the instance and the device have it
+    if ( instanceApiVersion >= VK_API_VERSION_1_2 && properties.apiVersion >= VK_API_VERSION_1_2 ) { info.timelineSemaphore = true; }
+
+    // The type dominates, a discrete GPU wins over an integrated one, and that over a software implementation.
+    // Within a type, more memory, more compute queues, the 64-bit types of the precision modes and wider subgroups count.
+    static const double typeScores[] = { 0.0, 500.0, 1000.0, 300.0, 10.0 }; // other, integrated, discrete, virtual, CPU
+    info.score = ( info.type <= VK_PHYSICAL_DEVICE_TYPE_CPU ) ? typeScores[ info.type ] : 0.0;
+    info.score += 50.0 * log2( 1.0 + info.deviceLocalBytes / double( 1u << 30 ) );
+    info.score += 10.0 * std::min( info.numComputeQueues, 8u );
+    info.score += ( info.float64 ? 40.0 : 0.0 ) + ( info.int64 ? 20.0 : 0.0 );
+    info.score += info.subgroupSize / 4.0;
+    return info;
+}
+
+namespace {
+
+    static std::string toLower( std::string s ) {
+        for ( char& c : s ) { c = static_cast<char>( tolower( static_cast<unsigned char>( c ) ) ); }
+        return s;
+    }
+
+    static std::string withoutDashes( const std::string& s ) {
+        std::string out;
+        for ( const char c : s ) { if ( c != '-' ) { out += c; } }
+        return out;
+    }
+
+    // "3", a UUID (with or without dashes) or a part of the device name, case-insensitive
+    static bool matchesSelector( const VulkanComputeApp::DeviceInfo& info, const std::string& selector ) {
+        if ( selector.find_first_not_of( "0123456789" ) == std::string::npos ) { return atoi( selector.c_str() ) == info.index; }
+        if ( !info.uuid.empty() && toLower( withoutDashes( selector ) ) == withoutDashes( info.uuid ) ) { return true; }
+        return toLower( info.name ).find( toLower( selector ) ) != std::string::npos;
+    }
+
+    static const char* deviceTypeName( const VkPhysicalDeviceType type ) {
+        switch ( type ) {
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+            default: return "other";
+        }
+    }
+
+} // namespace
+
 void VulkanComputeApp::findPhysicalDevice() { // In this function, we find a physical device that can be used with Vulkan.
 
     // So, first we will list all physical devices on the system with vkEnumeratePhysicalDevices .
@@ -83,110 +212,123 @@ void VulkanComputeApp::findPhysicalDevice() { // In this function, we find a phy
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-    printf( "found the following instance extensions:\n" );
-    // Get extensions supported by the instance and store for later use
-    uint32_t instanceExtensionCount = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionCount, nullptr);
-    if ( instanceExtensionCount > 0 )
-    {
-        std::vector<VkExtensionProperties> instanceExtensions( instanceExtensionCount );
-        if (vkEnumerateInstanceExtensionProperties( nullptr, &instanceExtensionCount, &instanceExtensions.front()) == VK_SUCCESS )
-        {
-            for ( VkExtensionProperties instanceExtension : instanceExtensions )
-            {
-                //supportedInstanceExtensions.push_back( instanceExtension.extensionName );
-                printf( "   %s \n", instanceExtension.extensionName );
-            }
-        }
-    }
-    printf( "\n" );
-
-#if 1
-    for ( VkPhysicalDevice& pyhsicalDevice : devices ) {
-        static uint32_t deviceNum = 0;
-
-        // VkPhysicalDeviceProperties properties;
-        // vkGetPhysicalDeviceProperties( physicalDevice, &properties );
-        
-        //printf( "device %u: %s\n", deviceNum, properties.deviceName );
-        
-        // !!! CRASHES !!!
-        //uint32_t deviceExtensionCount;
-        //vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &deviceExtensionCount, nullptr);
-
-        // std::vector<VkExtensionProperties> deviceExtensions ( deviceExtensionCount );
-        // vkEnumerateDeviceExtensionProperties( physicalDevice, nullptr, &deviceExtensionCount, deviceExtensions.data() );
-        // for ( auto& deviceExtension : deviceExtensions )
-        // {
-        //     // if ( !strcmp( deviceExtension.extensionName, VK_EXT_DEBUG_MARKER_EXTENSION_NAME ) )
-        //     // {
-        //     //     extensionPresent = true;
-        //     // }
-
-        //     printf( "%s ", deviceExtension.extensionName );
-        // }
-        // printf( "\n" );
-
-        deviceNum++;
-    }
-#endif  
     /*
     Next, we choose a device that can be used for our purposes.
 
-    With VkPhysicalDeviceFeatures(), we can retrieve a fine-grained list of physical features supported by the device.
-    However, in this demo, we are simply launching a simple compute shader, and there are no
-    special physical features demanded for this task.
+    Every device is rated by rateDevice() - by its type, memory, compute queues, 64-bit support and subgroup size -
+    and the best one is taken, unless a device was asked for by index (setPhysicalDeviceIndex()), or by name or UUID
+    (setDeviceSelector() or the VKCOMPUTE_DEVICE environment variable). That keeps us from landing on the slow iGPU
+    just because it happens to be enumerated first.
 
-    With VkPhysicalDeviceProperties(), we can obtain a list of physical device properties. Most importantly,
-    we obtain a list of physical device limitations. For this application, we launch a compute shader,
-    and the maximum size of the workgroups and total number of compute shader invocations is limited by the physical device,
-    and we should ensure that the limitations named maxComputeWorkGroupCount, maxComputeWorkGroupInvocations and
-    maxComputeWorkGroupSize are not exceeded by our application.  Moreover, we are using a storage buffer in the compute shader,
-    and we should ensure that it is not larger than the device can handle, by checking the limitation maxStorageBufferRange.
+    The limits of the chosen device (maxComputeWorkGroupInvocations, maxComputeWorkGroupSize, maxComputeWorkGroupCount,
+    maxStorageBufferRange) are checked later: fitToDeviceLimits() adapts the workgroup size of the apps, and
+    createBuffer() refuses buffers larger than the device can bind. See http://vulkan.gpuinfo.org/ for typical values.
+    */
+    std::vector<DeviceInfo> infos;
+    for ( uint32_t i = 0; i < deviceCount; i++ ) {
+        infos.push_back( rateDevice( devices[i], static_cast<int32_t>( i ) ) );
+    }
 
-    However, in our application, the workgroup size and total number of shader invocations is relatively small, and the storage buffer is
-    not that large, and thus a vast majority of devices will be able to handle it. This can be verified by looking at some devices at_
-    http://vulkan.gpuinfo.org/
+    std::string selector = deviceSelector;
+    const char* selectorEnv = getenv( "VKCOMPUTE_DEVICE" );
+    if ( selector.empty() && selectorEnv != NULL ) { selector = selectorEnv; }
 
-    Therefore, to keep things simple and clean, we will not perform any such checks here, and just pick the first physical
-    device in the list. But in a real and serious application, those limitations should certainly be taken into account.
+    int32_t chosen = -1;
+    for ( const DeviceInfo& info : infos ) {
+        bool eligible = true;
+        if ( physicalDeviceIndex >= 0 ) { eligible = ( info.index == physicalDeviceIndex ); }
+        else if ( !selector.empty() ) { eligible = matchesSelector( info, selector ); }
+        if ( eligible && ( chosen < 0 || info.score > infos[ chosen ].score ) ) { chosen = info.index; }
+    }
 
-    */
-    
-    // for (VkPhysicalDevice device : devices) {
-    //     if (true) { // As above stated, we do no feature checks, so just accept.
-    //         physicalDevice = device;
-    //         break;
-    //     }
-    // }
-    
-    physicalDevice = devices[ 0 ];
-    //physicalDevice = devices[ 1 ]; // chose AMD GPU
-
-    // for ( const VkPhysicalDevice& device : devices ) {
-    //     VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
-    //     //physicalDeviceFeatures.shaderFloat64 = VkBool32{ true };
-    //     vkGetPhysicalDeviceFeatures( device, &physicalDeviceFeatures );
-    //     printf( "shaderInt64 is%s supported\n", ( physicalDeviceFeatures.shaderInt64 == VK_TRUE ) ? "" : " not" );        
-    // }
+    printf( "    %-40s %-10s %9s %6s %5s %5s %8s %7s  %s\n", "device", "type", "VRAM[MiB]", "queues", "fp64", "int64", "subgroup", "score", "uuid" );
+    for ( const DeviceInfo& info : infos ) {
+        printf( "%c %d %-40s %-10s %9llu %6u %5s %5s %8u %7.1f  %s\n", info.index == chosen ? '*' : ' ', info.index, info.name.c_str(),
+            deviceTypeName( info.type ), static_cast<unsigned long long>( info.deviceLocalBytes >> 20 ), info.numComputeQueues,
+            info.float64 ? "yes" : "no", info.int64 ? "yes" : "no", info.subgroupSize, info.score, info.uuid.c_str() );
+    }
 
-    // for ( const VkPhysicalDevice& device : devices ) {
-    //     VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
-    //     physicalDeviceFeatures.shaderInt64 = VkBool32{ true };
-    // }
-    
-    // VkPhysicalDeviceFeatures* pPhysicalDeviceFeatures = nullptr;
-    // vkGetPhysicalDeviceFeatures( physicalDevice, pPhysicalDeviceFeatures );
-    // pPhysicalDeviceFeatures->shaderInt64 = true;
+    if ( chosen < 0 ) {
+        if ( physicalDeviceIndex >= 0 ) { throw std::runtime_error( "there is no Vulkan device " + std::to_string( physicalDeviceIndex ) ); }
+        throw std::runtime_error( "no Vulkan device matches '" + selector + "'" );
+    }
+    physicalDevice = devices[ chosen ];
+    physicalDeviceInfo = infos[ chosen ];
+    vkGetPhysicalDeviceProperties( physicalDevice, &physicalDeviceProperties );
+    printf( "using device %d: %s\n", chosen, physicalDeviceProperties.deviceName );
 
-    VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
+    physicalDeviceFeatures = {};
     physicalDeviceFeatures.shaderFloat64 = VK_FALSE;
     physicalDeviceFeatures.shaderInt64 = VK_FALSE;
     vkGetPhysicalDeviceFeatures( physicalDevice, &physicalDeviceFeatures );
+    printf( "shaderFloat64 is%s supported\n", ( physicalDeviceFeatures.shaderFloat64 == VK_TRUE ) ? "" : " not" );
     printf( "shaderInt64 is%s supported\n", ( physicalDeviceFeatures.shaderInt64 == VK_TRUE ) ? "" : " not" );        
             
 }
 
+uint32_t VulkanComputeApp::fitWorkgroupSize( const uint32_t requested ) const {
+    const VkPhysicalDeviceLimits& limits = physicalDeviceProperties.limits;
+    uint32_t size = 1;
+    while ( size * 2 <= requested && ( size * 2 ) * ( size * 2 ) <= limits.maxComputeWorkGroupInvocations &&
+            size * 2 <= limits.maxComputeWorkGroupSize[0] && size * 2 <= limits.maxComputeWorkGroupSize[1] ) {
+        size *= 2;
+    }
+    if ( size != requested ) {
+        printf( "workgroup size %ux%u does not fit the device (maxComputeWorkGroupInvocations %u), using %ux%u\n",
+            requested, requested, limits.maxComputeWorkGroupInvocations, size, size );
+    }
+    return size;
+}
+
+void VulkanComputeApp::checkDispatchSize( const uint32_t resx, const uint32_t resy, const uint32_t workgroupSize ) const {
+    const VkPhysicalDeviceLimits& limits = physicalDeviceProperties.limits;
+    const uint32_t groupsX = ( resx + workgroupSize - 1 ) / workgroupSize, groupsY = ( resy + workgroupSize - 1 ) / workgroupSize;
+    if ( groupsX > limits.maxComputeWorkGroupCount[0] || groupsY > limits.maxComputeWorkGroupCount[1] ) {
+        throw std::runtime_error( "resolution " + std::to_string( resx ) + "x" + std::to_string( resy ) +
+                                  " exceeds maxComputeWorkGroupCount of the device" );
+    }
+}
+
+
+uint32_t VulkanComputeApp::getInstanceApiVersion() {
+    // vkEnumerateInstanceVersion was added with Vulkan 1.1, a 1.0 loader does not have it - and would refuse an
+    // instance with a higher apiVersion
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+        (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion");
+    uint32_t version = VK_API_VERSION_1_0;
+    if ( enumerateInstanceVersion != NULL && enumerateInstanceVersion( &version ) != VK_SUCCESS ) { version = VK_API_VERSION_1_0; }
+    return std::min( version, static_cast<uint32_t>( VK_API_VERSION_1_2 ) );
+}
+
+std::vector<std::string> VulkanComputeApp::listPhysicalDevices() {
+    VkApplicationInfo applicationInfo = {};
+    applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    applicationInfo.pApplicationName = "Vulkan Compute Test App";
+    applicationInfo.apiVersion = getInstanceApiVersion();
+
+    VkInstanceCreateInfo instanceCreateInfo = {};
+    instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceCreateInfo.pApplicationInfo = &applicationInfo;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, NULL, &instance));
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, NULL);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    std::vector<std::string> names;
+    for ( const VkPhysicalDevice& device : devices ) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties( device, &properties );
+        names.push_back( properties.deviceName );
+    }
+
+    vkDestroyInstance(instance, NULL);
+    return names;
+}
+
 
 void VulkanComputeApp::createInstance() {
     std::vector<const char *> enabledInstanceExtensions;
@@ -251,14 +393,28 @@ void VulkanComputeApp::createInstance() {
             VkDeviceCreateInfo::ppEnabledExtensionNames list must also be present in that list 
             (https://vulkan.lunarg.com/doc/view/1.2.162.1/mac/1.2-extensions/vkspec.html#VUID-vkCreateDevice-ppEnabledExtensionNames-01387)
         */
-        // Reading device properties and features for multiview requires VK_KHR_get_physical_device_properties2 to be enabled
-        enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        // (VK_KHR_get_physical_device_properties2 is enabled below, whenever it is available)
 
         //???
         //enabledExtensions.push_back(VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME);
         //enabledExtensions.push_back( "VK_KHR_portability_subset" );
     }
 
+    // Reading device properties and features for multiview requires VK_KHR_get_physical_device_properties2 to be enabled,
+    // and findPhysicalDevice() reads the subgroup size and UUID of the devices through it.
+    {
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+        std::vector<VkExtensionProperties> extensionProperties(extensionCount);
+        vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, extensionProperties.data());
+        for (const VkExtensionProperties& prop : extensionProperties) {
+            if (strcmp(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, prop.extensionName) == 0) {
+                enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                hasPhysicalDeviceProperties2 = true;
+            }
+        }
+    }
+
     // Next, we actually create the instance.
 
     // Contains application info. This is actually not that important.
@@ -269,7 +425,9 @@ void VulkanComputeApp::createInstance() {
     applicationInfo.applicationVersion = 0;
     applicationInfo.pEngineName = "Vulkan Compute Test";
     applicationInfo.engineVersion = 0;
-    applicationInfo.apiVersion = VK_API_VERSION_1_0;;
+    // Vulkan 1.2 has timeline semaphores in the core (see submitAsync()), older loaders get 1.0 / 1.1
+    instanceApiVersion = getInstanceApiVersion();
+    applicationInfo.apiVersion = instanceApiVersion;
 
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -368,13 +526,54 @@ void VulkanComputeApp::createDevice() {
     //     const float*                pQueuePriorities;
     // } VkDeviceQueueCreateInfo;
 
+    queueFamilyIndex = getComputeQueueFamilyIndex(); // find queue family with compute capability.
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // The transfer queue: a family with transfer but neither compute nor graphics is a dedicated copy engine. Any other
+    // family will do as well (compute and graphics queues can always copy), and as a last resort a second queue of the
+    // compute family. Otherwise transfers go through `queue`.
+    const char* transferQueueKind = "shared with compute";
+    transferQueueFamilyIndex = queueFamilyIndex;
+    for ( uint32_t i = 0; i < queueFamilyCount; i++ ) {
+        const VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if ( i != queueFamilyIndex && queueFamilies[i].queueCount > 0 && ( flags & VK_QUEUE_TRANSFER_BIT ) &&
+             !( flags & ( VK_QUEUE_COMPUTE_BIT | VK_QUEUE_GRAPHICS_BIT ) ) ) {
+            transferQueueFamilyIndex = i;
+            transferQueueKind = "dedicated transfer family";
+            break;
+        }
+    }
+    for ( uint32_t i = 0; i < queueFamilyCount && transferQueueFamilyIndex == queueFamilyIndex; i++ ) {
+        if ( i != queueFamilyIndex && queueFamilies[i].queueCount > 0 &&
+             ( queueFamilies[i].queueFlags & ( VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_GRAPHICS_BIT ) ) ) {
+            transferQueueFamilyIndex = i;
+            transferQueueKind = "separate family";
+        }
+    }
+    bool transferInComputeFamily = false;
+    if ( transferQueueFamilyIndex == queueFamilyIndex && queueFamilies[ queueFamilyIndex ].queueCount > 1 ) {
+        transferInComputeFamily = true;
+        transferQueueKind = "own queue of the compute family";
+    }
+
+    // all queues are equally important to us
+    const float queuePriorities[2] = { 1.0f, 1.0f };
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     VkDeviceQueueCreateInfo queueCreateInfo = {};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueFamilyIndex = getComputeQueueFamilyIndex(); // find queue family with compute capability.
     queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    queueCreateInfo.queueCount = 1; // create one queue in this family. We don't need more.
-    float queuePriorities = 1.0;  // we only have one queue, so this is not that imporant.
-    queueCreateInfo.pQueuePriorities = &queuePriorities;
+    queueCreateInfo.queueCount = transferInComputeFamily ? 2 : 1;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
+    queueCreateInfos.push_back( queueCreateInfo );
+    if ( transferQueueFamilyIndex != queueFamilyIndex ) {
+        queueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfos.push_back( queueCreateInfo );
+    }
 
     // Now we create the logical device. The logical device allows us to interact with the physical
     // device.
@@ -385,13 +584,16 @@ void VulkanComputeApp::createDevice() {
 
     // https://vulkan-tutorial.com/Vertex_buffers/Vertex_input_description
     // Shader requires VkPhysicalDeviceFeatures::shaderFloat64 but is not enabled on the device
-    // deviceFeatures.shaderFloat64 = VK_TRUE; // not supported on macOS where Vulkan is run on Metal through MoltenVk, since there is no double in Metal!
+    // => enable the 64-bit types whenever the device has them, so that the fp64 / r128 shader variants of the path tracer can be used.
+    // Not supported on macOS where Vulkan is run on Metal through MoltenVk, since there is no double in Metal!
+    deviceFeatures.shaderFloat64 = physicalDeviceFeatures.shaderFloat64;
+    deviceFeatures.shaderInt64 = physicalDeviceFeatures.shaderInt64;
 
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.enabledLayerCount = enabledLayers.size();  // need to specify validation layers here as well.
     deviceCreateInfo.ppEnabledLayerNames = enabledLayers.data();
-    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo; // when creating the logical device, we also specify what queues it has.
-    deviceCreateInfo.queueCreateInfoCount = 1;
+    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data(); // when creating the logical device, we also specify what queues it has.
+    deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>( queueCreateInfos.size() );
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
     //???
     //const char *const extensions[] = { "VK_KHR_portability_subset" };
@@ -408,7 +610,17 @@ void VulkanComputeApp::createDevice() {
     */
     std::vector<const char*> deviceExtensions;
     
-    //!!! deviceExtensions.push_back( "VK_KHR_portability_subset" );
+    if ( physicalDeviceInfo.portabilitySubset ) { deviceExtensions.push_back( "VK_KHR_portability_subset" ); }
+
+    // the extension alone is not enough, the feature has to be enabled as well
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    const bool coreTimelineSemaphore = instanceApiVersion >= VK_API_VERSION_1_2 && physicalDeviceInfo.apiVersion >= VK_API_VERSION_1_2;
+    if ( physicalDeviceInfo.timelineSemaphore ) {
+        if ( !coreTimelineSemaphore ) { deviceExtensions.push_back( "VK_KHR_timeline_semaphore" ); }
+        deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+    }
         
     
     deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
@@ -435,8 +647,75 @@ void VulkanComputeApp::createDevice() {
 
     VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device)); // create logical device.
 
-    // Get a handle to the only member of the queue family.
+    // Get handles to the queues.
     vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+    if ( transferQueueFamilyIndex != queueFamilyIndex ) { vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue); }
+    else if ( transferInComputeFamily ) { vkGetDeviceQueue(device, queueFamilyIndex, 1, &transferQueue); }
+    else { transferQueue = queue; }
+    printf( "compute queue family %u, transfer queue: family %u, %s\n", queueFamilyIndex, transferQueueFamilyIndex, transferQueueKind );
+
+    if ( physicalDeviceInfo.timelineSemaphore ) {
+        pfnWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, coreTimelineSemaphore ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+        pfnGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device,
+            coreTimelineSemaphore ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+        timelineSemaphores = pfnWaitSemaphores != NULL && pfnGetSemaphoreCounterValue != NULL;
+    }
+}
+
+VkSemaphore VulkanComputeApp::createTimelineSemaphore() {
+    if ( !timelineSemaphores ) { throw std::runtime_error( "the device does not support timeline semaphores" ); }
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, NULL, &semaphore));
+    return semaphore;
+}
+
+void VulkanComputeApp::waitTimelineSemaphore( const VkSemaphore semaphore, const uint64_t value ) {
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    VK_CHECK_RESULT(pfnWaitSemaphores(device, &waitInfo, 100000000000));
+}
+
+uint64_t VulkanComputeApp::getTimelineSemaphoreValue( const VkSemaphore semaphore ) {
+    uint64_t value = 0;
+    VK_CHECK_RESULT(pfnGetSemaphoreCounterValue(device, semaphore, &value));
+    return value;
+}
+
+void VulkanComputeApp::submitTimeline( const VkQueue targetQueue, const VkCommandBuffer commandBuffer,
+                                       const std::vector<VkSemaphore>& waitSemaphores, const std::vector<uint64_t>& waitValues, const VkPipelineStageFlags waitStage,
+                                       const VkSemaphore signalSemaphore, const uint64_t signalValue ) {
+    const std::vector<VkPipelineStageFlags> waitStages( waitSemaphores.size(), waitStage );
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>( waitValues.size() );
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>( waitSemaphores.size() );
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+    VK_CHECK_RESULT(vkQueueSubmit(targetQueue, 1, &submitInfo, VK_NULL_HANDLE));
 }
 
 
@@ -446,15 +725,20 @@ void VulkanComputeApp::init() {
     findPhysicalDevice();
     createDevice();
     printf( "created device\n" );
+    fitToDeviceLimits();
 }
 
-void VulkanComputeApp::run() {    
+void VulkanComputeApp::prepare() {
     printf( " * before createDescriptorSetLayout()\n" ); fflush( stdout );
     createDescriptorSetLayout();
     printf( " * before createDescriptorSet()\n" ); fflush( stdout );
     createDescriptorSet();
     printf( " * before createComputePipeline()\n" ); fflush( stdout );
     createComputePipeline();
+}
+
+void VulkanComputeApp::run() {    
+    prepare();
     printf( " * before createCommandBuffer()\n" ); fflush( stdout );
     createCommandBufferPre();
     createCommandBuffer();
@@ -465,6 +749,13 @@ void VulkanComputeApp::run() {
     runCommandBuffer();
 }
 
+void VulkanComputeApp::rerun() {
+    createCommandBufferPre();
+    createCommandBuffer();
+    createCommandBufferPost();
+    runCommandBuffer();
+}
+
 void VulkanComputeApp::createShader( const char* pFilename, VkShaderModule& computeShaderModule ) {
     printf( "in VulkanComputeApp::createShader!\n" );
     // Create a shader module. A shader module basically just encapsulates some shader code.
@@ -485,26 +776,117 @@ void VulkanComputeApp::createShader( const char* pFilename, VkShaderModule& comp
     printf( "leaving VulkanComputeApp::createShader!\n" );
 }
 
+void VulkanComputeApp::loadShader( const char* pSourceFilename, const std::vector<std::string>& defines, const char* pSpvFilename, VkShaderModule& computeShaderModule,
+                                   const std::string& targetEnv ) {
+    if ( !compileShadersAtRuntime ) {
+        createShader( pSpvFilename, computeShaderModule );
+        return;
+    }
+
+    const std::vector<uint32_t> code = shaderCompiler.compile( pSourceFilename, defines, targetEnv );
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pCode = code.data();
+    createInfo.codeSize = code.size() * sizeof( uint32_t );
+
+    VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, NULL, &computeShaderModule));
+}
+
+void VulkanComputeApp::destroyComputePipeline() {
+    vkDestroyPipeline(device, pipeline, NULL);
+    vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+    vkDestroyShaderModule(device, computeShaderModule, NULL);
+    pipeline = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    computeShaderModule = VK_NULL_HANDLE;
+}
+
+void VulkanComputeApp::rebuildComputePipeline() {
+    // a compile error must not trigger the next rebuild before the sources are touched again
+    shaderCompiler.markSourcesSeen();
+
+    VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+    destroyComputePipeline();
+    createComputePipeline();
+}
 
 void VulkanComputeApp::createBuffer( const uint32_t bufferSize ) {
     // We will now create a buffer. We will render the mandelbrot set into this buffer
     // in a computer shade later.
+    createBuffer( bufferSize, buffer, bufferMemory );
+}
+
+void VulkanComputeApp::destroyBuffer( VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory ) {
+    vkDestroyBuffer(device, dstBuffer, NULL);
+    vkFreeMemory(device, dstBufferMemory, NULL);
+    dstBuffer = VK_NULL_HANDLE;
+    dstBufferMemory = VK_NULL_HANDLE;
+}
+
+void VulkanComputeApp::createBuffer( const uint32_t bufferSize, const VkBufferUsageFlags usage, const std::vector<VkMemoryPropertyFlags>& memoryProperties,
+                                     VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory ) {
+    if ( ( usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT ) && bufferSize > physicalDeviceProperties.limits.maxStorageBufferRange ) {
+        throw std::runtime_error( "buffer of " + std::to_string( bufferSize ) + " bytes exceeds maxStorageBufferRange (" +
+                                  std::to_string( physicalDeviceProperties.limits.maxStorageBufferRange ) + ") of the device" );
+    }
+
+    const uint32_t queueFamilyIndices[2] = { queueFamilyIndex, transferQueueFamilyIndex };
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = bufferSize;
+    bufferCreateInfo.usage = usage;
+    if ( transferQueueFamilyIndex != queueFamilyIndex ) {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCreateInfo.queueFamilyIndexCount = 2;
+        bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+    } else {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, NULL, &dstBuffer));
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, dstBuffer, &memoryRequirements);
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = static_cast<uint32_t>( -1 );
+    for ( const VkMemoryPropertyFlags properties : memoryProperties ) {
+        allocateInfo.memoryTypeIndex = findMemoryType( memoryRequirements.memoryTypeBits, properties );
+        if ( allocateInfo.memoryTypeIndex != static_cast<uint32_t>( -1 ) ) { break; }
+    }
+    if ( allocateInfo.memoryTypeIndex == static_cast<uint32_t>( -1 ) ) {
+        throw std::runtime_error( "could not find a memory type for a buffer" );
+    }
+
+    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, NULL, &dstBufferMemory));
+    VK_CHECK_RESULT(vkBindBufferMemory(device, dstBuffer, dstBufferMemory, 0));
+}
+
+void VulkanComputeApp::createBuffer( const uint32_t bufferSize, VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory ) {
 
     printf( "buffer create!\n" ); fflush( stdout );
 
+    // the whole buffer is bound to a storage buffer descriptor
+    if ( bufferSize > physicalDeviceProperties.limits.maxStorageBufferRange ) {
+        throw std::runtime_error( "buffer of " + std::to_string( bufferSize ) + " bytes exceeds maxStorageBufferRange (" +
+                                  std::to_string( physicalDeviceProperties.limits.maxStorageBufferRange ) + ") of the device" );
+    }
+
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = bufferSize; // buffer size in bytes.
     bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // buffer is used as a storage buffer.
     bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer is exclusive to a single queue family at a time.
 
-    VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, NULL, &buffer)); // create buffer.
+    VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, NULL, &dstBuffer)); // create buffer.
 
     // But the buffer doesn't allocate memory for itself, so we must do that manually.
 
     // First, we find the memory requirements for the buffer.
     VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    vkGetBufferMemoryRequirements(device, dstBuffer, &memoryRequirements);
 
     // Now use obtained memory requirements info to allocate the memory for the buffer.
     VkMemoryAllocateInfo allocateInfo = {};
@@ -523,10 +905,10 @@ void VulkanComputeApp::createBuffer( const uint32_t bufferSize ) {
     allocateInfo.memoryTypeIndex = findMemoryType(
         memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, NULL, &bufferMemory)); // allocate memory on device.
+    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, NULL, &dstBufferMemory)); // allocate memory on device.
 
     // Now associate that allocated memory with the buffer. With that, the buffer is backed by actual memory.
-    VK_CHECK_RESULT(vkBindBufferMemory(device, buffer, bufferMemory, 0));
+    VK_CHECK_RESULT(vkBindBufferMemory(device, dstBuffer, dstBufferMemory, 0));
 
 
     printf( "leaving createBuffer!\n" ); fflush( stdout );
@@ -540,29 +922,67 @@ void VulkanComputeApp::createDescriptorSetLayout() {
 
 #if defined( MANDELBROT_MODE )
     /*
-    Here we specify a binding of type VK_DESCRIPTOR_TYPE_STORAGE_BUFFER to the binding point
-    0. This binds to
-
-        layout(std140, binding = 0) buffer buf
-
-    in the compute shader.
+    Here we specify five bindings of type VK_DESCRIPTOR_TYPE_STORAGE_BUFFER to the binding points
+    0 to 4. These bind to
+
+        layout(std430, binding = 0) buffer sampleBuf
+        layout(std430, binding = 1) buffer colorBuf
+        layout(std430, binding = 2) buffer tileBuf
+        layout(std430, binding = 3) buffer edgeBuf
+        layout(std430, binding = 4) buffer paramBuf
+
+    in the compute shaders. The iteration pass only uses binding 0, the coloring pass 0 and 1, the subdivision
+    pass (mandelbrotTiles.comp) 0 and 2, the anti-aliasing passes (mandelbrotEdges.comp,
+    mandelbrotSupersample.comp) 0, 1 and 3, and the batch pass (mandelbrotBatch.comp) 1 and 4.
     */
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
-    descriptorSetLayoutBinding.binding = 0; // binding = 0
-    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorSetLayoutBinding.descriptorCount = 1;
-    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[5] = {
+        { // samples
+            0,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // colors
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // tile lists and indirect dispatches of the subdivision
+            2,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // edge pixels and indirect dispatch of the anti-aliasing
+            3,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // per-image parameters of the batch
+            4,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+    };
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
     descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorSetLayoutCreateInfo.bindingCount = 1; // only a single binding in this descriptor set layout.
-    descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
+    descriptorSetLayoutCreateInfo.bindingCount = 5;
+    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
 
     // Create the descriptor set layout.
     VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, NULL, &descriptorSetLayout));
 
 #elif defined( PATHTRACER_MODE )
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[3] = {
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[13] = {
         {
             0,
             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
@@ -570,27 +990,97 @@ void VulkanComputeApp::createDescriptorSetLayout() {
             VK_SHADER_STAGE_COMPUTE_BIT,
             0
         },
-        { // planes
+        { // plane equations (whole records with SCENE_LAYOUT_AOS, see pathTracer.comp)
             1,
             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             1,
             VK_SHADER_STAGE_COMPUTE_BIT,
             0
         },
-        { // spheres
+        { // sphere centers and radii (whole records with SCENE_LAYOUT_AOS)
             2,
             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             1,
             VK_SHADER_STAGE_COMPUTE_BIT,
             0
         },
+        { // image statistics, only used by imageStats.comp
+            3,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // packed 8 bit image, only used by packImage.comp
+            4,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // first-hit albedo and normal for the denoiser
+            5,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // scratch images of the denoiser, only used by denoise.comp
+            6,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // local frames of the spheres
+            7,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // materials of planes, spheres and instances
+            8,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // object-space spheres of the instanced prototypes
+            9,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // prototypes
+            10,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // instances
+            11,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
+        { // performance counters of pathTracer.comp
+            12,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0
+        },
     };
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         0,
         0,
-        3,
+        13,
         descriptorSetLayoutBindings
     };
 
@@ -607,30 +1097,56 @@ void VulkanComputeApp::createCommandBufferPre() {
     // we must first record commands into a command buffer.
     // To allocate a command buffer, we must first create a command pool. So let us do that.
 
-    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.flags = 0;
-    // the queue family of this command pool. All command buffers allocated from this command pool,
-    // must be submitted to queues of this family ONLY.
-    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, NULL, &commandPool));
-
-    // Now allocate a command buffer from the command pool.
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = commandPool; // specify the command pool to allocate from.
-    // if the command buffer is primary, it can be directly submitted to queues.
-    // A secondary buffer has to be called from some primary command buffer, and cannot be directly
-    // submitted to a queue. To keep things simple, we use a primary command buffer.
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 1; // allocate a single command buffer.
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer)); // allocate command buffer.
+    // the command buffer must not be in flight when it is reset
+    waitAsyncSubmissions();
+
+    if ( commandPool != VK_NULL_HANDLE ) {
+        // the pool and its command buffer already exist (rerun()) - the previous submission has finished, so just reset them
+        VK_CHECK_RESULT(vkResetCommandPool(device, commandPool, 0));
+    } else {
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.flags = 0;
+        // the queue family of this command pool. All command buffers allocated from this command pool,
+        // must be submitted to queues of this family ONLY.
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, NULL, &commandPool));
+
+        // Now allocate a command buffer from the command pool.
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool = commandPool; // specify the command pool to allocate from.
+        // if the command buffer is primary, it can be directly submitted to queues.
+        // A secondary buffer has to be called from some primary command buffer, and cannot be directly
+        // submitted to a queue. To keep things simple, we use a primary command buffer.
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = 1; // allocate a single command buffer.
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer)); // allocate command buffer.
+
+        if ( gpuTimestamps ) {
+            uint32_t queueFamilyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+            std::vector<VkQueueFamilyProperties> queueFamilies( queueFamilyCount );
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+            timestampValidBits = queueFamilies[ queueFamilyIndex ].timestampValidBits;
+            if ( timestampValidBits > 0 ) {
+                VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+                queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                queryPoolCreateInfo.queryCount = 2;
+                VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, NULL, &timestampQueryPool));
+            } else {
+                printf( "the compute queue has no timestamps, GPU times are not measured\n" );
+            }
+        }
+    }
 
     // Now we shall start recording commands into the newly allocated command buffer.
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // the buffer is only submitted and used once in this application.
+    beginInfo.flags = 0; // not VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: unchanged jobs submit the buffer again (see JobRuntime).
     VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo)); // start recording commands.
+    cmdWriteStartTimestamp();
 
     // We need to bind a pipeline, AND a descriptor set before we dispatch.
     // The validation layer will NOT give warnings if you forget these, so be very careful not to forget them.
@@ -639,9 +1155,140 @@ void VulkanComputeApp::createCommandBufferPre() {
 }
 
 void VulkanComputeApp::createCommandBufferPost() {
+    cmdWriteEndTimestamp();
     VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer)); // end recording commands.
 }
 
+void VulkanComputeApp::cmdWriteStartTimestamp() {
+    if ( timestampQueryPool == VK_NULL_HANDLE ) return;
+    // the buffer may be submitted again (JobRuntime), so it resets the queries itself
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool, 0, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 0);
+}
+
+void VulkanComputeApp::cmdWriteEndTimestamp() {
+    if ( timestampQueryPool == VK_NULL_HANDLE ) return;
+    // written once all previous commands have completed
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, 1);
+}
+
+void VulkanComputeApp::recordCommandBuffer() {
+    createCommandBufferPre();
+    createCommandBuffer();
+    createCommandBufferPost();
+}
+
+std::shared_future<double> VulkanComputeApp::submitAsync( const CompletionCallback& callback ) {
+    return submitAsync( commandBuffer, callback );
+}
+
+std::shared_future<double> VulkanComputeApp::submitAsync( const VkCommandBuffer commandBuffer, const CompletionCallback& callback ) {
+    std::unique_lock<std::mutex> lock( asyncMutex );
+    // without VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, a command buffer can only be in flight once
+    asyncCondition.wait( lock, [&]() {
+        for ( const PendingSubmission& pending : pendingSubmissions ) {
+            if ( pending.commandBuffer == commandBuffer ) { return false; }
+        }
+        return true;
+    } );
+    if ( !completionThread.joinable() ) {
+        if ( timelineSemaphores ) { asyncTimeline = createTimelineSemaphore(); }
+        stopAsync = false;
+        completionThread = std::thread( &VulkanComputeApp::completionThreadMain, this );
+    }
+
+    PendingSubmission pending;
+    pending.commandBuffer = commandBuffer;
+    pending.timelineValue = 0;
+    pending.fence = VK_NULL_HANDLE;
+    pending.callback = callback;
+    pending.promise = std::make_shared<std::promise<double>>();
+    pending.submitTime = std::chrono::high_resolution_clock::now();
+    if ( timelineSemaphores ) {
+        pending.timelineValue = ++asyncSubmitted;
+        submitTimeline( queue, commandBuffer, std::vector<VkSemaphore>(), std::vector<uint64_t>(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        asyncTimeline, pending.timelineValue );
+    } else {
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, NULL, &pending.fence));
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, pending.fence));
+    }
+    std::shared_future<double> future = pending.promise->get_future().share();
+    pendingSubmissions.push_back( pending );
+    asyncCondition.notify_all();
+    return future;
+}
+
+void VulkanComputeApp::waitAsyncSubmissions() {
+    std::unique_lock<std::mutex> lock( asyncMutex );
+    asyncCondition.wait( lock, [this]() { return pendingSubmissions.empty(); } );
+}
+
+void VulkanComputeApp::completionThreadMain() {
+    std::unique_lock<std::mutex> lock( asyncMutex );
+    for ( ;; ) {
+        asyncCondition.wait( lock, [this]() { return stopAsync || !pendingSubmissions.empty(); } );
+        if ( pendingSubmissions.empty() ) { return; } // stopped, and everything completed
+
+        // Poll the oldest submission with a short timeout rather than blocking on it, so that a lost device
+        // does not hang the thread forever. Submissions complete in order on the one queue.
+        const PendingSubmission pending = pendingSubmissions.front();
+        lock.unlock();
+        VkResult result;
+        if ( pending.fence != VK_NULL_HANDLE ) {
+            result = vkWaitForFences(device, 1, &pending.fence, VK_TRUE, 1000000);
+        } else {
+            VkSemaphoreWaitInfo waitInfo = {};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &asyncTimeline;
+            waitInfo.pValues = &pending.timelineValue;
+            result = pfnWaitSemaphores(device, &waitInfo, 1000000);
+        }
+        if ( result == VK_TIMEOUT ) {
+            lock.lock();
+            continue;
+        }
+
+        const double submitMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - pending.submitTime ).count();
+        if ( pending.fence != VK_NULL_HANDLE ) { vkDestroyFence(device, pending.fence, NULL); }
+        lastSubmitMs = submitMs; // before the future is ready, which orders it before get() returns
+        if ( result != VK_SUCCESS ) {
+            pending.promise->set_exception( std::make_exception_ptr(
+                std::runtime_error( "waiting for a submission failed with VkResult " + std::to_string( result ) ) ) );
+        } else {
+            try {
+                if ( pending.callback ) { pending.callback( submitMs ); }
+                pending.promise->set_value( submitMs );
+            }
+            catch ( ... ) {
+                pending.promise->set_exception( std::current_exception() );
+            }
+        }
+
+        lock.lock();
+        pendingSubmissions.pop_front();
+        asyncCondition.notify_all();
+    }
+}
+
+void VulkanComputeApp::stopCompletionThread() {
+    if ( !completionThread.joinable() ) { return; }
+    {
+        std::lock_guard<std::mutex> lock( asyncMutex );
+        stopAsync = true;
+    }
+    asyncCondition.notify_all();
+    completionThread.join();
+    vkDestroySemaphore(device, asyncTimeline, NULL);
+    asyncTimeline = VK_NULL_HANDLE;
+}
+
 void VulkanComputeApp::runCommandBuffer() {
     // Now we shall finally submit the recorded command buffer to a queue.
 
@@ -657,6 +1304,8 @@ void VulkanComputeApp::runCommandBuffer() {
     fenceCreateInfo.flags = 0;
     VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, NULL, &fence));
 
+    const auto submitTime = std::chrono::high_resolution_clock::now();
+
     // We submit the command buffer on the queue, at the same time giving a fence.
     VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
     
@@ -667,11 +1316,26 @@ void VulkanComputeApp::runCommandBuffer() {
     // Hence, we use a fence here.
     VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, 100000000000));
 
+    lastSubmitMs = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - submitTime ).count();
+
     vkDestroyFence(device, fence, NULL);
+
+    if ( timestampQueryPool != VK_NULL_HANDLE ) {
+        uint64_t timestamps[2];
+        VK_CHECK_RESULT(vkGetQueryPoolResults(device, timestampQueryPool, 0, 2, sizeof( timestamps ), timestamps, sizeof( uint64_t ),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        // only the low timestampValidBits bits count, the counter may wrap around in between
+        const uint64_t mask = timestampValidBits >= 64 ? ~0ull : ( ( 1ull << timestampValidBits ) - 1 );
+        const uint64_t ticks = ( timestamps[1] - timestamps[0] ) & mask;
+        lastGpuMs = ticks * static_cast<double>( physicalDeviceProperties.limits.timestampPeriod ) * 1e-6;
+    }
 }
 
 void VulkanComputeApp::cleanupVulkanResources() {
 
+    // lets the submissions of submitAsync() complete
+    stopCompletionThread();
+
     if (enableValidationLayers) {
         // destroy callback.
         auto func = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
@@ -690,6 +1354,7 @@ void VulkanComputeApp::cleanupVulkanResources() {
     vkDestroyPipelineLayout(device, pipelineLayout, NULL);
     vkDestroyPipeline(device, pipeline, NULL);
     vkDestroyCommandPool(device, commandPool, NULL);
+    vkDestroyQueryPool(device, timestampQueryPool, NULL);
     vkDestroyDevice(device, NULL);
     vkDestroyInstance(instance, NULL);
 }
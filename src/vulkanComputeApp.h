@@ -3,6 +3,18 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "shaderCompiler.h"
 
 #include <math.h>
 
@@ -35,77 +47,222 @@ struct VulkanComputeApp {
 
     void init();
     virtual void preRun() {}
+    // called by init() once the device is known - adapts the render configuration (e.g., the workgroup size) to its limits
+    virtual void fitToDeviceLimits() {}
+    // creates descriptor set layout, descriptor set and pipelines - everything run() needs besides the command buffer
+    void prepare();
     virtual void run();
+    // re-records the command buffer (e.g., after changing push constants) and submits it again,
+    // reusing descriptor sets and pipelines created by run()
+    void rerun();
 
     void createInstance();
     
     void findPhysicalDevice(); // In this function, we find a physical device that can be used with Vulkan.
 
+    // what findPhysicalDevice() rates a device by
+    struct DeviceInfo {
+        int32_t              index;             // in the vkEnumeratePhysicalDevices() list
+        std::string          name;
+        std::string          uuid;              // as printed by vulkaninfo, empty for Vulkan 1.0 devices
+        VkPhysicalDeviceType type;
+        VkDeviceSize         deviceLocalBytes;  // of the largest device-local heap
+        uint32_t             numComputeQueues;  // over all queue families with compute support
+        bool                 float64, int64;
+        uint32_t             subgroupSize;      // 0 if unknown (Vulkan 1.0 devices)
+        bool                 subgroupArithmetic; // GL_KHR_shader_subgroup_arithmetic in compute shaders
+        uint32_t             numExtensions;
+        bool                 portabilitySubset; // VK_KHR_portability_subset must be enabled (MoltenVK)
+        bool                 timelineSemaphore; // VK_KHR_timeline_semaphore is supported, or core (Vulkan 1.2)
+        uint32_t             apiVersion;
+        double               score;
+    };
+
+    // Selects the physical device by its index in the vkEnumeratePhysicalDevices() list, must be called before init().
+    // The default (-1) is the best rated device, see findPhysicalDevice().
+    void setPhysicalDeviceIndex( const int32_t index ) { physicalDeviceIndex = index; }
+    // Selects the best rated device whose name contains selector (case-insensitive), or whose UUID or index is selector.
+    // Must be called before init(), overrides the VKCOMPUTE_DEVICE environment variable.
+    void setDeviceSelector( const std::string& selector ) { deviceSelector = selector; }
+    // names of all physical devices, in the order of vkEnumeratePhysicalDevices() - creates a temporary instance
+    static std::vector<std::string> listPhysicalDevices();
+
     // Returns the index of a queue family that supports compute operations.
     uint32_t getComputeQueueFamilyIndex();
     
     void createDevice();
     
+    // largest power-of-two edge length <= requested of a square workgroup that the device supports
+    uint32_t fitWorkgroupSize( const uint32_t requested ) const;
+    // throws, if a resx x resy dispatch with square workgroups would exceed maxComputeWorkGroupCount
+    void checkDispatchSize( const uint32_t resx, const uint32_t resy, const uint32_t workgroupSize ) const;
+
     // find memory type with desired properties.
     uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties);
     
     void createBuffer( const uint32_t bufferSize );
+    // same as above, but for additional host-visible storage buffers owned by the derived apps
+    void createBuffer( const uint32_t bufferSize, VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory );
+    // Buffer with the given usage and memory properties - e.g., device-local or a staging buffer for the transfer queue.
+    // The first of the memory properties that the device has is used. Buffers are shared between the compute and the
+    // transfer queue family (VK_SHARING_MODE_CONCURRENT), so that no ownership transfers are needed.
+    void createBuffer( const uint32_t bufferSize, const VkBufferUsageFlags usage, const std::vector<VkMemoryPropertyFlags>& memoryProperties,
+                       VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory );
+    // releases a buffer from createBuffer(), e.g. before re-creating it with a larger size
+    void destroyBuffer( VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory );
     
     void createDescriptorSetLayout();
     virtual void createDescriptorSet() {}
     void createShader( const char* pFilename, VkShaderModule& computeShaderModule );
+    // Creates the shader module either from the prebuilt pSpvFilename (see Makefile), or - if shaders are
+    // compiled at runtime - from pSourceFilename with the given defines ("NAME" or "NAME=VALUE").
+    void loadShader( const char* pSourceFilename, const std::vector<std::string>& defines, const char* pSpvFilename, VkShaderModule& computeShaderModule,
+                     const std::string& targetEnv = std::string() );
     
     virtual void createComputePipeline() {}
+    // destroys what createComputePipeline() created, apps with additional pipelines must override this
+    virtual void destroyComputePipeline();
+
+    // Shader hot-reload: with runtime compilation enabled, shaderSourcesChanged() tells whether one of the
+    // shader sources (including the #included files) was modified since the pipelines were built, and
+    // rebuildComputePipeline() recreates them. Call rerun() afterwards.
+    void setCompileShadersAtRuntime( const bool enabled ) { compileShadersAtRuntime = enabled; }
+    bool shaderSourcesChanged() const { return compileShadersAtRuntime && shaderCompiler.sourcesChanged(); }
+    void rebuildComputePipeline();
     
     void createCommandBufferPre();
     virtual void createCommandBuffer() {}
     void createCommandBufferPost();
+    // records the command buffer like rerun(), without submitting it
+    void recordCommandBuffer();
 
     void runCommandBuffer();
 
+    // Asynchronous submission: submits the recorded command buffer and returns right away, so that the host can
+    // encode the previous image or prepare the next job meanwhile. The future becomes ready once the GPU is done,
+    // its value is the wall-clock time from submission to completion in ms (as getLastSubmitMs()). The callback, if
+    // any, is called before that on the completion thread, which waits for the submissions in order - on a
+    // timeline semaphore, or on a fence per submission if the device has no timeline semaphores.
+    // A command buffer that is still in flight is waited for before it is submitted again. Re-recording it
+    // (createCommandBufferPre()) waits for all submissions.
+    typedef std::function<void( double submitMs )> CompletionCallback;
+    std::shared_future<double> submitAsync( const CompletionCallback& callback = CompletionCallback() );
+    std::shared_future<double> submitAsync( const VkCommandBuffer commandBuffer, const CompletionCallback& callback = CompletionCallback() );
+    // blocks until every submitAsync() has completed
+    void waitAsyncSubmissions();
+
+    const VkPhysicalDeviceFeatures& getPhysicalDeviceFeatures() const { return physicalDeviceFeatures; }
+    const VkPhysicalDeviceLimits& getPhysicalDeviceLimits() const { return physicalDeviceProperties.limits; }
+    const DeviceInfo& getPhysicalDeviceInfo() const { return physicalDeviceInfo; }
+
+    // wall-clock time from submission until the fence of the last runCommandBuffer() was signalled
+    double getLastSubmitMs() const { return lastSubmitMs; }
+
+    // GPU timestamps: with this enabled (before run()), the command buffer writes a timestamp before and after its
+    // commands, and getLastGpuMs() is the time between the two of the last runCommandBuffer() - without the
+    // submission and fence latency of getLastSubmitMs(). Stays 0 if the queue has no timestamps
+    // (timestampValidBits == 0).
+    void setGpuTimestamps( const bool enabled ) { gpuTimestamps = enabled; }
+    bool hasGpuTimestamps() const { return timestampQueryPool != VK_NULL_HANDLE; }
+    double getLastGpuMs() const { return lastGpuMs; }
+
+    // true, if transfers can run on their own queue, concurrently to the compute work of `queue`
+    bool hasSeparateTransferQueue() const { return transferQueue != queue; }
+    bool hasTimelineSemaphores() const { return timelineSemaphores; }
+
     //void getRenderedImage( std::vector<uint8_t> &image, const uint32_t bufferSize, const uint32_t resx, const uint32_t resy, float floatScaleFactor );
     virtual void saveRenderedImage( const char* png_filename ) = 0;
+    // the rendered image as RGBA8, rows top to bottom - as it would be written by saveRenderedImage()
+    virtual void getRenderedImageRGBA8( std::vector<uint8_t>& image ) = 0;
 
     void cleanupVulkanResources();
+
+    // the highest Vulkan version up to 1.2 that the loader supports, used as apiVersion of the instances
+    static uint32_t getInstanceApiVersion();
     
 protected:
 
     // In order to use Vulkan, you must create an instance.
-    VkInstance instance;
+    VkInstance instance = VK_NULL_HANDLE;
 
-    VkDebugReportCallbackEXT debugReportCallback;
+    VkDebugReportCallbackEXT debugReportCallback = VK_NULL_HANDLE;
 
     // The physical device is some device on the system that supports usage of Vulkan.
     // Often, it is simply a graphics card that supports Vulkan.
-    VkPhysicalDevice physicalDevice;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    int32_t physicalDeviceIndex = -1; // see setPhysicalDeviceIndex()
+    std::string deviceSelector; // see setDeviceSelector()
+    DeviceInfo physicalDeviceInfo = {};
+    VkPhysicalDeviceProperties physicalDeviceProperties = {};
+    bool hasPhysicalDeviceProperties2 = false; // VK_KHR_get_physical_device_properties2 is enabled
+
+    DeviceInfo rateDevice( const VkPhysicalDevice candidate, const int32_t index ) const;
+
+    // the features supported by physicalDevice, queried in findPhysicalDevice()
+    VkPhysicalDeviceFeatures physicalDeviceFeatures;
 
     // Then we have the logical device VkDevice, which basically allows
     // us to interact with the physical device.
-    VkDevice device;
+    VkDevice device = VK_NULL_HANDLE;
 
     // The pipeline specifies the pipeline that all graphics and compute commands pass though in Vulkan.
     // We will be creating a simple compute pipeline in this application.
-    VkPipeline pipeline;
-    VkPipelineLayout pipelineLayout;
-    VkShaderModule computeShaderModule;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkShaderModule computeShaderModule = VK_NULL_HANDLE;
 
     // The command buffer is used to record commands, that will be submitted to a queue.
     // To allocate such command buffers, we use a command pool.
-    VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+    double lastSubmitMs = 0.0;
+
+    // see setGpuTimestamps(): query 0 is written at the start of commandBuffer, query 1 at its end
+    bool gpuTimestamps = false;
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    uint32_t timestampValidBits = 0;
+    double lastGpuMs = 0.0;
+    // record the timestamps into commandBuffer, for command buffers recorded without createCommandBufferPre() / Post()
+    void cmdWriteStartTimestamp();
+    void cmdWriteEndTimestamp();
+
+    // submitAsync() - submissions the completion thread has not seen finish yet, oldest first
+    struct PendingSubmission {
+        VkCommandBuffer commandBuffer;
+        uint64_t        timelineValue;  // of asyncTimeline
+        VkFence         fence;          // instead, without timeline semaphores
+        std::chrono::high_resolution_clock::time_point submitTime;
+        CompletionCallback callback;
+        std::shared_ptr<std::promise<double>> promise;
+    };
+    std::deque<PendingSubmission> pendingSubmissions;
+    std::mutex              asyncMutex;         // guards pendingSubmissions and stopAsync
+    std::condition_variable asyncCondition;     // a submission was added or completed
+    std::thread             completionThread;   // started by the first submitAsync()
+    bool                    stopAsync = false;
+    VkSemaphore             asyncTimeline = VK_NULL_HANDLE;
+    uint64_t                asyncSubmitted = 0;
+    void completionThreadMain();
+    void stopCompletionThread();
+
+    uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+
+    bool compileShadersAtRuntime = false;
+    ShaderCompiler shaderCompiler;
 
     // Descriptors represent resources in shaders. They allow us to use things like
     // uniform buffers, storage buffers and images in GLSL.
     // A single descriptor represents a single resource, and several descriptors are organized
     // into descriptor sets, which are basically just collections of descriptors.
-    VkDescriptorPool descriptorPool;
-    VkDescriptorSet descriptorSet;
-    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 
     // The mandelbrot set / path-traced scene will be rendered to this buffer.
     // The memory that backs the buffer is bufferMemory.
-    VkBuffer buffer;
-    VkDeviceMemory bufferMemory;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory bufferMemory = VK_NULL_HANDLE;
 
     std::vector<const char *> enabledLayers;
 
@@ -116,13 +273,35 @@ protected:
     // There will be different kinds of queues on the device. Not all queues support
     // graphics operations, for instance. For this application, we at least want a queue
     // that supports compute operations.
-    VkQueue queue; // a queue supporting compute operations.
+    VkQueue queue = VK_NULL_HANDLE; // a queue supporting compute operations.
 
     // Groups of queues that have the same capabilities(for instance, they all supports graphics and computer operations),
     // are grouped into queue families.
     // When submitting a command buffer, you must specify to which queue in the family you are submitting to.
     // This variable keeps track of the index of that queue in its family.
     uint32_t queueFamilyIndex;
+
+    // Further queues, found by createDevice(): the transfer queue comes from a dedicated transfer family if there is
+    // one (the DMA engines of discrete GPUs), otherwise from another family or as another queue of the compute family.
+    // If there is no such queue, transferQueue is `queue`.
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    uint32_t transferQueueFamilyIndex;
+
+    // Timeline semaphores (VK_KHR_timeline_semaphore, enabled if the device supports it) order work across the queues:
+    // a submission signals a counter value when it is done, other submissions or the host wait for that value.
+    bool timelineSemaphores = false;
+    PFN_vkWaitSemaphoresKHR pfnWaitSemaphores = NULL;
+    PFN_vkGetSemaphoreCounterValueKHR pfnGetSemaphoreCounterValue = NULL;
+
+    VkSemaphore createTimelineSemaphore();
+    // blocks until the counter of semaphore reaches value
+    void waitTimelineSemaphore( const VkSemaphore semaphore, const uint64_t value );
+    uint64_t getTimelineSemaphoreValue( const VkSemaphore semaphore );
+    // Submits commandBuffer to targetQueue. It starts at waitStage once every wait semaphore reached its value,
+    // and sets signalSemaphore to signalValue when done.
+    void submitTimeline( const VkQueue targetQueue, const VkCommandBuffer commandBuffer,
+                         const std::vector<VkSemaphore>& waitSemaphores, const std::vector<uint64_t>& waitValues, const VkPipelineStageFlags waitStage,
+                         const VkSemaphore signalSemaphore, const uint64_t signalValue );
     
 };
 